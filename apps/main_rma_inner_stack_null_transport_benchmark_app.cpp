@@ -1,21 +1,19 @@
-//
-// Created by denis on 22.01.23.
-//
-
 /*
- * Программа для измерения продолжительности нескольких операций POP
- * для централизованного стека Трейбера.
+ * Программа для измерения накладных расходов процесса на операции PUSH и POP внутреннего стека
+ * без сетевого обмена: RMA-окна размещаются в разделяемой памяти узла, поэтому программу
+ * следует запускать одним процессом.
  */
 
+#include <chrono>
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
 #include <spdlog/spdlog.h>
-#include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/dup_filter_sink.h>
-#include <chrono>
+#include <spdlog/sinks/basic_file_sink.h>
 
-#include "outer/RmaTreiberCentralStack.h"
+#include "inner/InnerStack.h"
 #include "include/stack_tasks.h"
 #include "include/logging.h"
+#include "MpiException.h"
 
 using namespace std::literals;
 
@@ -30,9 +28,7 @@ int main(int argc, char *argv[])
     int rank{-1};
     MPI_Comm_rank(comm, &rank);
 
-    const auto minBackoffDelay = 1ns;
-    const auto maxBackoffDelay = 100ns;
-    const auto elemsUpLimit{30000};
+    const auto elemsUpLimit{100};
 
     /*
      * Сообщения, которые поступили подряд в течение 1 с,
@@ -46,7 +42,6 @@ int main(int argc, char *argv[])
      * default - лог отладки операций со стеком.
      * benchmark - отдельный лог, в который поступает информация об измерениях.
      */
-
     auto loggingDefaultFilename = getLoggingFilename(rank, "default");
     auto fileDefaultSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(
             loggingDefaultFilename.data()
@@ -62,19 +57,27 @@ int main(int argc, char *argv[])
             loggingBenchmarkFilename.data()
     );
 
+    auto pInnerStackLogger = std::make_shared<spdlog::logger>("InnerStack", duplicatingFilterSink);
+    spdlog::register_logger(pInnerStackLogger);
+    pInnerStackLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pInnerStackLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    rma_stack::ref_counting::InnerStackOptions innerStackOptions;
+    innerStackOptions.intraNodeSharedMemory = true;
     try
     {
-        auto rmaTreiberStack = rma_stack::RmaTreiberCentralStack<int>::create(
+        auto innerStack = rma_stack::ref_counting::InnerStack<>(
                 comm,
                 info,
-                minBackoffDelay,
-                maxBackoffDelay,
+                true,
                 elemsUpLimit,
-                duplicatingFilterSink
+                std::move(pInnerStackLogger),
+                innerStackOptions
         );
-        runStackOnlyPopBenchmarkTask(rmaTreiberStack, comm, fileBenchmarkSink);
+        runInnerStackCallbackOverheadBenchmarkTask(innerStack, comm, fileBenchmarkSink);
+
         MPI_Barrier(comm);
-        rmaTreiberStack.release();
+        innerStack.release();
     }
     catch (custom_mpi_extensions::MpiException& ex)
     {
@@ -86,8 +89,7 @@ int main(int argc, char *argv[])
         SPDLOG_INFO("Unexpected exception: "s + ex.what());
         returnCode = EXIT_FAILURE;
     }
-
     MPI_Finalize();
     SPDLOG_INFO("finished program");
     return returnCode;
-}
\ No newline at end of file
+}
@@ -62,7 +62,7 @@ int main(int argc, char *argv[])
 
     try
     {
-        auto innerStack = rma_stack::ref_counting::InnerStack(
+        auto innerStack = rma_stack::ref_counting::InnerStack<>(
                 comm,
                 info,
                 true,
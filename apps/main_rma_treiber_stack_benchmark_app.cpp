@@ -0,0 +1,271 @@
+/*
+ * Программа измерения внешних стеков, общая для всех приложений-бенчмарков. Вариант измерения
+ * задаётся определениями препроцессора, которые CMakeLists.txt назначает цели приложения:
+ *   RMA_STACK_APP_STACK   - шаблон внешнего стека: RmaTreiberCentralStack, RmaTreiberDecentralizedStack,
+ *                           RmaTreiberHierarchicalStack или RmaShardedStack;
+ *   RMA_STACK_APP_TASK    - измерение (BenchmarkTask);
+ *   RMA_STACK_APP_OPTIONS - параметры внутреннего стека (BenchmarkOptions), по умолчанию Default;
+ *   RMA_STACK_APP_BACKOFF - политика задержки (см. BackoffPolicies.h), по умолчанию ExponentialBackoff.
+ * Аргумент --detailed-statistics включает измерение задержки каждой операции и вывод счётчиков стека
+ * в измерении RandomOperation (см. runStackRandomOperationBenchmarkTask).
+ */
+
+#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/dup_filter_sink.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string_view>
+#include <type_traits>
+
+#include "outer/BackoffPolicies.h"
+#include "outer/RmaTreiberCentralStack.h"
+#include "outer/RmaTreiberDecentralizedStack.h"
+#include "outer/RmaTreiberHierarchicalStack.h"
+#include "outer/RmaShardedStack.h"
+#include "include/stack_tasks.h"
+#include "include/logging.h"
+
+#ifndef RMA_STACK_APP_OPTIONS
+#define RMA_STACK_APP_OPTIONS Default
+#endif
+
+#ifndef RMA_STACK_APP_BACKOFF
+#define RMA_STACK_APP_BACKOFF ExponentialBackoff
+#endif
+
+using namespace std::literals;
+
+enum class BenchmarkTask
+{
+    RandomOperation,
+    AsyncRandomOperation,
+    CoroutineRandomOperation,
+    OnlyPush,
+    OnlyPop,
+    OccupancyPush,
+    Peek,
+    Size
+};
+
+enum class BenchmarkOptions
+{
+    Default,
+    InlinePayload,
+    ContentionEstimation,
+    Elimination,
+    Epochs,
+    PopPrefetch,
+    SharedMemory,
+    StaticWindows,
+    PerOpLock,
+    WorkStealing,
+    ElasticPool,
+    Bitmap,
+    SizeCounter,
+    ExactSizeCounter
+};
+
+using Stack = rma_stack::RMA_STACK_APP_STACK<int, rma_stack::ref_counting::DefaultLayout, rma_stack::RMA_STACK_APP_BACKOFF>;
+
+constexpr auto benchmarkTask = BenchmarkTask::RMA_STACK_APP_TASK;
+constexpr auto benchmarkOptions = BenchmarkOptions::RMA_STACK_APP_OPTIONS;
+// Централизованный стек выделяет все узлы в одном процессе, остальные стеки - поровну во всех процессах.
+constexpr bool centralized = std::is_same_v<
+        Stack,
+        rma_stack::RmaTreiberCentralStack<int, rma_stack::ref_counting::DefaultLayout, rma_stack::RMA_STACK_APP_BACKOFF>
+>;
+
+rma_stack::ref_counting::InnerStackOptions getInnerStackOptions(int procNum)
+{
+    rma_stack::ref_counting::InnerStackOptions innerStackOptions;
+    switch (benchmarkOptions)
+    {
+        case BenchmarkOptions::Default:
+            break;
+        case BenchmarkOptions::InlinePayload:
+            innerStackOptions.inlinePayload = true;
+            break;
+        case BenchmarkOptions::ContentionEstimation:
+            innerStackOptions.contentionSamplingPeriod = 16;
+            break;
+        case BenchmarkOptions::Elimination:
+            innerStackOptions.eliminationArraySize = std::max(1, procNum / 2);
+            break;
+        case BenchmarkOptions::Epochs:
+            innerStackOptions.reclamationType = rma_stack::ref_counting::ReclamationType::Epochs;
+            break;
+        case BenchmarkOptions::PopPrefetch:
+            innerStackOptions.prefetchPopPayload = true;
+            break;
+        case BenchmarkOptions::SharedMemory:
+            // Окна стека выделяются в разделяемой памяти узла, если все процессы находятся на одном узле.
+            innerStackOptions.intraNodeSharedMemory = true;
+            break;
+        case BenchmarkOptions::StaticWindows:
+            innerStackOptions.staticWindows = true;
+            break;
+        case BenchmarkOptions::PerOpLock:
+            // Базовый вариант для сравнения: блокировка целевого процесса на каждое обращение.
+            innerStackOptions.persistentLockAll = false;
+            break;
+        case BenchmarkOptions::WorkStealing:
+            innerStackOptions.workStealing = true;
+            innerStackOptions.stealBatchSize = 8;
+            break;
+        case BenchmarkOptions::ElasticPool:
+            innerStackOptions.inlinePayload = true;
+            innerStackOptions.elasticNodePool = true;
+            break;
+        case BenchmarkOptions::Bitmap:
+            innerStackOptions.nodeAllocatorType = rma_stack::ref_counting::NodeAllocatorType::Bitmap;
+            break;
+        case BenchmarkOptions::SizeCounter:
+            innerStackOptions.sizeCounterShardsNum = rma_stack::ref_counting::PerRankSizeCounterShards;
+            break;
+        case BenchmarkOptions::ExactSizeCounter:
+            innerStackOptions.sizeCounterShardsNum = rma_stack::ref_counting::PerRankSizeCounterShards;
+            innerStackOptions.exactSize = true;
+            break;
+    }
+    return innerStackOptions;
+}
+
+template<typename StackImpl>
+void runBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                      std::shared_ptr<spdlog::sinks::sink> loggerSink, size_t nodesNum, bool detailedStatistics)
+{
+    if constexpr (benchmarkTask == BenchmarkTask::RandomOperation)
+    {
+        runStackRandomOperationBenchmarkTask(stack, comm, loggerSink, detailedStatistics);
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::AsyncRandomOperation)
+    {
+        // Кол-во незавершённых неблокирующих операций процесса.
+        const size_t requestsNum = 8;
+        runStackAsyncRandomOperationBenchmarkTask(stack, comm, loggerSink, requestsNum);
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::CoroutineRandomOperation)
+    {
+#if defined(__cpp_impl_coroutine)
+        // Кол-во сопрограмм процесса, каждая из которых держит одну незавершённую операцию.
+        const size_t coroutinesNum = 1024;
+        runStackCoroutineRandomOperationBenchmarkTask(stack, comm, loggerSink, coroutinesNum);
+#else
+        static_assert(benchmarkTask != BenchmarkTask::CoroutineRandomOperation,
+                      "the coroutine benchmark requires C++20 coroutines");
+#endif
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::OnlyPush)
+    {
+        runStackOnlyPushBenchmarkTask(stack, comm, loggerSink);
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::OnlyPop)
+    {
+        runStackOnlyPopBenchmarkTask(stack, comm, loggerSink);
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::OccupancyPush)
+    {
+        if constexpr (benchmarkOptions == BenchmarkOptions::Bitmap)
+            runNodeBitmapSearchCheckTask(loggerSink);
+        runStackOccupancyPushBenchmarkTask(stack, comm, loggerSink, nodesNum);
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::Peek)
+    {
+        const size_t peekPeriod{16};
+        const size_t peekCount{8};
+        runStackPeekBenchmarkTask(stack, comm, loggerSink, peekPeriod, peekCount);
+    }
+    else if constexpr (benchmarkTask == BenchmarkTask::Size)
+    {
+        const size_t sizeQueryPeriod{16};
+        runStackSizeBenchmarkTask(stack, comm, loggerSink, sizeQueryPeriod);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    auto returnCode{EXIT_SUCCESS};
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Info info = MPI_INFO_NULL;
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+
+    const bool detailedStatistics = std::any_of(argv + 1, argv + argc, [] (const char *pArg) {
+        return std::string_view(pArg) == "--detailed-statistics";
+    });
+
+    const auto minBackoffDelay = 1ns;
+    const auto maxBackoffDelay = 100ns;
+
+    int size{0};
+    MPI_Comm_size(comm, &size);
+    int elemsUpLimit = centralized ? 30000 : static_cast<int>(std::ceil(30000. / size));
+    // Исходный сегмент вмещает 1/64 узлов, остальные узлы выделяются по мере роста стека.
+    if constexpr (benchmarkOptions == BenchmarkOptions::ElasticPool)
+        elemsUpLimit = static_cast<int>(std::ceil(30000. / size / 64));
+
+    /*
+     * Сообщения, которые поступили подряд в течение 1 с,
+     * будут объединены в один лог с информацией об их
+     * количестве.
+     */
+    auto duplicatingFilterSink = std::make_shared<spdlog::sinks::dup_filter_sink_mt>(
+            1s
+    );
+    /*
+     * default - лог отладки операций со стеком.
+     * benchmark - отдельный лог, в который поступает информация об измерениях.
+     */
+
+    auto loggingDefaultFilename = getLoggingFilename(rank, "default");
+    auto fileDefaultSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(
+            loggingDefaultFilename.data()
+    );
+    duplicatingFilterSink->add_sink(fileDefaultSink);
+    auto pDefaultLogger = std::make_shared<spdlog::logger>(defaultLoggerName.data(), duplicatingFilterSink);
+    spdlog::set_default_logger(pDefaultLogger);
+    spdlog::set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    spdlog::flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    auto loggingBenchmarkFilename = getLoggingFilename(rank, "benchmark");
+    auto fileBenchmarkSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(
+            loggingBenchmarkFilename.data()
+    );
+
+    try
+    {
+        auto rmaTreiberStack = Stack::create(
+                comm,
+                info,
+                minBackoffDelay,
+                maxBackoffDelay,
+                elemsUpLimit,
+                duplicatingFilterSink,
+                getInnerStackOptions(size)
+        );
+        const auto nodesNum = static_cast<size_t>(centralized ? elemsUpLimit : elemsUpLimit * size);
+        runBenchmarkTask(rmaTreiberStack, comm, fileBenchmarkSink, nodesNum, detailedStatistics);
+        MPI_Barrier(comm);
+        rmaTreiberStack.release();
+    }
+    catch (custom_mpi_extensions::MpiException& ex)
+    {
+        SPDLOG_INFO("MPI exception"s + ex.what());
+        returnCode = EXIT_FAILURE;
+    }
+    catch (std::exception& ex)
+    {
+        SPDLOG_INFO("Unexpected exception: "s + ex.what());
+        returnCode = EXIT_FAILURE;
+    }
+
+    MPI_Finalize();
+    SPDLOG_INFO("finished program");
+    return returnCode;
+}
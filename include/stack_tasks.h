@@ -8,13 +8,23 @@
 #include <spdlog/spdlog.h>
 #include <ctime>
 #include <random>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <string_view>
+#include <stdexcept>
 
 #include "IStack.h"
 #include "inner/InnerStack.h"
+#if defined(__cpp_impl_coroutine)
+#include "outer/CoroutineStack.h"
+#endif
 #include "logging.h"
 using namespace std::literals::chrono_literals;
 
-void runInnerStackSimplePushPopTask(rma_stack::ref_counting::InnerStack &stack, MPI_Comm comm);
+void runInnerStackSimplePushPopTask(rma_stack::ref_counting::InnerStack<> &stack, MPI_Comm comm);
+void runInnerStackCallbackOverheadBenchmarkTask(rma_stack::ref_counting::InnerStack<> &stack, MPI_Comm comm,
+                                                std::shared_ptr<spdlog::sinks::sink> loggerSink);
 
 template<typename StackImpl>
 using EnableIfValueTypeIsInt = std::enable_if_t<std::is_same_v<typename StackImpl::ValueType, int>>;
@@ -56,14 +66,118 @@ void runStackSimpleIntPushPopTask(stack_interface::IStack<StackImpl> &stack, MPI
     SPDLOG_INFO("finished 'runStackSimpleIntPushPopTask'");
 }
 
+/*
+ * Вывод счётчиков кражи значений из стеков других процессов (InnerStackOptions::workStealing).
+ * steal rate - доля операций POP всех процессов, значения которых забраны у других процессов.
+ */
+template<typename StackImpl>
+void logStackStealStatistics(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                             const std::shared_ptr<spdlog::logger> &pLogger, size_t popCnt)
+{
+    const auto &rStatistics = static_cast<StackImpl&>(stack).getStatistics();
+    const uint64_t stealCounters[4] = {rStatistics.stealAttemptsNum, rStatistics.stealHitsNum,
+                                       rStatistics.stolenValuesNum, popCnt};
+    uint64_t totalStealCounters[4] = {0, 0, 0, 0};
+    MPI_Allreduce(stealCounters, totalStealCounters, 4, MPI_UINT64_T, MPI_SUM, comm);
+
+    const auto stealRate = totalStealCounters[3] > 0
+            ? static_cast<double>(totalStealCounters[1]) / static_cast<double>(totalStealCounters[3])
+            : 0.0;
+    SPDLOG_LOGGER_INFO(pLogger, "steal attempts {}, steal hits {}, stolen values {}, total steal attempts {}, "
+                                "total steal hits {}, total stolen values {}, steal rate {}",
+                       stealCounters[0], stealCounters[1], stealCounters[2],
+                       totalStealCounters[0], totalStealCounters[1], totalStealCounters[2], stealRate);
+}
+
+// Вывод счётчиков выделенных и освобождённых сегментов растущего пула узлов (InnerStackOptions::elasticNodePool).
+template<typename StackImpl>
+void logStackNodePoolStatistics(stack_interface::IStack<StackImpl> &stack, const std::shared_ptr<spdlog::logger> &pLogger)
+{
+    const auto &rStatistics = static_cast<StackImpl&>(stack).getStatistics();
+    SPDLOG_LOGGER_INFO(pLogger, "node segment growths {}, shrinks {}",
+                       rStatistics.nodeSegmentGrowthsNum, rStatistics.nodeSegmentShrinksNum);
+}
+
+/*
+ * Вывод неудачных CAS головы (InnerStackStatistics::headCasFailuresNum).
+ * CAS failures per op - среднее кол-во неудачных CAS головы на одну операцию всех процессов.
+ */
+template<typename StackImpl>
+void logStackContentionStatistics(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                                  const std::shared_ptr<spdlog::logger> &pLogger, size_t opsNum)
+{
+    const auto &rStatistics = static_cast<StackImpl&>(stack).getStatistics();
+    const uint64_t contentionCounters[2] = {rStatistics.headCasFailuresNum, opsNum};
+    uint64_t totalContentionCounters[2] = {0, 0};
+    MPI_Allreduce(contentionCounters, totalContentionCounters, 2, MPI_UINT64_T, MPI_SUM, comm);
+
+    const auto casFailuresPerOp = totalContentionCounters[1] > 0
+            ? static_cast<double>(totalContentionCounters[0]) / static_cast<double>(totalContentionCounters[1])
+            : 0.0;
+    SPDLOG_LOGGER_INFO(pLogger, "head CAS failures {}, total head CAS failures {}, CAS failures per op {}",
+                       contentionCounters[0], totalContentionCounters[0], casFailuresPerOp);
+}
+
+/*
+ * Вывод обращений к удалённой памяти операций PUSH (InnerStackStatistics::pushRoundTripsNum).
+ * Round trips per push - среднее кол-во обращений на одну операцию PUSH всех процессов.
+ */
+template<typename StackImpl>
+void logStackPushRoundTrips(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                            const std::shared_ptr<spdlog::logger> &pLogger)
+{
+    const auto &rStatistics = static_cast<StackImpl&>(stack).getStatistics();
+    const uint64_t pushCounters[2] = {rStatistics.pushesNum, rStatistics.pushRoundTripsNum};
+    uint64_t totalPushCounters[2] = {0, 0};
+    MPI_Allreduce(pushCounters, totalPushCounters, 2, MPI_UINT64_T, MPI_SUM, comm);
+
+    const auto roundTripsPerPush = totalPushCounters[0] > 0
+            ? static_cast<double>(totalPushCounters[1]) / static_cast<double>(totalPushCounters[0])
+            : 0.0;
+    SPDLOG_LOGGER_INFO(pLogger, "pushes {}, push round trips {}, total pushes {}, total push round trips {}, "
+                                "round trips per push {}",
+                       pushCounters[0], pushCounters[1], totalPushCounters[0], totalPushCounters[1], roundTripsPerPush);
+}
+
+/*
+ * Вывод задержек операций процесса в микросекундах (медиана, 99-й перцентиль, максимум)
+ * и наибольших по всем процессам 99-го перцентиля и максимума. opName - название операций в выводе.
+ */
+inline void logStackOperationLatencies(std::vector<double> opLatenciesSec, MPI_Comm comm,
+                                       const std::shared_ptr<spdlog::logger> &pLogger,
+                                       std::string_view opName = "op")
+{
+    double latenciesUs[3] = {0, 0, 0};
+    if (!opLatenciesSec.empty())
+    {
+        std::sort(opLatenciesSec.begin(), opLatenciesSec.end());
+        const auto getPercentile = [&opLatenciesSec] (double q) {
+            const auto i = std::min(opLatenciesSec.size() - 1, static_cast<size_t>(q * opLatenciesSec.size()));
+            return opLatenciesSec[i] * 1e6;
+        };
+        latenciesUs[0] = getPercentile(0.5);
+        latenciesUs[1] = getPercentile(0.99);
+        latenciesUs[2] = opLatenciesSec.back() * 1e6;
+    }
+    double totalLatenciesUs[2] = {0, 0};
+    MPI_Allreduce(&latenciesUs[1], totalLatenciesUs, 2, MPI_DOUBLE, MPI_MAX, comm);
+
+    SPDLOG_LOGGER_INFO(pLogger, "{} latency (us) p50 {}, p99 {}, max {}, total p99 {}, total max {}", opName,
+                       latenciesUs[0], latenciesUs[1], latenciesUs[2], totalLatenciesUs[0], totalLatenciesUs[1]);
+}
+
 /*
  * Задача для измерения продолжительности случайных равновероятных операций PUSH и POP внешнего стека,
  * предназначена только для данных типа 'int'. workload - эмуляция сторонней нагрузки на приложение.
+ * detailedStatistics - измерение задержки каждой операции и вывод счётчиков стека (исключение, кража,
+ * пул узлов, конкуренция за голову, обращения PUSH). По умолчанию выключено, чтобы вызовы MPI_Wtime
+ * на каждую операцию не искажали измеряемую продолжительность.
  */
 template<typename StackImpl,
         typename = EnableIfValueTypeIsInt<StackImpl>>
 void runStackRandomOperationBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
-                                          std::shared_ptr<spdlog::sinks::sink> loggerSink)
+                                          std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                                          bool detailedStatistics = false)
 {
     SPDLOG_INFO("started 'runStackRandomOperationBenchmarkTask'");
 
@@ -94,11 +208,15 @@ void runStackRandomOperationBenchmarkTask(stack_interface::IStack<StackImpl> &st
 
     size_t pushCnt{0};
     size_t popCnt{0};
+    std::vector<double> opLatenciesSec;
+    if (detailedStatistics)
+        opLatenciesSec.reserve(opsNum);
 
     const double tBeginSec = MPI_Wtime();
     for (int i = 0; i < opsNum; ++i)
     {
         int e = dist(mt);
+        const double tOpBeginSec = detailedStatistics ? MPI_Wtime() : 0.0;
         if (e > 25)
         {
             stack.push(e);
@@ -110,6 +228,8 @@ void runStackRandomOperationBenchmarkTask(stack_interface::IStack<StackImpl> &st
             stack.pop(e, defaultValue);
             ++popCnt;
         }
+        if (detailedStatistics)
+            opLatenciesSec.push_back(MPI_Wtime() - tOpBeginSec);
         std::this_thread::sleep_for(workload);
     }
     const double tEndSec = MPI_Wtime();
@@ -124,9 +244,435 @@ void runStackRandomOperationBenchmarkTask(stack_interface::IStack<StackImpl> &st
     SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}", totalOpsNum, opsNum);
     SPDLOG_LOGGER_INFO(pLogger, "push count {}, pop count {}, warm up {}", pushCnt, popCnt, warmUp);
 
+    if (!detailedStatistics)
+    {
+        SPDLOG_INFO("finished 'runStackRandomOperationBenchmarkTask'");
+        return;
+    }
+
+    const auto &rStatistics = static_cast<StackImpl&>(stack).getStatistics();
+    const uint64_t eliminationCounters[2] = {rStatistics.eliminationAttemptsNum, rStatistics.eliminationHitsNum};
+    uint64_t totalEliminationCounters[2] = {0, 0};
+    MPI_Allreduce(eliminationCounters, totalEliminationCounters, 2, MPI_UINT64_T, MPI_SUM, comm);
+
+    const auto eliminationHitRate = totalEliminationCounters[0] > 0
+            ? static_cast<double>(totalEliminationCounters[1]) / static_cast<double>(totalEliminationCounters[0])
+            : 0.0;
+    SPDLOG_LOGGER_INFO(pLogger, "elimination attempts {}, elimination hits {}, total elimination attempts {}, "
+                                "total elimination hits {}, elimination hit rate {}",
+                       eliminationCounters[0], eliminationCounters[1],
+                       totalEliminationCounters[0], totalEliminationCounters[1], eliminationHitRate);
+    logStackStealStatistics(stack, comm, pLogger, popCnt);
+    logStackNodePoolStatistics(stack, pLogger);
+    logStackContentionStatistics(stack, comm, pLogger, pushCnt + popCnt);
+    logStackPushRoundTrips(stack, comm, pLogger);
+    logStackOperationLatencies(std::move(opLatenciesSec), comm, pLogger);
+
     SPDLOG_INFO("finished 'runStackRandomOperationBenchmarkTask'");
 }
 
+/*
+ * Задача для измерения продолжительности запроса размера стека (IStack::size) среди случайных равновероятных
+ * операций PUSH и POP, предназначена только для данных типа 'int'. Размер запрашивается после каждых
+ * sizeQueryPeriod операций процесса. После завершения операций всех процессов размер, который видит процесс,
+ * сравнивается с фактическим: warm up всех процессов плюс добавленные минус извлечённые значения.
+ */
+template<typename StackImpl,
+        typename = EnableIfValueTypeIsInt<StackImpl>>
+void runStackSizeBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                               std::shared_ptr<spdlog::sinks::sink> loggerSink, size_t sizeQueryPeriod)
+{
+    SPDLOG_INFO("started 'runStackSizeBenchmarkTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    const auto workload{1us};
+    const auto totalOpsNum{15'000};
+
+    auto procNum{0};
+    MPI_Comm_size(comm, &procNum);
+    const int opsNum = std::ceil(((double)totalOpsNum) / procNum);
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+
+    const int warmUp = std::ceil(opsNum * 0.1);
+
+    for (int i = 0; i < warmUp; ++i)
+    {
+        stack.push(1);
+    }
+    MPI_Barrier(comm);
+    std::random_device rd;
+    std::mt19937 mt(rd());
+    std::uniform_int_distribution<int> dist(0, 50);
+
+    int64_t pushCnt{0};
+    int64_t popCnt{0};
+    std::vector<double> sizeLatenciesSec;
+    sizeLatenciesSec.reserve(opsNum / std::max<size_t>(sizeQueryPeriod, 1) + 1);
+
+    const double tBeginSec = MPI_Wtime();
+    for (int i = 0; i < opsNum; ++i)
+    {
+        int e = dist(mt);
+        if (e > 25)
+        {
+            stack.push(e);
+            ++pushCnt;
+        }
+        else
+        {
+            int defaultValue = -1;
+            stack.pop(e, defaultValue);
+            if (e != defaultValue)
+                ++popCnt;
+        }
+
+        if (sizeQueryPeriod > 0 && (i + 1) % sizeQueryPeriod == 0)
+        {
+            const double tSizeBeginSec = MPI_Wtime();
+            static_cast<void>(stack.size());
+            sizeLatenciesSec.push_back(MPI_Wtime() - tSizeBeginSec);
+        }
+        std::this_thread::sleep_for(workload);
+    }
+    const double tEndSec = MPI_Wtime();
+
+    const double workloadSec = std::chrono::duration_cast<std::chrono::microseconds>(workload).count() / 1'000'000.0f;
+    const double tElapsedSec = tEndSec - tBeginSec - (opsNum * workloadSec);
+
+    double tTotalElapsedSec{0};
+    MPI_Allreduce(&tElapsedSec, &tTotalElapsedSec, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, elapsed (sec) {}, total (sec) {}", procNum, rank, tElapsedSec, tTotalElapsedSec);
+    SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}, size query period {}", totalOpsNum, opsNum, sizeQueryPeriod);
+    SPDLOG_LOGGER_INFO(pLogger, "push count {}, pop count {}, warm up {}", pushCnt, popCnt, warmUp);
+
+    const int64_t sizeIncrease = warmUp + pushCnt - popCnt;
+    int64_t expectedSize{0};
+    MPI_Allreduce(&sizeIncrease, &expectedSize, 1, MPI_INT64_T, MPI_SUM, comm);
+
+    const auto size = static_cast<int64_t>(stack.size());
+    const int64_t sizeError = std::abs(size - expectedSize);
+    int64_t maxSizeError{0};
+    MPI_Allreduce(&sizeError, &maxSizeError, 1, MPI_INT64_T, MPI_MAX, comm);
+    SPDLOG_LOGGER_INFO(pLogger, "size {}, expected size {}, is empty {}, size error {}, total max size error {}",
+                       size, expectedSize, stack.isEmpty(), sizeError, maxSizeError);
+
+    logStackOperationLatencies(std::move(sizeLatenciesSec), comm, pLogger, "size");
+
+    SPDLOG_INFO("finished 'runStackSizeBenchmarkTask'");
+}
+
+/*
+ * Задача для измерения продолжительности чтения без извлечения (peekTopK внешнего стека) среди случайных
+ * равновероятных операций PUSH и POP, предназначена только для данных типа 'int'. Процесс читает peekCount
+ * значений после каждых peekPeriod своих операций. После завершения операций всех процессов процесс 0
+ * сравнивает прочитанные значения со значениями, которые затем извлекает операциями POP.
+ */
+template<typename StackImpl,
+        typename = EnableIfValueTypeIsInt<StackImpl>>
+void runStackPeekBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                               std::shared_ptr<spdlog::sinks::sink> loggerSink, size_t peekPeriod, size_t peekCount)
+{
+    SPDLOG_INFO("started 'runStackPeekBenchmarkTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    auto &rStackImpl = static_cast<StackImpl&>(stack);
+
+    const auto workload{1us};
+    const auto totalOpsNum{15'000};
+
+    auto procNum{0};
+    MPI_Comm_size(comm, &procNum);
+    const int opsNum = std::ceil(((double)totalOpsNum) / procNum);
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+
+    const auto warmUp = std::ceil(opsNum * 0.1);
+
+    for (int i = 0; i < warmUp; ++i)
+    {
+        stack.push(1);
+    }
+    MPI_Barrier(comm);
+    std::random_device rd;
+    std::mt19937 mt(rd());
+    std::uniform_int_distribution<int> dist(0, 50);
+
+    size_t pushCnt{0};
+    size_t popCnt{0};
+    size_t peekedCnt{0};
+    std::vector<double> peekLatenciesSec;
+    peekLatenciesSec.reserve(opsNum / std::max<size_t>(peekPeriod, 1) + 1);
+
+    const double tBeginSec = MPI_Wtime();
+    for (int i = 0; i < opsNum; ++i)
+    {
+        int e = dist(mt);
+        if (e > 25)
+        {
+            stack.push(e);
+            ++pushCnt;
+        }
+        else
+        {
+            int defaultValue = -1;
+            stack.pop(e, defaultValue);
+            ++popCnt;
+        }
+
+        if (peekPeriod > 0 && (i + 1) % peekPeriod == 0)
+        {
+            const double tPeekBeginSec = MPI_Wtime();
+            peekedCnt += rStackImpl.peekTopK(peekCount).size();
+            peekLatenciesSec.push_back(MPI_Wtime() - tPeekBeginSec);
+        }
+        std::this_thread::sleep_for(workload);
+    }
+    const double tEndSec = MPI_Wtime();
+
+    const double workloadSec = std::chrono::duration_cast<std::chrono::microseconds>(workload).count() / 1'000'000.0f;
+    const double tElapsedSec = tEndSec - tBeginSec - (opsNum * workloadSec);
+
+    double tTotalElapsedSec{0};
+    MPI_Allreduce(&tElapsedSec, &tTotalElapsedSec, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, elapsed (sec) {}, total (sec) {}", procNum, rank, tElapsedSec, tTotalElapsedSec);
+    SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}, peek period {}, peek count {}", totalOpsNum, opsNum, peekPeriod, peekCount);
+    SPDLOG_LOGGER_INFO(pLogger, "push count {}, pop count {}, peeked values {}, warm up {}", pushCnt, popCnt, peekedCnt, warmUp);
+
+    MPI_Barrier(comm);
+    if (rank == 0)
+    {
+        const auto peekedValues = rStackImpl.peekTopK(peekCount);
+        size_t mismatchesNum{0};
+        for (const auto peekedValue: peekedValues)
+        {
+            int value{-1};
+            stack.pop(value, -1);
+            if (value != peekedValue)
+                ++mismatchesNum;
+        }
+        SPDLOG_LOGGER_INFO(pLogger, "peeked {} values at rest, mismatches with popped values {}",
+                           peekedValues.size(), mismatchesNum);
+    }
+    MPI_Barrier(comm);
+
+    logStackOperationLatencies(std::move(peekLatenciesSec), comm, pLogger, "peek");
+
+    SPDLOG_INFO("finished 'runStackPeekBenchmarkTask'");
+}
+
+/*
+ * Задача для измерения продолжительности случайных равновероятных неблокирующих операций PUSH и POP
+ * внешнего стека (pushAsync, popAsync), предназначена только для данных типа 'int'.
+ * Процесс держит до requestsNum незавершённых операций: новая операция занимает дескриптор
+ * самой старой, дождавшись её завершения. workload - эмуляция сторонней нагрузки на приложение.
+ */
+template<typename StackImpl,
+        typename = EnableIfValueTypeIsInt<StackImpl>>
+void runStackAsyncRandomOperationBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                                               std::shared_ptr<spdlog::sinks::sink> loggerSink, size_t requestsNum)
+{
+    SPDLOG_INFO("started 'runStackAsyncRandomOperationBenchmarkTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    auto &rStackImpl = static_cast<StackImpl&>(stack);
+
+    const auto workload{1us};
+    const auto totalOpsNum{15'000};
+
+    auto procNum{0};
+    MPI_Comm_size(comm, &procNum);
+    const int opsNum = std::ceil(((double)totalOpsNum) / procNum);
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+
+    const auto warmUp = std::ceil(opsNum * 0.1);
+
+    for (int i = 0; i < warmUp; ++i)
+    {
+        stack.push(1);
+    }
+    MPI_Barrier(comm);
+    std::random_device rd;
+    std::mt19937 mt(rd());
+    std::uniform_int_distribution<int> dist(0, 50);
+
+    std::vector<typename StackImpl::RequestType> requests(requestsNum);
+    std::vector<int> poppedValues(requestsNum);
+
+    size_t pushCnt{0};
+    size_t popCnt{0};
+
+    const double tBeginSec = MPI_Wtime();
+    for (int i = 0; i < opsNum; ++i)
+    {
+        auto &rRequest = requests[i % requestsNum];
+        rRequest.wait();
+
+        int e = dist(mt);
+        if (e > 25)
+        {
+            rStackImpl.pushAsync(e, rRequest);
+            ++pushCnt;
+        }
+        else
+        {
+            rStackImpl.popAsync(poppedValues[i % requestsNum], -1, rRequest);
+            ++popCnt;
+        }
+        std::this_thread::sleep_for(workload);
+    }
+    for (auto &rRequest: requests)
+        rRequest.wait();
+    const double tEndSec = MPI_Wtime();
+
+    const double workloadSec = std::chrono::duration_cast<std::chrono::microseconds>(workload).count() / 1'000'000.0f;
+    const double tElapsedSec = tEndSec - tBeginSec - (opsNum * workloadSec);
+
+    double tTotalElapsedSec{0};
+    MPI_Allreduce(&tElapsedSec, &tTotalElapsedSec, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, elapsed (sec) {}, total (sec) {}", procNum, rank, tElapsedSec, tTotalElapsedSec);
+    SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}, requests in flight {}", totalOpsNum, opsNum, requestsNum);
+    SPDLOG_LOGGER_INFO(pLogger, "push count {}, pop count {}, warm up {}", pushCnt, popCnt, warmUp);
+
+    SPDLOG_INFO("finished 'runStackAsyncRandomOperationBenchmarkTask'");
+}
+
+#if defined(__cpp_impl_coroutine)
+/*
+ * Задача для измерения продолжительности случайных равновероятных операций PUSH и POP внешнего стека,
+ * выполняемых coroutinesNum сопрограммами процесса (CoroutineStack), предназначена только для данных типа 'int'.
+ * Пока сопрограмма ожидает завершения операции, планировщик выполняет другие сопрограммы.
+ * workload - эмуляция сторонней нагрузки на приложение.
+ */
+template<typename StackImpl,
+        typename = EnableIfValueTypeIsInt<StackImpl>>
+void runStackCoroutineRandomOperationBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                                                   std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                                                   size_t coroutinesNum)
+{
+    SPDLOG_INFO("started 'runStackCoroutineRandomOperationBenchmarkTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    const auto workload{1us};
+    const auto totalOpsNum{15'000};
+
+    auto procNum{0};
+    MPI_Comm_size(comm, &procNum);
+    const size_t opsNum = std::ceil(((double)totalOpsNum) / procNum);
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+
+    const auto warmUp = std::ceil(opsNum * 0.1);
+
+    for (int i = 0; i < warmUp; ++i)
+    {
+        stack.push(1);
+    }
+    MPI_Barrier(comm);
+    std::random_device rd;
+    std::mt19937 mt(rd());
+    std::uniform_int_distribution<int> dist(0, 50);
+
+    rma_stack::StackScheduler scheduler;
+    rma_stack::CoroutineStack<StackImpl> coroutineStack(static_cast<StackImpl&>(stack), scheduler);
+
+    size_t pushCnt{0};
+    size_t popCnt{0};
+    size_t emptyPopCnt{0};
+    // Суммы помещённых и извлечённых значений для проверки после измерения.
+    auto pushedSum = static_cast<uint64_t>(warmUp);
+    uint64_t poppedSum{0};
+
+    auto worker = [&](int workerOpsNum) -> rma_stack::StackTask {
+        for (int i = 0; i < workerOpsNum; ++i)
+        {
+            int e = dist(mt);
+            if (e > 25)
+            {
+                if (co_await coroutineStack.push(e))
+                    pushedSum += e;
+                ++pushCnt;
+            }
+            else
+            {
+                if (auto elem = co_await coroutineStack.pop())
+                    poppedSum += *elem;
+                else
+                    ++emptyPopCnt;
+                ++popCnt;
+            }
+            std::this_thread::sleep_for(workload);
+        }
+    };
+
+    const double tBeginSec = MPI_Wtime();
+    for (size_t i = 0; i < coroutinesNum; ++i)
+    {
+        const auto workerOpsNum = static_cast<int>(opsNum / coroutinesNum + (i < opsNum % coroutinesNum ? 1 : 0));
+        scheduler.spawn(worker(workerOpsNum));
+    }
+    scheduler.run();
+    const double tEndSec = MPI_Wtime();
+
+    const double workloadSec = std::chrono::duration_cast<std::chrono::microseconds>(workload).count() / 1'000'000.0f;
+    const double tElapsedSec = tEndSec - tBeginSec - (opsNum * workloadSec);
+
+    double tTotalElapsedSec{0};
+    MPI_Allreduce(&tElapsedSec, &tTotalElapsedSec, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, elapsed (sec) {}, total (sec) {}", procNum, rank, tElapsedSec, tTotalElapsedSec);
+    SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}, coroutines {}", totalOpsNum, opsNum, coroutinesNum);
+    SPDLOG_LOGGER_INFO(pLogger, "push count {}, pop count {}, empty pop count {}, warm up {}", pushCnt, popCnt, emptyPopCnt, warmUp);
+
+    /*
+     * Операции сопрограмм завершаются не в порядке их начала, поэтому после измерения проверяется,
+     * что значения не потеряны и не извлечены дважды: оставшиеся в стеке значения извлекает процесс 0,
+     * а сумма извлечённых значений всех процессов сравнивается с суммой помещённых.
+     */
+    MPI_Barrier(comm);
+    if (rank == 0)
+    {
+        const int defaultElem{-1};
+        for (;;)
+        {
+            int elem{defaultElem};
+            stack.pop(elem, defaultElem);
+            if (elem == defaultElem)
+                break;
+            poppedSum += elem;
+        }
+    }
+    const uint64_t sums[2] = {pushedSum, poppedSum};
+    uint64_t totalSums[2] = {0, 0};
+    MPI_Allreduce(sums, totalSums, 2, MPI_UINT64_T, MPI_SUM, comm);
+    SPDLOG_LOGGER_INFO(pLogger, "total pushed sum {}, total popped sum {}", totalSums[0], totalSums[1]);
+    if (totalSums[0] != totalSums[1])
+        throw std::logic_error("values were lost or popped twice by out-of-order operations");
+
+    SPDLOG_INFO("finished 'runStackCoroutineRandomOperationBenchmarkTask'");
+}
+#endif
+
 /*
  * Задача для измерения продолжительности нескольких операций PUSH внешнего стека,
  * предназначена только для данных типа 'int'. workload - эмуляция сторонней нагрузки на приложение.
@@ -168,6 +714,7 @@ void runStackOnlyPushBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MP
 
     SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, elapsed (sec) {}, total (sec) {}", procNum, rank, tElapsedSec, tTotalElapsedSec);
     SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}", totalOpsNum, opsNum);
+    logStackStealStatistics(stack, comm, pLogger, 0);
 
     SPDLOG_INFO("finished 'runStackOnlyPushBenchmarkTask'");
 }
@@ -223,6 +770,125 @@ void runStackOnlyPopBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI
 
     SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, elapsed (sec) {}, total (sec) {}", procNum, rank, tElapsedSec, tTotalElapsedSec);
     SPDLOG_LOGGER_INFO(pLogger, "total ops {}, ops {}", totalOpsNum, opsNum);
+    logStackStealStatistics(stack, comm, pLogger, opsNum);
 
     SPDLOG_INFO("finished 'runStackOnlyPopBenchmarkTask'");
-}
\ No newline at end of file
+}
+
+/*
+ * Задача для измерения продолжительности операции PUSH внешнего стека в зависимости от заполненности
+ * массива узлов, предназначена только для данных типа 'int'. capacity - суммарное кол-во узлов стека
+ * на всех процессах. На каждом уровне заполненности процессы сначала совместно заполняют стек до этого
+ * уровня, затем измеряют продолжительность нескольких операций PUSH и возвращают стек к тому же уровню.
+ */
+template<typename StackImpl,
+        typename = EnableIfValueTypeIsInt<StackImpl>>
+void runStackOccupancyPushBenchmarkTask(stack_interface::IStack<StackImpl> &stack, MPI_Comm comm,
+                                        std::shared_ptr<spdlog::sinks::sink> loggerSink, int capacity)
+{
+    SPDLOG_INFO("started 'runStackOccupancyPushBenchmarkTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    auto procNum{0};
+    MPI_Comm_size(comm, &procNum);
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+
+    const int occupancyStepPercent{10};
+    const int maxOccupancyPercent{90};
+    // Замеры не должны выводить заполненность за пределы следующего уровня.
+    const int probeOpsNum = std::max(1, capacity * occupancyStepPercent / 100 / procNum / 2);
+
+    int pushedNum{0};
+    for (int occupancyPercent = 0; occupancyPercent <= maxOccupancyPercent; occupancyPercent += occupancyStepPercent)
+    {
+        const int levelPushedNum = capacity / 100 * occupancyPercent / procNum;
+        for (; pushedNum < levelPushedNum; ++pushedNum)
+        {
+            stack.push(pushedNum);
+        }
+        MPI_Barrier(comm);
+
+        const double tBeginSec = MPI_Wtime();
+        for (int i = 0; i < probeOpsNum; ++i)
+        {
+            stack.push(i);
+        }
+        const double tEndSec = MPI_Wtime();
+        const double tPushLatencyUsec = (tEndSec - tBeginSec) / probeOpsNum * 1'000'000.0;
+
+        double tMaxPushLatencyUsec{0};
+        MPI_Allreduce(&tPushLatencyUsec, &tMaxPushLatencyUsec, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+        SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, occupancy (%) {}, push latency (usec) {}, max push latency (usec) {}",
+                           procNum, rank, occupancyPercent, tPushLatencyUsec, tMaxPushLatencyUsec);
+
+        for (int i = 0; i < probeOpsNum; ++i)
+        {
+            int e{-1};
+            int defaultValue = -1;
+            stack.pop(e, defaultValue);
+        }
+        MPI_Barrier(comm);
+    }
+    SPDLOG_LOGGER_INFO(pLogger, "capacity {}, probe ops {}", capacity, probeOpsNum);
+
+    SPDLOG_INFO("finished 'runStackOccupancyPushBenchmarkTask'");
+}
+
+/*
+ * Задача для проверки поиска свободного слова битовой карты занятости: реализации без векторных операций
+ * и с AVX2 (если процессор его поддерживает) сравниваются на случайных битовых картах со случайными
+ * границами диапазона поиска. При расхождении результатов выбрасывается std::logic_error.
+ */
+inline void runNodeBitmapSearchCheckTask(std::shared_ptr<spdlog::sinks::sink> loggerSink)
+{
+    SPDLOG_INFO("started 'runNodeBitmapSearchCheckTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    namespace ref_counting = rma_stack::ref_counting;
+
+    const size_t checksNum{100'000};
+    const size_t maxWordsNum{67};
+    const bool avx2Supported = ref_counting::isNodeBitmapAvx2Supported();
+
+    std::mt19937_64 mt(checksNum);
+    std::vector<uint64_t> words(maxWordsNum);
+    size_t mismatchesNum{0};
+    for (size_t i = 0; i < checksNum; ++i)
+    {
+        // Заполненные слова преобладают, как в битовой карте почти заполненного массива узлов.
+        for (auto &rWord: words)
+            rWord = mt() % 8 == 0 ? mt() : ref_counting::NodeBitmapFullWord;
+
+        const size_t endWord = mt() % (maxWordsNum + 1);
+        const size_t beginWord = mt() % (endWord + 1);
+        const auto expected = std::find_if(words.begin() + static_cast<std::ptrdiff_t>(beginWord),
+                                           words.begin() + static_cast<std::ptrdiff_t>(endWord),
+                                           [](uint64_t word) {
+                                               return word != ref_counting::NodeBitmapFullWord;
+                                           }) - words.begin();
+
+        const auto scalar = ref_counting::findFirstNotFullWordScalar(words.data(), beginWord, endWord);
+        const auto dispatched = ref_counting::findFirstNotFullWord(words.data(), beginWord, endWord);
+        const auto avx2 = avx2Supported
+                          ? ref_counting::findFirstNotFullWordAvx2(words.data(), beginWord, endWord)
+                          : scalar;
+        if (scalar != static_cast<size_t>(expected) || avx2 != scalar || dispatched != scalar)
+            ++mismatchesNum;
+    }
+
+    SPDLOG_LOGGER_INFO(pLogger, "bitmap search checks {}, AVX2 supported {}, mismatches {}",
+                       checksNum, avx2Supported, mismatchesNum);
+    if (mismatchesNum > 0)
+        throw std::logic_error("the node bitmap search implementations disagree");
+
+    SPDLOG_INFO("finished 'runNodeBitmapSearchCheckTask'");
+}
@@ -11,6 +11,7 @@
 
 namespace rma_stack::ref_counting
 {
+    template<typename Layout = DefaultLayout>
     class CountedNodePtr
     {
     public:
@@ -25,14 +26,105 @@ namespace rma_stack::ref_counting
         bool incExternalCounter();
         [[nodiscard]] bool isDummy() const;
 
-        friend bool operator==(CountedNodePtr& lhs, CountedNodePtr& rhs);
-        friend bool operator!=(CountedNodePtr& lhs, CountedNodePtr& rhs);
+        template<typename L>
+        friend bool operator==(CountedNodePtr<L>& lhs, CountedNodePtr<L>& rhs);
+        template<typename L>
+        friend bool operator!=(CountedNodePtr<L>& lhs, CountedNodePtr<L>& rhs);
     private:
-        uint64_t m_offset               : OffsetBitsLimit;
-        uint64_t m_rank                 : RankBitsLimit;
-        uint64_t m_externalCounter      : ExternalCounterBitsLimit; // Внутренний счётчик ссылок на узел.
+        // Наибольшее значение внешнего счётчика ссылок.
+        static constexpr uint64_t ExternalCounterUpLimit = (uint64_t{1} << Layout::ExternalCounterBitsLimit) - 1;
+
+        uint64_t m_offset               : Layout::OffsetBitsLimit;
+        uint64_t m_rank                 : Layout::RankBitsLimit;
+        uint64_t m_externalCounter      : Layout::ExternalCounterBitsLimit; // Внутренний счётчик ссылок на узел.
     };
 
+    template<typename Layout>
+    uint64_t CountedNodePtr<Layout>::getExternalCounter() const
+    {
+        return m_externalCounter;
+    }
+
+    template<typename Layout>
+    uint64_t CountedNodePtr<Layout>::getRank() const
+    {
+        return m_rank;
+    }
+
+    template<typename Layout>
+    bool CountedNodePtr<Layout>::isDummy() const
+    {
+        return m_rank >= Layout::DummyRank;
+    }
+
+    template<typename Layout>
+    bool CountedNodePtr<Layout>::incExternalCounter()
+    {
+        if (m_externalCounter + 1u > ExternalCounterUpLimit)
+            return false;
+
+        ++m_externalCounter;
+        return true;
+    }
+
+    template<typename Layout>
+    CountedNodePtr<Layout>::CountedNodePtr():
+    m_offset(0),
+    m_rank(Layout::DummyRank),
+    m_externalCounter(0)
+    {
+        static_assert(sizeof(CountedNodePtr) == sizeof(uint64_t),
+                      "the counted node pointer must be changed by a single 64-bit atomic operation");
+    }
+
+    template<typename Layout>
+    uint64_t CountedNodePtr<Layout>::getOffset() const
+    {
+        return m_offset;
+    }
+
+    template<typename Layout>
+    bool CountedNodePtr<Layout>::setRank(uint64_t t_rank)
+    {
+        if (t_rank >= Layout::DummyRank)
+            return false;
+        m_rank = t_rank;
+        return true;
+    }
+
+    template<typename Layout>
+    bool CountedNodePtr<Layout>::setOffset(uint64_t t_offset) {
+        if (t_offset + 1 > Layout::MaxElemsNum)
+            return false;
+
+        m_offset = t_offset;
+        return true;
+    }
+
+    template<typename Layout>
+    bool operator==(CountedNodePtr<Layout>& lhs, CountedNodePtr<Layout>& rhs)
+    {
+        return
+        lhs.m_rank == rhs.m_rank
+        && lhs.m_offset == rhs.m_offset
+        && lhs.m_externalCounter == rhs.m_externalCounter;
+    }
+
+    template<typename Layout>
+    bool operator!=(CountedNodePtr<Layout> &lhs, CountedNodePtr<Layout> &rhs) {
+        return !(lhs == rhs);
+    }
+
+    template<typename Layout>
+    bool CountedNodePtr<Layout>::setExternalCounter(uint64_t t_externalCounter)
+    {
+        if (t_externalCounter + 1 > ExternalCounterUpLimit)
+            return false;
+
+        m_externalCounter = t_externalCounter;
+
+        return true;
+    }
 } // rma_stack
 
 #endif //SOURCES_COUNTEDNODEPTR_H
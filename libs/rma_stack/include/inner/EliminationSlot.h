@@ -0,0 +1,66 @@
+#ifndef SOURCES_ELIMINATIONSLOT_H
+#define SOURCES_ELIMINATIONSLOT_H
+
+#include <cstdint>
+
+#include "ref_counting.h"
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Состояния ячейки массива исключения.
+     * Empty - ячейка свободна.
+     * PushWaiting - операция PUSH ожидает партнёра, адрес - узел с уже записанными данными.
+     * PopWaiting - операция POP ожидает партнёра, ранг и смещение - номер процесса и номер попытки,
+     * чтобы разные попытки не совпадали по значению ячейки.
+     * Exchanged - узел передан от PUSH к POP, ячейку освобождает тот, кто её занял.
+     */
+    enum class EliminationSlotState: uint64_t
+    {
+        Empty       = 0,
+        PushWaiting = 1,
+        PopWaiting  = 2,
+        Exchanged   = 3
+    };
+
+    // Ячейка массива исключения, целиком изменяется одной атомарной операцией.
+    template<typename Layout = DefaultLayout>
+    struct EliminationSlot
+    {
+        uint64_t offset : Layout::OffsetBitsLimit;
+        uint64_t rank   : Layout::RankBitsLimit;
+        uint64_t state  : 64 - Layout::OffsetBitsLimit - Layout::RankBitsLimit;
+    };
+
+    template<typename Layout>
+    bool operator==(const EliminationSlot<Layout> &lhs, const EliminationSlot<Layout> &rhs)
+    {
+        return lhs.offset == rhs.offset
+        && lhs.rank == rhs.rank
+        && lhs.state == rhs.state;
+    }
+
+    template<typename Layout>
+    bool operator!=(const EliminationSlot<Layout> &lhs, const EliminationSlot<Layout> &rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    template<typename Layout>
+    EliminationSlot<Layout> makeEliminationSlot(EliminationSlotState state, uint64_t rank, uint64_t offset)
+    {
+        EliminationSlot<Layout> slot{};
+        slot.offset = offset;
+        slot.rank = rank;
+        slot.state = static_cast<uint64_t>(state);
+        return slot;
+    }
+
+    template<typename Layout>
+    EliminationSlotState getEliminationSlotState(const EliminationSlot<Layout> &slot)
+    {
+        return static_cast<EliminationSlotState>(slot.state);
+    }
+}
+
+#endif //SOURCES_ELIMINATIONSLOT_H
@@ -7,52 +7,1889 @@
 
 #include <utility>
 #include <cstddef>
+#include <chrono>
 #include <mpi.h>
 #include <spdlog/spdlog.h>
-#include <functional>
 #include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+#include <deque>
+#include <cstring>
 
 #include "CountedNodePtr.h"
 #include "Node.h"
+#include "NodeBitmap.h"
+#include "NodeMagazine.h"
+#include "NodeSegment.h"
+#include "EliminationSlot.h"
+#include "InnerStackStatistics.h"
+#include "InnerStackOptions.h"
+#include "InnerStackRequest.h"
+#include "RmaWindowSync.h"
+#include "IntraNodeWindow.h"
+#include "TraceLogging.h"
+#include "outer/BackoffPolicies.h"
 
 namespace rma_stack::ref_counting
 {
+        /*
+         * Layout - раскладка глобального указателя со счётчиком ссылок (CountedNodePtrLayout).
+         * Реализация явно инстанцирована для DefaultLayout, LargeJobLayout и SmallJobLayout.
+         */
+        template<typename Layout = DefaultLayout>
         class InnerStack
         {
         public:
+            using GlobalAddress     = ref_counting::GlobalAddress<Layout>;
+            using CountedNodePtr    = ref_counting::CountedNodePtr<Layout>;
+            using Node              = ref_counting::Node<Layout>;
+            using EliminationSlot   = ref_counting::EliminationSlot<Layout>;
+            using NodeMagazine      = ref_counting::NodeMagazine<Layout>;
+            using NodeSegmentLayout = ref_counting::NodeSegmentLayout<Layout>;
+            using Request           = ref_counting::InnerStackRequest<Layout>;
+
             static const int HEAD_RANK = 0;
 
+            // Проверка того, что номера всех процессов коммуникатора помещаются в раскладку Layout.
+            static void checkCommSize(MPI_Comm comm);
+
+            // t_inlinePayloadSize - размер данных пользователя, учитывается при включённом InnerStackOptions::inlinePayload.
             InnerStack(MPI_Comm comm, MPI_Info info, bool t_centralized, size_t t_elemsUpLimit,
-                       std::shared_ptr<spdlog::logger> t_logger);
-            void push(const std::function<void(GlobalAddress)> &putDataCallback,
-                      const std::function<void()> &backoffCallback);
-            void pop(const std::function<void(GlobalAddress)> &getDataCallback,
-                     const std::function<void()> &backoffCallback);
+                       std::shared_ptr<spdlog::logger> t_logger, const InnerStackOptions &t_rOptions = {},
+                       size_t t_inlinePayloadSize = 0);
+            /*
+             * Операции над одним значением принимают функции обратного вызова как параметры шаблона,
+             * поэтому запись и чтение данных пользователя и задержка встраиваются в код операции.
+             * putDataCallback и getDataCallback вызываются с адресом узла, backoffCallback - без параметров.
+             * putDataCallback PUSH только начинает запись данных пользователя, а flushDataCallback
+             * завершает её отдельным ожиданием после первой записи указателя на следующий узел,
+             * до публикации узла CAS головы.
+             * flushDataCallback вызывается, только если узел захвачен.
+             * push возвращает false при нехватке узлов, pop - если стек пуст.
+             */
+            template<typename PutDataCallback, typename FlushDataCallback, typename BackoffCallback>
+            bool push(const PutDataCallback &putDataCallback, const FlushDataCallback &flushDataCallback,
+                      const BackoffCallback &backoffCallback);
+            template<typename GetDataCallback, typename BackoffCallback>
+            bool pop(const GetDataCallback &getDataCallback, const BackoffCallback &backoffCallback);
+            /*
+             * POP с упреждающим чтением данных пользователя: prefetchDataCallback вызывается с адресом
+             * каждого узла-кандидата до чтения указателя на следующий узел, так что чтение данных
+             * выполняется одновременно с ним и с CAS головы. Узел, полученный исключением, также сначала
+             * передаётся prefetchDataCallback. getDataCallback вызывается с адресом узла, который был передан
+             * prefetchDataCallback последним, если операция удалась, и с фиктивным адресом, если стек пуст.
+             * Данные неудачных кандидатов отбрасывает вызывающий.
+             */
+            template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+            bool pop(const PrefetchDataCallback &prefetchDataCallback, const GetDataCallback &getDataCallback,
+                     const BackoffCallback &backoffCallback);
+            /*
+             * Пакетные операции принимают функции обратного вызова так же, как операции над одним значением:
+             * putDataCallback и getDataCallback вызываются с массивом адресов узлов и их кол-вом.
+             */
+            template<typename PutDataCallback, typename BackoffCallback>
+            size_t pushN(size_t count, const PutDataCallback &putDataCallback, const BackoffCallback &backoffCallback);
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t popN(size_t maxCount, const GetDataCallback &getDataCallback, const BackoffCallback &backoffCallback);
+
+            /*
+             * Операции над данными пользователя, которые хранятся внутри узлов (InnerStackOptions::inlinePayload).
+             * pushInline возвращает false при нехватке узлов, popInline - если стек пуст,
+             * пакетные операции возвращают кол-во добавленных или извлечённых значений.
+             */
+            template<typename BackoffCallback>
+            bool pushInline(const void *pValue, const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            bool popInline(void *pValue, const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            size_t pushNInline(size_t count, const void *pValues, const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            size_t popNInline(size_t maxCount, void *pValues, const BackoffCallback &backoffCallback);
+
+            /*
+             * Извлечение до maxCount значений из стека процесса victimRank (InnerStackOptions::workStealing).
+             * Возвращают кол-во забранных значений.
+             */
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t stealN(int victimRank, size_t maxCount, const GetDataCallback &getDataCallback,
+                          const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            size_t stealNInline(int victimRank, size_t maxCount, void *pValues, const BackoffCallback &backoffCallback);
+
+            /*
+             * Резервирование до maxCount свободных узлов пула процесса. Пакетные операции PUSH процесса
+             * сначала берут зарезервированные узлы, поэтому pushN до reserveNodes значений не может
+             * не найти узлы. releaseReservedNodes возвращает неиспользованные узлы в пул.
+             * reserveNodes возвращает кол-во зарезервированных узлов.
+             */
+            size_t reserveNodes(size_t maxCount);
+            void releaseReservedNodes();
+
+            /*
+             * Чтение до maxCount значений, начиная с вершины, без извлечения. Возвращают кол-во прочитанных
+             * значений. getDataCallback может вызываться несколько раз, если стек изменился во время чтения;
+             * действительны данные последнего вызова.
+             */
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t peekN(size_t maxCount, const GetDataCallback &getDataCallback, const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            size_t peekNInline(size_t maxCount, void *pValues, const BackoffCallback &backoffCallback);
+
+            /*
+             * Неблокирующие операции над данными внутри узлов, продвигаются вызовами Request::test и Request::wait.
+             * Значение pushInlineAsync копируется при вызове, значение popInlineAsync записывается в pValue
+             * при завершении операции, а если стек пуст - в него копируется pDefaultValue.
+             * Шаги от чтения головы до CAS головы операции процесса выполняют по очереди, остальные шаги перекрываются.
+             * Требуют inlinePayload и persistentLockAll, не используют разделяемую память узла
+             * и недоступны при workStealing.
+             */
+            void pushInlineAsync(const void *pValue, Request &rRequest);
+            void popInlineAsync(void *pValue, const void *pDefaultValue, Request &rRequest);
+            bool testRequest(Request &rRequest);
+
             void release();
             [[nodiscard]] size_t getElemsUpLimit() const;
+            [[nodiscard]] bool hasInlinePayload() const;
+            [[nodiscard]] bool hasStaticWindows() const;
+            [[nodiscard]] bool hasIntraNodeSharedMemory() const;
+            [[nodiscard]] bool hasWorkStealing() const;
+            [[nodiscard]] bool hasPopPayloadPrefetch() const;
+            [[nodiscard]] size_t getStealBatchSize() const;
+            [[nodiscard]] int getRank() const;
+            [[nodiscard]] int getProcNum() const;
+            [[nodiscard]] const RmaWindowSync &getWindowSync() const;
+            [[nodiscard]] const InnerStackStatistics &getStatistics() const;
+
+            /*
+             * Оценка конкуренции за голову (InnerStackOptions::contentionSamplingPeriod) - среднее кол-во
+             * неудачных CAS головы на одну операцию всех процессов, 0 - если оценка не используется.
+             * Вызывается в начале каждой операции, счётчики головы читаются раз в период выборки.
+             */
+            double sampleContentionLevel();
+
+            /*
+             * Границы задержки после неудачного CAS головы списка свободных узлов, внешние стеки
+             * задают свои границы задержки. Без них CAS повторяется сразу.
+             */
+            void setFreeListBackoffDelays(const std::chrono::nanoseconds &minDelay,
+                                          const std::chrono::nanoseconds &maxDelay);
+
+            /*
+             * Размер стека. При счётчике размера (InnerStackOptions::sizeCounterShardsNum) - приближённый,
+             * по общим счётчикам: sizeCounterShardsNum чтений, завершаемых одним ожиданием. Без счётчика -
+             * точный, обходом списка от вершины; если голова изменилась во время обхода, то после
+             * backoffCallback обход повторяется. При workStealing складываются размеры стеков всех процессов.
+             */
+            template<typename BackoffCallback>
+            [[nodiscard]] size_t getSize(const BackoffCallback &backoffCallback);
+            [[nodiscard]] bool hasSizeCounter() const;
+            // Проверка пустоты чтением головы, при workStealing - голов всех процессов.
+            [[nodiscard]] bool isEmpty();
 
             void printStack(); // функция не потокобезопасная
         private:
+            template<typename PutDataCallback, typename FlushDataCallback, typename BackoffCallback>
+            GlobalAddress pushImpl(const PutDataCallback &putDataCallback,
+                                   const FlushDataCallback &flushDataCallback,
+                                   const void *pPayload,
+                                   const BackoffCallback &backoffCallback);
+            template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+            bool popImpl(const PrefetchDataCallback &prefetchDataCallback,
+                         const GetDataCallback &getDataCallback,
+                         void *pPayload,
+                         const BackoffCallback &backoffCallback);
+            template<typename PutDataCallback, typename BackoffCallback>
+            size_t pushNImpl(size_t count,
+                             const PutDataCallback &putDataCallback,
+                             const void *pPayloads,
+                             const BackoffCallback &backoffCallback);
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t popNImpl(size_t maxCount,
+                            const GetDataCallback &getDataCallback,
+                            void *pPayloads,
+                            const BackoffCallback &backoffCallback);
+
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t peekNImpl(size_t maxCount,
+                             const GetDataCallback &getDataCallback,
+                             void *pPayloads,
+                             const BackoffCallback &backoffCallback);
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t stealNImpl(int victimRank, size_t maxCount,
+                              const GetDataCallback &getDataCallback,
+                              void *pPayloads,
+                              const BackoffCallback &backoffCallback);
+            void setHeadRank(int rank);
+
+            void checkAsyncSupport(const Request &rRequest) const;
+            void startRequest(Request &rRequest, InnerStackRequestType type);
+            void progressPushRequest(Request &rRequest);
+            void progressPopRequest(Request &rRequest);
+            void progressPopRequestWithEpochs(Request &rRequest);
+            void startHeadPhase(Request &rRequest);
+            void finishHeadPhase();
+            void startHeadRead(Request &rRequest);
+            void startHeadCountIncrease(Request &rRequest);
+            void startNodeWrite(Request &rRequest);
+            void startNodeRead(Request &rRequest);
+            void swapRequestHead(Request &rRequest);
+            void startInternalCounterUpdate(Request &rRequest, int32_t countIncrease);
+            void flushRequestNode(const Request &rRequest);
+            [[nodiscard]] bool compareAndSwapRequestHead(Request &rRequest, const CountedNodePtr &newCountedNodePtr);
+            void startNodeRelease(Request &rRequest);
+            void progressNodeRelease(Request &rRequest);
+            void startFreeNodeWrite(Request &rRequest);
+            [[nodiscard]] bool compareAndSwapRequestFreeList(Request &rRequest);
+            void finishPopAttempt(Request &rRequest);
+            void leaveAsyncPopEpoch(Request &rRequest);
+            void completeRequest(Request &rRequest, bool result);
+            [[nodiscard]] bool hasLocalHead() const;
+            [[nodiscard]] MPI_Aint getHeadSize() const;
+            void countHeadCasFailure();
+            void addSize(int64_t sizeIncrease);
+            void publishSize();
+            [[nodiscard]] size_t readSizeCounters();
+            template<typename BackoffCallback>
+            [[nodiscard]] size_t countNodes(const BackoffCallback &backoffCallback);
+
             void initRemoteAccessMemory(MPI_Comm comm, MPI_Info info);
+            void initStaticWindows(MPI_Comm comm, MPI_Info info);
+            void initDynamicWindows(MPI_Comm comm, MPI_Info info);
+            void initNodesArr();
+            void initNodeSegments(MPI_Comm comm);
+            void initEliminationArray(MPI_Comm comm, MPI_Info info);
+            void initEpochs(MPI_Comm comm, MPI_Info info);
+            void initSizeCounters(MPI_Comm comm, MPI_Info info);
             void increaseHeadCount(CountedNodePtr& oldHeadCountedNodePtr);
-            [[nodiscard]] GlobalAddress acquireNode(int rank) const;
+            [[nodiscard]] GlobalAddress acquireNode(int rank);
+            void releaseNode(GlobalAddress nodeAddress);
+            void releaseNodeReference(GlobalAddress nodeAddress);
+
+            size_t acquireNodes(int rank, size_t maxCount, GlobalAddress *pNodeAddresses);
+            size_t acquireNodesFromFreeList(int rank, size_t maxCount, GlobalAddress *pNodeAddresses);
+            size_t acquireNodesFromSegmentFreeList(int rank, size_t slot, size_t maxCount, GlobalAddress *pNodeAddresses);
+            size_t acquireNodesFromBitmap(int rank, size_t maxCount, GlobalAddress *pNodeAddresses);
+            void releaseNodes(const GlobalAddress *pNodeAddresses, size_t count);
+            void releaseNodesToFreeList(const GlobalAddress *pNodeAddresses, size_t count);
+            void releaseNodesToSegmentFreeList(const GlobalAddress *pNodeAddresses, size_t count);
+            void backoffFreeList();
+            void releaseNodesToBitmap(const GlobalAddress *pNodeAddresses, size_t count);
 
-            void releaseNode(GlobalAddress nodeAddress) const;
+            size_t acquireNodesBatch(int rank, size_t maxCount, GlobalAddress *pNodeAddresses);
+            void releaseDetachedNodes(size_t count);
+            void readNodeNext(GlobalAddress nodeAddress, CountedNodePtr &rCountedNodePtrNext, void *pPayload);
+            void getNodeNext(GlobalAddress nodeAddress, CountedNodePtr &rCountedNodePtrNext, void *pPayload);
+            [[nodiscard]] void *getPayloadSlot(void *pPayloads, size_t index) const;
+
+            template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+            bool popWithEpochs(const PrefetchDataCallback &prefetchDataCallback,
+                               const GetDataCallback &getDataCallback,
+                               void *pPayload,
+                               const BackoffCallback &backoffCallback);
+            template<typename GetDataCallback, typename BackoffCallback>
+            size_t popNWithEpochs(size_t maxCount,
+                                  const GetDataCallback &getDataCallback,
+                                  void *pPayloads,
+                                  const BackoffCallback &backoffCallback);
+            void enterEpoch();
+            void leaveEpoch();
+            void publishEpoch();
+            void readEpochs(std::vector<uint64_t> &rEpochs);
+            [[nodiscard]] bool haveEpochsPassed(const std::vector<uint64_t> &rEpochs,
+                                                const std::vector<uint64_t> &rCurrentEpochs) const;
+            void retireNode(GlobalAddress nodeAddress);
+            size_t reclaimRetiredNodes();
+            void freeRetiredNodes(const std::vector<GlobalAddress> &nodeAddresses);
+
+            void refillNodeMagazine();
+            void drainNodeMagazine(size_t count);
+            [[nodiscard]] int getNodePoolRank() const;
+
+            template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+            bool eliminatePop(const PrefetchDataCallback &prefetchDataCallback,
+                              const GetDataCallback &getDataCallback,
+                              void *pPayload,
+                              const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            bool tryEliminatePush(GlobalAddress nodeAddress, const BackoffCallback &backoffCallback);
+            template<typename BackoffCallback>
+            bool tryEliminatePop(const BackoffCallback &backoffCallback, GlobalAddress &rNodeAddress);
+            void chooseEliminationSlot(int &rSlotRank, MPI_Aint &rSlotOffset);
+            void compareAndSwapEliminationSlot(const EliminationSlot &newSlot, const EliminationSlot &oldSlot,
+                                               EliminationSlot &rResSlot, int slotRank, MPI_Aint slotOffset) const;
+            void replaceEliminationSlot(const EliminationSlot &newSlot, int slotRank, MPI_Aint slotOffset) const;
+
+            // Растущий пул узлов (InnerStackOptions::elasticNodePool).
+            bool growNodePool();
+            void tryShrinkNodePool();
+            void detachNodeSegments();
+            void detachNodeSegment(size_t slot);
+            void initNodeSegment(void *pSegment, size_t nodesNum);
+            void addNodeSegmentUsedCount(int rank, size_t slot, int64_t countIncrease);
+            void startNodeSegmentReleasesPublication(int rank);
+            void publishNodeSegmentReleases();
+            [[nodiscard]] uint64_t getNodeIndex(uint64_t offset) const;
+            [[nodiscard]] int64_t getNodeSegmentUsedCount(size_t slot) const;
+            [[nodiscard]] size_t getNodeSegmentNodesNum(size_t slot) const;
+            [[nodiscard]] MPI_Aint getNodeSegmentSize(size_t nodesNum) const;
+            [[nodiscard]] MPI_Aint getNodeSegmentBaseAddress(int rank, uint64_t offset) const;
+            [[nodiscard]] MPI_Aint getNodeOffset(int rank, uint64_t offset) const;
+            [[nodiscard]] MPI_Aint getNodeNextOffset(GlobalAddress nodeAddress) const;
+            [[nodiscard]] MPI_Aint getNodeInternalCounterOffset(GlobalAddress nodeAddress) const;
+            [[nodiscard]] MPI_Aint getNodePayloadOffset(GlobalAddress nodeAddress) const;
+            [[nodiscard]] MPI_Aint getFreeListHeadOffset(int rank, uint64_t nodeOffset) const;
+            [[nodiscard]] MPI_Aint getNodeSegmentUsedCountOffset(int rank, size_t slot) const;
+            [[nodiscard]] MPI_Aint getNodeBitmapOffset(int rank) const;
+            [[nodiscard]] MPI_Aint getNodesArrSize() const;
+            [[nodiscard]] MPI_Aint getNodeArrBaseAddress(int rank) const;
+            [[nodiscard]] MPI_Aint getEpochBaseAddress(int rank) const;
+            [[nodiscard]] MPI_Aint getEliminationSlotsBaseAddress(int rank) const;
         private:
             size_t m_elemsUpLimit{0};
             int m_rank{-1};
+            int m_procNum{0};
             bool m_centralized;
+            InnerStackOptions m_options;
+            RmaWindowSync m_windowSync;
+            size_t m_inlinePayloadSize{0};
+            size_t m_nodeSize{sizeof(Node)}; // Шаг узлов в массиве узлов.
+            // Указатель на следующий узел и данные пользователя, передаваемые одной операцией.
+            std::vector<unsigned char> m_nodeImage;
+
+            // Окна в разделяемой памяти узла, обращения к которым выполняются без MPI RMA.
+            bool m_intraNodeSharedMemory{false};
+            IntraNodeWindow m_intraNodeHeadWin;
+            IntraNodeWindow m_intraNodeNodesWin;
+            IntraNodeWindow m_intraNodeEpochsWin;
 
             MPI_Win m_headWin{MPI_WIN_NULL};
             CountedNodePtr* m_pHeadCountedNodePtr{nullptr};
             MPI_Aint m_headAddress{(MPI_Aint)MPI_BOTTOM};
+            // Процесс, голова которого является целью операций, и адреса голов всех процессов при workStealing.
+            int m_headRank{HEAD_RANK};
+            std::unique_ptr<MPI_Aint[]> m_pBaseHeadAddresses;
             MPI_Win m_nodesWin{MPI_WIN_NULL};
-            Node* m_pNodesArr{nullptr};
+            Node* m_pNodesArr{nullptr}; // Узлы расположены с шагом m_nodeSize.
             std::unique_ptr<MPI_Aint[]> m_pBaseNodeArrAddresses;
+            uint64_t* m_pNodeBitmap{nullptr};
+
+            // Слово битовой карты, в котором последний раз удалось захватить узел, и его известное значение.
+            int m_bitmapHintRank{-1};
+            size_t m_bitmapWordHint{0};
+            uint64_t m_bitmapWordCache{0};
+            // Маски слов битовой карты и их прежние значения при возврате узлов, буферы RMA-операций.
+            std::vector<std::pair<size_t, uint64_t>> m_bitmapReleaseWordMasks;
+            std::vector<uint64_t> m_bitmapReleaseResWords;
+
+            NodeMagazine m_nodeMagazine;
+            std::unique_ptr<GlobalAddress[]> m_pNodeAddressesBuffer;
+            // Узлы пула процесса, зарезервированные reserveNodes.
+            std::vector<GlobalAddress> m_reservedNodeAddresses;
+            /*
+             * Сегменты пула узлов текущего процесса: нулевой - m_pNodesArr, остальные выделяются по требованию.
+             * Таблица сегментов присоединена к окну узлов, записи таблиц других процессов кэшируются.
+             */
+            struct NodeSegment
+            {
+                unsigned char *pMemory{nullptr};
+                MPI_Aint baseAddress{0};
+                size_t nodesNum{0};
+                uint64_t generation{0};
+                bool active{false};
+                bool retired{false}; // Все поколения сегмента использованы, сегмент больше не выделяется.
+                // Сегмент освобождён, но остаётся присоединённым к окну, пока не сменятся эпохи detachEpochs.
+                bool detaching{false};
+                std::vector<uint64_t> detachEpochs;
+                // Захваченные узлы сегмента за вычетом возвращённых самим процессом, см. addNodeSegmentUsedCount.
+                int64_t usedCount{0};
+            };
+            std::vector<NodeSegment> m_nodeSegments;
+            size_t m_nodeSegmentSize{0};
+            size_t m_acquiresSinceShrinkCheck{0};
+            NodeSegmentDescriptor *m_pNodeSegmentTable{nullptr}; // За таблицей - счётчики занятых узлов сегментов.
+            int64_t *m_pNodeSegmentUsedCounts{nullptr};
+            std::unique_ptr<MPI_Aint[]> m_pBaseNodeSegmentTableAddresses;
+            mutable std::vector<NodeSegmentDescriptor> m_nodeSegmentTablesCache;
+            /*
+             * Возвращённые процессом узлы сегментов других процессов (по процессам и слотам), ещё не вычтенные
+             * из их счётчиков занятых узлов, и буфер их отправки.
+             */
+            std::vector<int64_t> m_pendingNodeSegmentReleases;
+            std::vector<int64_t> m_publishedNodeSegmentReleases;
+            size_t m_nodeSegmentReleasesNum{0};
+            // Узлы, упорядоченные по сегментам при возврате в списки свободных узлов.
+            std::vector<GlobalAddress> m_releaseNodeAddresses;
+            // Индексы следующих узлов цепочки, возвращаемой в список свободных узлов.
+            std::vector<uint32_t> m_releaseNextFreeIndices;
+            std::optional<TruncatedExponentialBackoff> m_freeListBackoff;
+
+            // Буферы пакетных операций, используются как исходные буферы RMA-операций.
+            std::vector<GlobalAddress> m_batchNodeAddresses;
+            std::vector<CountedNodePtr> m_batchCountedNodePtrs;
+            std::vector<int32_t> m_batchCountIncreases;
+            std::vector<int32_t> m_batchInternalCounts;
+            std::vector<unsigned char> m_batchNodeImages;
+
+            MPI_Win m_eliminationWin{MPI_WIN_NULL};
+            EliminationSlot* m_pEliminationSlots{nullptr};
+            std::unique_ptr<MPI_Aint[]> m_pBaseEliminationSlotsAddresses;
+            std::mt19937 m_eliminationRandomEngine;
+            uint64_t m_eliminationSequence{0};
+
+            // Пачка извлечённых узлов и эпохи всех процессов на момент её закрытия.
+            struct RetiredNodesBatch
+            {
+                std::vector<GlobalAddress> nodeAddresses;
+                std::vector<uint64_t> epochs;
+            };
+
+            MPI_Win m_epochsWin{MPI_WIN_NULL};
+            uint64_t* m_pEpoch{nullptr};
+            uint64_t m_epoch{0};
+            // Вложенные вызовы enterEpoch, эпоха меняется только на внешнем уровне.
+            size_t m_epochNesting{0};
+            /*
+             * Неблокирующие POP, вошедшие в текущую эпоху. Если в ней закрыта пачка извлечённых узлов,
+             * то новые POP ожидают завершения текущих, чтобы эпоха процесса сменилась.
+             */
+            std::vector<Request*> m_asyncPopRequests;
+            bool m_asyncEpochDraining{false};
+            /*
+             * Неблокирующая операция процесса, которая выполняет шаги от чтения головы до CAS головы.
+             * Остальные ожидают в очереди, иначе операции одного процесса изменяли бы голову,
+             * на которой ожидают CAS другие, и CAS большинства из них завершался бы неудачей.
+             */
+            Request *m_pHeadRequest{nullptr};
+            std::deque<Request*> m_headWaitingRequests;
+            uint64_t m_headRequestTestsNum{0};
+            std::unique_ptr<MPI_Aint[]> m_pBaseEpochAddresses;
+            std::vector<uint64_t> m_epochsSnapshot;
+            std::vector<GlobalAddress> m_retiredNodes;
+            std::deque<RetiredNodesBatch> m_retiredNodesBatches;
+
+            InnerStackStatistics m_statistics;
+
+            // Оценка конкуренции за голову: операции процесса с последней выборки и значения счётчиков при ней.
+            size_t m_contentionOpsNum{0};
+            uint64_t m_sampledHeadOpsNum{0};
+            uint64_t m_sampledHeadCasFailuresNum{0};
+            double m_contentionLevel{0.0};
+
+            // Общие счётчики размера и изменение размера процесса, ещё не добавленное к ним.
+            MPI_Win m_sizeWin{MPI_WIN_NULL};
+            int64_t* m_pSizeCounter{nullptr};
+            int m_sizeCounterShardsNum{0};
+            // Значения общих счётчиков, прочитанные getSize.
+            std::vector<int64_t> m_sizeCounterShards;
+            int64_t m_unpublishedSizeIncrease{0};
+            int64_t m_publishedSizeIncrease{0};
+            size_t m_sizeOpsNum{0};
 
             std::shared_ptr<spdlog::logger> m_logger;
         };
 
+    template<typename Layout>
+    template<typename PutDataCallback, typename FlushDataCallback, typename BackoffCallback>
+    bool InnerStack<Layout>::push(const PutDataCallback &putDataCallback, const FlushDataCallback &flushDataCallback,
+                                  const BackoffCallback &backoffCallback)
+    {
+        if (isGlobalAddressDummy(pushImpl(putDataCallback, flushDataCallback, nullptr, backoffCallback)))
+            return false;
+
+        addSize(1);
+        return true;
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    bool InnerStack<Layout>::pushInline(const void *pValue, const BackoffCallback &backoffCallback)
+    {
+        const auto nodeAddress = pushImpl([](GlobalAddress) {}, [](GlobalAddress) {}, pValue, backoffCallback);
+        if (isGlobalAddressDummy(nodeAddress))
+            return false;
+
+        addSize(1);
+        return true;
+    }
+
+    /*
+     * Если pPayload не равен nullptr, то данные пользователя записываются в узел
+     * той же операцией MPI_Put, что и указатель на следующий узел, а putDataCallback и flushDataCallback
+     * не вызываются. Возвращает адрес добавленного узла или фиктивный адрес при нехватке узлов.
+     * Без конкуренции PUSH ожидает чтения головы, записи указателя и CAS головы - 3 ожидания MPI_Win_flush
+     * только при данных внутри узла. Иначе данные пишутся в отдельное окно, а MPI_Win_flush завершает
+     * операции только одного окна, поэтому запись данных завершается четвёртым ожиданием flushDataCallback;
+     * запись лишь начинается до чтения головы, так что к этому ожиданию она, как правило, уже выполнена.
+     */
+    template<typename Layout>
+    template<typename PutDataCallback, typename FlushDataCallback, typename BackoffCallback>
+    GlobalAddress<Layout> InnerStack<Layout>::pushImpl(const PutDataCallback &putDataCallback,
+                                                       const FlushDataCallback &flushDataCallback,
+                                                       const void *pPayload,
+                                                       const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'push'");
+
+        auto nodeAddress = acquireNode(getNodePoolRank());
+        if (isGlobalAddressDummy(nodeAddress)
+            && m_options.reclamationType == ReclamationType::Epochs
+            && reclaimRetiredNodes() > 0)
+        {
+            nodeAddress = acquireNode(getNodePoolRank());
+        }
+        if (isGlobalAddressDummy(nodeAddress))
+        {
+            putDataCallback(nodeAddress);
+            RMA_STACK_TRACE(m_logger, "failed to find free node in 'push'");
+            return nodeAddress;
+        }
+        {
+            const auto r = nodeAddress.rank;
+            const auto o = nodeAddress.offset;
+            RMA_STACK_TRACE(m_logger, "acquired free node (rank - {}, offset - {}) in 'push'", r, o);
+        }
+
+        ++m_statistics.pushesNum;
+        CountedNodePtr resHeadCountedNodePtr;
+
+        /*
+         * Получение текущей головы списка. Запись данных пользователя начинается до ожидания чтения головы,
+         * поэтому к своему ожиданию после первой записи указателя на следующий узел она, как правило,
+         * уже выполнена. При inlinePayload данные записываются вместе с указателем и отдельного ожидания нет.
+         */
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &resHeadCountedNodePtr,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      m_headAddress,
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+
+        if (pPayload == nullptr)
+        {
+            putDataCallback(nodeAddress);
+            RMA_STACK_TRACE(m_logger, "put data in 'push'");
+        }
+        else
+        {
+            std::memcpy(m_nodeImage.data() + sizeof(CountedNodePtr), pPayload, m_inlinePayloadSize);
+        }
+
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+        ++m_statistics.pushRoundTripsNum;
+
+        RMA_STACK_TRACE(m_logger, "fetched head (rank - {}, offset - {})", resHeadCountedNodePtr.getRank(), resHeadCountedNodePtr.getOffset());
+
+        RMA_STACK_TRACE(m_logger, "started new head pushing in 'push'");
+
+        CountedNodePtr newCountedNodePtr;
+        newCountedNodePtr.setRank(nodeAddress.rank);
+        newCountedNodePtr.setOffset(nodeAddress.offset);
+        newCountedNodePtr.incExternalCounter();
+
+        CountedNodePtr oldHeadCountedNodePtr;
+        CountedNodePtr countedNodePtrNext;
+
+        const MPI_Aint countedNodePtrNextOffset = getNodeNextOffset(nodeAddress);
+
+        /*
+         * Пока не удастся заменить текущую голову списка операцией на новый узел
+         * операцией CAS, перезаписывать глобальный указатель на следующий узел
+         * нового узла текущей головой списка.
+         */
+        bool isDataFlushed = pPayload != nullptr;
+        m_windowSync.lock(nodeAddress.rank, m_nodesWin);
+        do
+        {
+            countedNodePtrNext = resHeadCountedNodePtr;
+            if (pPayload == nullptr)
+            {
+                m_intraNodeNodesWin.put(&countedNodePtrNext,
+                                        1,
+                                        MPI_UINT64_T,
+                                        nodeAddress.rank,
+                                        countedNodePtrNextOffset,
+                                        1,
+                                        MPI_UINT64_T,
+                                        m_nodesWin
+                );
+            }
+            else
+            {
+                // Указатель на следующий узел и данные пользователя записываются одной операцией.
+                std::memcpy(m_nodeImage.data(), &countedNodePtrNext, sizeof(CountedNodePtr));
+                const auto nodeImageSize = static_cast<int>(m_nodeImage.size());
+                m_intraNodeNodesWin.put(m_nodeImage.data(),
+                                        nodeImageSize,
+                                        MPI_BYTE,
+                                        nodeAddress.rank,
+                                        countedNodePtrNextOffset,
+                                        nodeImageSize,
+                                        MPI_BYTE,
+                                        m_nodesWin
+                );
+            }
+            m_intraNodeNodesWin.flush(nodeAddress.rank, m_nodesWin);
+            if (!isDataFlushed)
+            {
+                flushDataCallback(nodeAddress);
+                isDataFlushed = true;
+                ++m_statistics.pushRoundTripsNum;
+                RMA_STACK_TRACE(m_logger, "flushed data in 'push'");
+            }
+
+            oldHeadCountedNodePtr = resHeadCountedNodePtr;
+
+            m_intraNodeHeadWin.compareAndSwap(&newCountedNodePtr,
+                                              &oldHeadCountedNodePtr,
+                                              &resHeadCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+            m_statistics.pushRoundTripsNum += 2;
+
+            if (resHeadCountedNodePtr != oldHeadCountedNodePtr)
+            {
+                countHeadCasFailure();
+                if (m_options.eliminationArraySize > 0)
+                {
+                    RMA_STACK_TRACE(m_logger, "started to try elimination in 'push'");
+                    if (tryEliminatePush(nodeAddress, backoffCallback))
+                    {
+                        RMA_STACK_TRACE(m_logger, "node was eliminated in 'push'");
+                        break;
+                    }
+                }
+                else
+                {
+                    RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+                    backoffCallback();
+                    RMA_STACK_TRACE(m_logger, "executed backoff callback");
+                }
+            }
+        }
+        while (resHeadCountedNodePtr != oldHeadCountedNodePtr);
+
+        m_windowSync.unlock(m_headRank, m_headWin);
+        m_windowSync.unlock(nodeAddress.rank, m_nodesWin);
+
+        RMA_STACK_TRACE(m_logger, "finished 'push'");
+        return nodeAddress;
+    }
+
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    bool InnerStack<Layout>::pop(const GetDataCallback &getDataCallback, const BackoffCallback &backoffCallback)
+    {
+        if (!popImpl([](GlobalAddress) {}, getDataCallback, nullptr, backoffCallback))
+            return false;
+
+        addSize(-1);
+        return true;
+    }
+
+    template<typename Layout>
+    template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+    bool InnerStack<Layout>::pop(const PrefetchDataCallback &prefetchDataCallback,
+                                 const GetDataCallback &getDataCallback,
+                                 const BackoffCallback &backoffCallback)
+    {
+        if (!popImpl(prefetchDataCallback, getDataCallback, nullptr, backoffCallback))
+            return false;
+
+        addSize(-1);
+        return true;
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    bool InnerStack<Layout>::popInline(void *pValue, const BackoffCallback &backoffCallback)
+    {
+        if (!popImpl([](GlobalAddress) {}, [](GlobalAddress) {}, pValue, backoffCallback))
+            return false;
+
+        addSize(-1);
+        return true;
+    }
+
+    /*
+     * Если pPayload не равен nullptr, то данные пользователя читаются из узла той же операцией
+     * MPI_Get, что и указатель на следующий узел, а getDataCallback не вызывается.
+     * Возвращает false, если стек пуст.
+     */
+    template<typename Layout>
+    template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+    bool InnerStack<Layout>::popImpl(const PrefetchDataCallback &prefetchDataCallback,
+                                     const GetDataCallback &getDataCallback,
+                                     void *pPayload,
+                                     const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'pop'");
+
+        if (m_options.reclamationType == ReclamationType::Epochs)
+        {
+            const auto popped = popWithEpochs(prefetchDataCallback, getDataCallback, pPayload, backoffCallback);
+            RMA_STACK_TRACE(m_logger, "finished 'pop'");
+            return popped;
+        }
+
+        bool popped{false};
+
+        CountedNodePtr oldHeadCountedNodePtr;
+
+        // Чтение текущей головы односвязного списка.
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &oldHeadCountedNodePtr,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      m_headAddress,
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+        {
+            const auto r = oldHeadCountedNodePtr.getRank();
+            const auto o = oldHeadCountedNodePtr.getOffset();
+            const auto e = oldHeadCountedNodePtr.getExternalCounter();
+            RMA_STACK_TRACE(m_logger, "fetched head (rank - {}, offset - {}, ext_cnt - {}) before loop in 'pop'", r, o, e);
+        }
+        for (;;)
+        {
+            // Увеличение кол-во внешних ссылок на голову на 1.
+            increaseHeadCount(oldHeadCountedNodePtr);
+            {
+                const auto r = oldHeadCountedNodePtr.getRank();
+                const auto o = oldHeadCountedNodePtr.getOffset();
+                const auto e = oldHeadCountedNodePtr.getExternalCounter();
+                RMA_STACK_TRACE(m_logger, "head (rank - {}, offset - {}, ext_cnt - {})) after increaseHeadCount in 'pop'", r, o, e);
+            }
+            GlobalAddress nodeAddress = {
+                    oldHeadCountedNodePtr.getOffset(),
+                    oldHeadCountedNodePtr.getRank(),
+                    0
+            };
+            if (isGlobalAddressDummy(nodeAddress))
+            {
+                /*
+                 * Если глобальный указатель указывает на NULL, то стек пуст,
+                 * и нужно сообщить об этом пользователю, а затем завершить POP.
+                 */
+                getDataCallback(nodeAddress);
+                break;
+            }
+
+            /*
+             * Получение указателя на следующий за головой списка узел
+             * с последующей заменой головы на этот узел операцией CAS.
+             */
+            CountedNodePtr countedNodePtrNext;
+
+            prefetchDataCallback(nodeAddress);
+            m_windowSync.lock(nodeAddress.rank, m_nodesWin);
+            getNodeNext(nodeAddress, countedNodePtrNext, pPayload);
+
+            {
+                const auto r = countedNodePtrNext.getRank();
+                const auto o = countedNodePtrNext.getOffset();
+                const auto e = countedNodePtrNext.getExternalCounter();
+                RMA_STACK_TRACE(m_logger, "ptr->next (rank - {}, offset - {}, ext_cnt - {})) in 'pop'", r, o, e);
+            }
+
+            CountedNodePtr resHeadCountedNodePtr;
+
+            m_intraNodeHeadWin.compareAndSwap(&countedNodePtrNext,
+                                              &oldHeadCountedNodePtr,
+                                              &resHeadCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+            bool popComplete{false};
+            if (resHeadCountedNodePtr == oldHeadCountedNodePtr)
+            {
+                if (pPayload == nullptr)
+                    getDataCallback(nodeAddress);
+
+                const auto internalCounterOffset = getNodeInternalCounterOffset(nodeAddress);
+
+                const auto externalCount    = static_cast<int32_t>(oldHeadCountedNodePtr.getExternalCounter());
+                const int32_t countIncrease = externalCount - 2;
+                int32_t resInternalCount{0};
+                // Атомарное уменьшение внутреннего счётчика на кол-во внешних ссылок минус 2.
+                m_intraNodeNodesWin.fetchAndOp(
+                        &countIncrease,
+                        &resInternalCount,
+                        MPI_INT32_T,
+                        nodeAddress.rank,
+                        internalCounterOffset,
+                        MPI_SUM,
+                        m_nodesWin
+                );
+                m_intraNodeNodesWin.flush(nodeAddress.rank, m_nodesWin);
+
+                if (resInternalCount == -countIncrease)
+                    releaseNode(nodeAddress);
+
+                popComplete = true;
+            }
+            else
+            {
+                countHeadCasFailure();
+                const auto internalCounterOffset = getNodeInternalCounterOffset(nodeAddress);
+                const int64_t countIncrease{-1};
+                int64_t resInternalCount{0};
+                // Атомарное уменьшение внутреннего счётчика на 1.
+                m_intraNodeNodesWin.fetchAndOp(
+                        &countIncrease,
+                        &resInternalCount,
+                        MPI_INT32_T,
+                        nodeAddress.rank,
+                        internalCounterOffset,
+                        MPI_SUM,
+                        m_nodesWin
+                );
+                m_intraNodeNodesWin.flush(nodeAddress.rank, m_nodesWin);
+
+                if (resInternalCount == 1)
+                    releaseNode(nodeAddress);
+            }
+            m_windowSync.unlock(nodeAddress.rank, m_nodesWin);
+
+            if (popComplete)
+            {
+                popped = true;
+                break;
+            }
+
+            if (m_options.eliminationArraySize > 0)
+            {
+                if (eliminatePop(prefetchDataCallback, getDataCallback, pPayload, backoffCallback))
+                {
+                    popped = true;
+                    break;
+                }
+            }
+            else
+            {
+                RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+                backoffCallback();
+                RMA_STACK_TRACE(m_logger, "executed backoff callback");
+            }
+        }
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        RMA_STACK_TRACE(m_logger, "finished 'pop'");
+        return popped;
+    }
+
+    /*
+     * Операция POP при освобождении узлов по эпохам. Все узлы, которые видит операция,
+     * защищены объявленной эпохой процесса, поэтому счётчики ссылок не изменяются,
+     * а результат неудачного CAS сразу используется как текущая голова.
+     */
+    template<typename Layout>
+    template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+    bool InnerStack<Layout>::popWithEpochs(const PrefetchDataCallback &prefetchDataCallback,
+                                           const GetDataCallback &getDataCallback,
+                                           void *pPayload,
+                                           const BackoffCallback &backoffCallback)
+    {
+        enterEpoch();
+        bool popped{false};
+
+        CountedNodePtr oldHeadCountedNodePtr;
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &oldHeadCountedNodePtr,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      m_headAddress,
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+        GlobalAddress retiredNodeAddress = {0, Layout::DummyRank, 0};
+        for (;;)
+        {
+            GlobalAddress nodeAddress = {
+                    oldHeadCountedNodePtr.getOffset(),
+                    oldHeadCountedNodePtr.getRank(),
+                    0
+            };
+            if (isGlobalAddressDummy(nodeAddress))
+            {
+                getDataCallback(nodeAddress);
+                break;
+            }
+
+            CountedNodePtr countedNodePtrNext;
+            prefetchDataCallback(nodeAddress);
+            readNodeNext(nodeAddress, countedNodePtrNext, pPayload);
+
+            CountedNodePtr resHeadCountedNodePtr;
+            m_intraNodeHeadWin.compareAndSwap(&countedNodePtrNext,
+                                              &oldHeadCountedNodePtr,
+                                              &resHeadCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+            if (resHeadCountedNodePtr == oldHeadCountedNodePtr)
+            {
+                if (pPayload == nullptr)
+                    getDataCallback(nodeAddress);
+                retiredNodeAddress = nodeAddress;
+                popped = true;
+                break;
+            }
+            countHeadCasFailure();
+
+            if (m_options.eliminationArraySize > 0)
+            {
+                if (eliminatePop(prefetchDataCallback, getDataCallback, pPayload, backoffCallback))
+                {
+                    popped = true;
+                    break;
+                }
+            }
+            else
+            {
+                RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+                backoffCallback();
+                RMA_STACK_TRACE(m_logger, "executed backoff callback");
+            }
+            oldHeadCountedNodePtr = resHeadCountedNodePtr;
+        }
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        leaveEpoch();
+
+        if (!isGlobalAddressDummy(retiredNodeAddress))
+            retireNode(retiredNodeAddress);
+
+        return popped;
+    }
+
+    /*
+     * Операция PUSH, у которой не удался CAS головы, пытается передать свой узел
+     * с уже записанными данными операции POP через случайную ячейку массива исключения,
+     * не обращаясь к голове стека. Если ячейка свободна, то PUSH занимает её и ожидает
+     * партнёра в течение задержки backoffCallback, а затем пытается освободить ячейку.
+     * Если освободить не удалось, значит, узел забрала операция POP.
+     * Если в ячейке ожидает операция POP, то узел передаётся ей сразу.
+     * Функция вызывает backoffCallback не более одного раза.
+     */
+    template<typename Layout>
+    template<typename BackoffCallback>
+    bool InnerStack<Layout>::tryEliminatePush(GlobalAddress nodeAddress, const BackoffCallback &backoffCallback)
+    {
+        ++m_statistics.eliminationAttemptsNum;
+
+        int slotRank{-1};
+        MPI_Aint slotOffset{0};
+        chooseEliminationSlot(slotRank, slotOffset);
+
+        const auto emptySlot        = makeEliminationSlot<Layout>(EliminationSlotState::Empty, 0, 0);
+        const auto pushWaitingSlot  = makeEliminationSlot<Layout>(EliminationSlotState::PushWaiting, nodeAddress.rank, nodeAddress.offset);
+        EliminationSlot resSlot{};
+        bool waited{false};
+        bool eliminated{false};
+
+        m_windowSync.lock(slotRank, m_eliminationWin);
+        compareAndSwapEliminationSlot(pushWaitingSlot, emptySlot, resSlot, slotRank, slotOffset);
+        ++m_statistics.pushRoundTripsNum;
+        if (resSlot == emptySlot)
+        {
+            backoffCallback();
+            waited = true;
+
+            compareAndSwapEliminationSlot(emptySlot, pushWaitingSlot, resSlot, slotRank, slotOffset);
+            ++m_statistics.pushRoundTripsNum;
+            if (resSlot != pushWaitingSlot)
+            {
+                // Узел забрала операция POP, ячейку освобождает тот, кто её занял.
+                replaceEliminationSlot(emptySlot, slotRank, slotOffset);
+                ++m_statistics.pushRoundTripsNum;
+                eliminated = true;
+            }
+        }
+        else if (getEliminationSlotState(resSlot) == EliminationSlotState::PopWaiting)
+        {
+            const auto popWaitingSlot = resSlot;
+            const auto exchangedSlot  = makeEliminationSlot<Layout>(EliminationSlotState::Exchanged, nodeAddress.rank, nodeAddress.offset);
+            compareAndSwapEliminationSlot(exchangedSlot, popWaitingSlot, resSlot, slotRank, slotOffset);
+            ++m_statistics.pushRoundTripsNum;
+            eliminated = resSlot == popWaitingSlot;
+        }
+        m_windowSync.unlock(slotRank, m_eliminationWin);
+
+        if (eliminated)
+            ++m_statistics.eliminationHitsNum;
+        else if (!waited)
+            backoffCallback();
+
+        return eliminated;
+    }
+
+    /*
+     * Узел, полученный исключением, не принадлежит стеку и не виден другим операциям,
+     * поэтому после чтения данных он сразу освобождается.
+     */
+    template<typename Layout>
+    template<typename PrefetchDataCallback, typename GetDataCallback, typename BackoffCallback>
+    bool InnerStack<Layout>::eliminatePop(const PrefetchDataCallback &prefetchDataCallback,
+                                          const GetDataCallback &getDataCallback,
+                                          void *pPayload,
+                                          const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started to try elimination in 'pop'");
+        GlobalAddress eliminatedNodeAddress = {0, Layout::DummyRank, 0};
+        if (!tryEliminatePop(backoffCallback, eliminatedNodeAddress))
+            return false;
+
+        {
+            const auto r = eliminatedNodeAddress.rank;
+            const auto o = eliminatedNodeAddress.offset;
+            RMA_STACK_TRACE(m_logger, "received node (rank - {}, offset - {}) by elimination in 'pop'", r, o);
+        }
+        if (pPayload == nullptr)
+        {
+            prefetchDataCallback(eliminatedNodeAddress);
+            getDataCallback(eliminatedNodeAddress);
+        }
+
+        const auto eliminatedNodeRank = static_cast<int>(eliminatedNodeAddress.rank);
+        m_windowSync.lock(eliminatedNodeRank, m_nodesWin);
+        if (pPayload != nullptr)
+        {
+            m_intraNodeNodesWin.get(pPayload,
+                                    static_cast<int>(m_inlinePayloadSize),
+                                    MPI_BYTE,
+                                    eliminatedNodeRank,
+                                    getNodePayloadOffset(eliminatedNodeAddress),
+                                    static_cast<int>(m_inlinePayloadSize),
+                                    MPI_BYTE,
+                                    m_nodesWin
+            );
+            m_intraNodeNodesWin.flush(eliminatedNodeRank, m_nodesWin);
+        }
+        releaseNode(eliminatedNodeAddress);
+        m_windowSync.unlock(eliminatedNodeRank, m_nodesWin);
+        return true;
+    }
+
+    /*
+     * Операция POP, у которой не удался CAS головы, пытается получить узел от операции PUSH
+     * через случайную ячейку массива исключения. Протокол симметричен протоколу PUSH:
+     * в свободной ячейке POP ожидает партнёра, а ожидающий PUSH сразу отдаёт свой узел.
+     * Полученный узел не принадлежит стеку, и после чтения данных его нужно освободить.
+     */
+    template<typename Layout>
+    template<typename BackoffCallback>
+    bool InnerStack<Layout>::tryEliminatePop(const BackoffCallback &backoffCallback, GlobalAddress &rNodeAddress)
+    {
+        ++m_statistics.eliminationAttemptsNum;
+
+        int slotRank{-1};
+        MPI_Aint slotOffset{0};
+        chooseEliminationSlot(slotRank, slotOffset);
+
+        const auto emptySlot        = makeEliminationSlot<Layout>(EliminationSlotState::Empty, 0, 0);
+        const auto popWaitingSlot   = makeEliminationSlot<Layout>(EliminationSlotState::PopWaiting, m_rank, ++m_eliminationSequence);
+        EliminationSlot resSlot{};
+        bool waited{false};
+        bool eliminated{false};
+
+        m_windowSync.lock(slotRank, m_eliminationWin);
+        compareAndSwapEliminationSlot(popWaitingSlot, emptySlot, resSlot, slotRank, slotOffset);
+        if (resSlot == emptySlot)
+        {
+            backoffCallback();
+            waited = true;
+
+            compareAndSwapEliminationSlot(emptySlot, popWaitingSlot, resSlot, slotRank, slotOffset);
+            if (resSlot != popWaitingSlot)
+            {
+                // Операция PUSH передала узел, ячейку освобождает тот, кто её занял.
+                replaceEliminationSlot(emptySlot, slotRank, slotOffset);
+                eliminated = true;
+            }
+        }
+        else if (getEliminationSlotState(resSlot) == EliminationSlotState::PushWaiting)
+        {
+            const auto pushWaitingSlot  = resSlot;
+            const auto exchangedSlot    = makeEliminationSlot<Layout>(EliminationSlotState::Exchanged, resSlot.rank, resSlot.offset);
+            compareAndSwapEliminationSlot(exchangedSlot, pushWaitingSlot, resSlot, slotRank, slotOffset);
+            eliminated = resSlot == pushWaitingSlot;
+        }
+        m_windowSync.unlock(slotRank, m_eliminationWin);
+
+        if (eliminated)
+        {
+            rNodeAddress.rank = resSlot.rank;
+            rNodeAddress.offset = resSlot.offset;
+            ++m_statistics.eliminationHitsNum;
+        }
+        else if (!waited)
+        {
+            backoffCallback();
+        }
+
+        return eliminated;
+    }
+
+    /*
+     * Пакетная операция PUSH. Узлы захватываются одной пачкой и связываются в цепочку
+     * до публикации, после чего вся цепочка устанавливается в голову одной операцией CAS.
+     * Последний узел пачки становится вершиной стека, как при последовательных PUSH.
+     * Возвращает кол-во добавленных элементов, которое меньше count при нехватке узлов.
+     */
+    template<typename Layout>
+    template<typename PutDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::pushN(size_t count,
+                                     const PutDataCallback &putDataCallback,
+                                     const BackoffCallback &backoffCallback)
+    {
+        const auto pushedCount = pushNImpl(count, putDataCallback, nullptr, backoffCallback);
+        addSize(static_cast<int64_t>(pushedCount));
+        return pushedCount;
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    size_t InnerStack<Layout>::pushNInline(size_t count, const void *pValues, const BackoffCallback &backoffCallback)
+    {
+        const auto pushedCount = pushNImpl(count, [](const GlobalAddress *, size_t) {}, pValues, backoffCallback);
+        addSize(static_cast<int64_t>(pushedCount));
+        return pushedCount;
+    }
+
+    // Если pPayloads не равен nullptr, то данные записываются при связывании цепочки, см. pushImpl.
+    template<typename Layout>
+    template<typename PutDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::pushNImpl(size_t count,
+                                         const PutDataCallback &putDataCallback,
+                                         const void *pPayloads,
+                                         const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'pushN'");
+
+        if (count == 0)
+            return 0;
+
+        const int rank = getNodePoolRank();
+        m_batchNodeAddresses.resize(count);
+        GlobalAddress *pNodeAddresses = m_batchNodeAddresses.data();
+
+        auto nodesCount = acquireNodesBatch(rank, count, pNodeAddresses);
+        if (nodesCount == 0
+            && m_options.reclamationType == ReclamationType::Epochs
+            && reclaimRetiredNodes() > 0)
+        {
+            nodesCount = acquireNodesBatch(rank, count, pNodeAddresses);
+        }
+        if (nodesCount == 0)
+        {
+            RMA_STACK_TRACE(m_logger, "failed to find free nodes in 'pushN'");
+            return 0;
+        }
+        RMA_STACK_TRACE(m_logger, "acquired {} free nodes in 'pushN'", nodesCount);
+
+        if (pPayloads == nullptr)
+        {
+            putDataCallback(pNodeAddresses, nodesCount);
+            RMA_STACK_TRACE(m_logger, "put data in 'pushN'");
+        }
+        const auto pPayloadBytes = static_cast<const unsigned char *>(pPayloads);
+        const auto nodeImageSize = m_nodeImage.size();
+        m_batchNodeImages.resize(pPayloads != nullptr ? nodesCount * nodeImageSize : 0);
+
+        /*
+         * Связывание цепочки: каждый узел пачки ссылается на предыдущий.
+         * Узлы пачки ещё не опубликованы, поэтому достаточно одной синхронизации.
+         */
+        m_windowSync.lock(rank, m_nodesWin);
+        if (pPayloads != nullptr)
+        {
+            // Указатель нижнего узла записывается при публикации, поэтому сейчас записываются только его данные.
+            m_intraNodeNodesWin.put(pPayloadBytes,
+                                    static_cast<int>(m_inlinePayloadSize),
+                                    MPI_BYTE,
+                                    rank,
+                                    getNodePayloadOffset(pNodeAddresses[0]),
+                                    static_cast<int>(m_inlinePayloadSize),
+                                    MPI_BYTE,
+                                    m_nodesWin
+            );
+        }
+        m_batchCountedNodePtrs.resize(nodesCount);
+        for (size_t i = 1; i < nodesCount; ++i)
+        {
+            auto &rCountedNodePtrNext = m_batchCountedNodePtrs[i];
+            rCountedNodePtrNext = CountedNodePtr();
+            rCountedNodePtrNext.setRank(pNodeAddresses[i - 1].rank);
+            rCountedNodePtrNext.setOffset(pNodeAddresses[i - 1].offset);
+            rCountedNodePtrNext.incExternalCounter();
+
+            if (pPayloads == nullptr)
+            {
+                m_intraNodeNodesWin.put(&rCountedNodePtrNext,
+                                        1,
+                                        MPI_UINT64_T,
+                                        rank,
+                                        getNodeNextOffset(pNodeAddresses[i]),
+                                        1,
+                                        MPI_UINT64_T,
+                                        m_nodesWin
+                );
+                continue;
+            }
+
+            auto pNodeImage = m_batchNodeImages.data() + i * nodeImageSize;
+            std::memcpy(pNodeImage, &rCountedNodePtrNext, sizeof(CountedNodePtr));
+            std::memcpy(pNodeImage + sizeof(CountedNodePtr), pPayloadBytes + i * m_inlinePayloadSize, m_inlinePayloadSize);
+            m_intraNodeNodesWin.put(pNodeImage,
+                                    static_cast<int>(nodeImageSize),
+                                    MPI_BYTE,
+                                    rank,
+                                    getNodeNextOffset(pNodeAddresses[i]),
+                                    static_cast<int>(nodeImageSize),
+                                    MPI_BYTE,
+                                    m_nodesWin
+            );
+        }
+        m_intraNodeNodesWin.flush(rank, m_nodesWin);
+
+        const auto bottomNodeAddress = pNodeAddresses[0];
+        const auto topNodeAddress = pNodeAddresses[nodesCount - 1];
+
+        CountedNodePtr newCountedNodePtr;
+        newCountedNodePtr.setRank(topNodeAddress.rank);
+        newCountedNodePtr.setOffset(topNodeAddress.offset);
+        newCountedNodePtr.incExternalCounter();
+
+        CountedNodePtr resHeadCountedNodePtr;
+        CountedNodePtr oldHeadCountedNodePtr;
+        CountedNodePtr countedNodePtrNext;
+        const MPI_Aint countedNodePtrNextOffset = getNodeNextOffset(bottomNodeAddress);
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &resHeadCountedNodePtr,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      m_headAddress,
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+        // Нижний узел цепочки ссылается на текущую голову, как новый узел в операции PUSH.
+        do
+        {
+            countedNodePtrNext = resHeadCountedNodePtr;
+            m_intraNodeNodesWin.put(&countedNodePtrNext,
+                                    1,
+                                    MPI_UINT64_T,
+                                    rank,
+                                    countedNodePtrNextOffset,
+                                    1,
+                                    MPI_UINT64_T,
+                                    m_nodesWin
+            );
+            m_intraNodeNodesWin.flush(rank, m_nodesWin);
+
+            oldHeadCountedNodePtr = resHeadCountedNodePtr;
+
+            m_intraNodeHeadWin.compareAndSwap(&newCountedNodePtr,
+                                              &oldHeadCountedNodePtr,
+                                              &resHeadCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+            if (resHeadCountedNodePtr != oldHeadCountedNodePtr)
+            {
+                countHeadCasFailure();
+                RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+                backoffCallback();
+                RMA_STACK_TRACE(m_logger, "executed backoff callback");
+            }
+        }
+        while (resHeadCountedNodePtr != oldHeadCountedNodePtr);
+
+        m_windowSync.unlock(m_headRank, m_headWin);
+        m_windowSync.unlock(rank, m_nodesWin);
+
+        RMA_STACK_TRACE(m_logger, "finished 'pushN'");
+        return nodesCount;
+    }
+
+    /*
+     * Пакетная операция POP. Цепочка из не более чем maxCount верхних узлов отделяется
+     * одной операцией CAS головы. Вершина защищена внешним счётчиком ссылок, а нижележащие
+     * узлы читаются без защиты: если CAS удался, то голова не менялась с момента
+     * увеличения счётчика, и прочитанная цепочка целостна, иначе она отбрасывается.
+     * Адреса узлов передаются getDataCallback в порядке извлечения, начиная с вершины.
+     * Возвращает кол-во извлечённых элементов, 0 - стек пуст.
+     */
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::popN(size_t maxCount,
+                                    const GetDataCallback &getDataCallback,
+                                    const BackoffCallback &backoffCallback)
+    {
+        const auto poppedCount = popNImpl(maxCount, getDataCallback, nullptr, backoffCallback);
+        addSize(-static_cast<int64_t>(poppedCount));
+        return poppedCount;
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    size_t InnerStack<Layout>::popNInline(size_t maxCount, void *pValues, const BackoffCallback &backoffCallback)
+    {
+        const auto poppedCount = popNImpl(maxCount, [](const GlobalAddress *, size_t) {}, pValues, backoffCallback);
+        addSize(-static_cast<int64_t>(poppedCount));
+        return poppedCount;
+    }
+
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::stealN(int victimRank, size_t maxCount,
+                                      const GetDataCallback &getDataCallback,
+                                      const BackoffCallback &backoffCallback)
+    {
+        const auto stolenCount = stealNImpl(victimRank, maxCount, getDataCallback, nullptr, backoffCallback);
+        addSize(-static_cast<int64_t>(stolenCount));
+        return stolenCount;
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    size_t InnerStack<Layout>::stealNInline(int victimRank, size_t maxCount, void *pValues,
+                                            const BackoffCallback &backoffCallback)
+    {
+        const auto stolenCount = stealNImpl(victimRank, maxCount, [](const GlobalAddress *, size_t) {}, pValues,
+                                            backoffCallback);
+        addSize(-static_cast<int64_t>(stolenCount));
+        return stolenCount;
+    }
+
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::peekN(size_t maxCount,
+                                     const GetDataCallback &getDataCallback,
+                                     const BackoffCallback &backoffCallback)
+    {
+        return peekNImpl(maxCount, getDataCallback, nullptr, backoffCallback);
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    size_t InnerStack<Layout>::peekNInline(size_t maxCount, void *pValues, const BackoffCallback &backoffCallback)
+    {
+        return peekNImpl(maxCount, [](const GlobalAddress *, size_t) {}, pValues, backoffCallback);
+    }
+
+    /*
+     * Вершина защищается от освобождения так же, как в операции POP: ссылкой во внешнем счётчике головы
+     * или эпохой процесса, поэтому извлечённая вершина не может снова оказаться в стеке. Если после чтения
+     * цепочки и данных голова указывает на тот же узел, то вершина всё это время оставалась в стеке,
+     * а узлы под ней не изменялись; иначе чтение повторяется.
+     */
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::peekNImpl(size_t maxCount,
+                                         const GetDataCallback &getDataCallback,
+                                         void *pPayloads,
+                                         const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'peekN'");
+
+        if (maxCount == 0)
+            return 0;
+
+        const bool epochs = m_options.reclamationType == ReclamationType::Epochs;
+        // Узлы под вершиной не защищены счётчиком ссылок, поэтому в растущем пуле чтение цепочки выполняется в эпохе.
+        const bool chainEpochs = epochs || m_options.elasticNodePool;
+        m_batchNodeAddresses.resize(maxCount);
+        GlobalAddress *pNodeAddresses = m_batchNodeAddresses.data();
+        size_t peekedCount{0};
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        for (;;)
+        {
+            if (chainEpochs)
+                enterEpoch();
+
+            CountedNodePtr headCountedNodePtr;
+            m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                          &headCountedNodePtr,
+                                          MPI_UINT64_T,
+                                          m_headRank,
+                                          m_headAddress,
+                                          MPI_NO_OP,
+                                          m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+            if (!epochs)
+                increaseHeadCount(headCountedNodePtr);
+
+            if (headCountedNodePtr.isDummy())
+            {
+                if (chainEpochs)
+                    leaveEpoch();
+                break;
+            }
+
+            pNodeAddresses[0] = {headCountedNodePtr.getOffset(), headCountedNodePtr.getRank(), 0};
+            size_t chainCount{1};
+
+            CountedNodePtr countedNodePtrNext;
+            for (;;)
+            {
+                readNodeNext(pNodeAddresses[chainCount - 1], countedNodePtrNext,
+                             getPayloadSlot(pPayloads, chainCount - 1));
+                if (chainCount == maxCount || countedNodePtrNext.isDummy())
+                    break;
+
+                pNodeAddresses[chainCount] = {countedNodePtrNext.getOffset(), countedNodePtrNext.getRank(), 0};
+                ++chainCount;
+            }
+            if (pPayloads == nullptr)
+                getDataCallback(pNodeAddresses, chainCount);
+
+            CountedNodePtr resHeadCountedNodePtr;
+            m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                          &resHeadCountedNodePtr,
+                                          MPI_UINT64_T,
+                                          m_headRank,
+                                          m_headAddress,
+                                          MPI_NO_OP,
+                                          m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+            // Внешний счётчик головы могли изменить другие операции, поэтому сравниваются только адреса.
+            const bool headUnchanged = resHeadCountedNodePtr.getRank() == headCountedNodePtr.getRank()
+                                       && resHeadCountedNodePtr.getOffset() == headCountedNodePtr.getOffset();
+
+            if (!epochs)
+                releaseNodeReference(pNodeAddresses[0]);
+            if (chainEpochs)
+                leaveEpoch();
+
+            if (headUnchanged)
+            {
+                RMA_STACK_TRACE(m_logger, "read chain of {} nodes in 'peekN'", chainCount);
+                peekedCount = chainCount;
+                break;
+            }
+
+            RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+            backoffCallback();
+            RMA_STACK_TRACE(m_logger, "executed backoff callback");
+        }
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        RMA_STACK_TRACE(m_logger, "finished 'peekN'");
+        return peekedCount;
+    }
+
+    /*
+     * Операции над головой выполняются над головой процесса victimRank, после чего
+     * целью снова становится собственная голова процесса. Узлы и эпохи общие для всех голов,
+     * поэтому освобождение узлов не зависит от того, из какого стека они извлечены.
+     */
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::stealNImpl(int victimRank, size_t maxCount,
+                                          const GetDataCallback &getDataCallback,
+                                          void *pPayloads,
+                                          const BackoffCallback &backoffCallback)
+    {
+        if (!m_options.workStealing)
+            throw std::logic_error("stealing requires the work stealing mode");
+        if (victimRank < 0 || victimRank >= m_procNum)
+            throw std::invalid_argument("the victim rank is out of bounds");
+
+        RMA_STACK_TRACE(m_logger, "started to steal from {}", victimRank);
+        ++m_statistics.stealAttemptsNum;
+
+        setHeadRank(victimRank);
+        size_t stolenCount{0};
+        try
+        {
+            stolenCount = popNImpl(maxCount, getDataCallback, pPayloads, backoffCallback);
+        }
+        catch (...)
+        {
+            setHeadRank(m_rank);
+            throw;
+        }
+        setHeadRank(m_rank);
+
+        if (stolenCount > 0)
+        {
+            ++m_statistics.stealHitsNum;
+            m_statistics.stolenValuesNum += stolenCount;
+        }
+        RMA_STACK_TRACE(m_logger, "finished to steal from {} ({} of {} values)", victimRank, stolenCount, maxCount);
+        return stolenCount;
+    }
+
+    // Если pPayloads не равен nullptr, то данные узлов читаются вместе с цепочкой, см. popImpl.
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::popNImpl(size_t maxCount,
+                                        const GetDataCallback &getDataCallback,
+                                        void *pPayloads,
+                                        const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'popN'");
+
+        if (maxCount == 0)
+            return 0;
+
+        if (m_options.reclamationType == ReclamationType::Epochs)
+        {
+            const auto poppedCount = popNWithEpochs(maxCount, getDataCallback, pPayloads, backoffCallback);
+            RMA_STACK_TRACE(m_logger, "finished 'popN'");
+            return poppedCount;
+        }
+
+        m_batchNodeAddresses.resize(maxCount);
+        m_batchCountedNodePtrs.resize(maxCount);
+        GlobalAddress *pNodeAddresses = m_batchNodeAddresses.data();
+        size_t poppedCount{0};
+
+        /*
+         * Узлы под вершиной могут быть освобождены во время чтения цепочки, а в растущем пуле - и их сегмент.
+         * Эпоха откладывает отсоединение сегмента до завершения чтения, см. tryShrinkNodePool.
+         */
+        if (m_options.elasticNodePool)
+            enterEpoch();
+
+        CountedNodePtr oldHeadCountedNodePtr;
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &oldHeadCountedNodePtr,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      m_headAddress,
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+        for (;;)
+        {
+            increaseHeadCount(oldHeadCountedNodePtr);
+            if (oldHeadCountedNodePtr.isDummy())
+                break;
+
+            m_batchCountedNodePtrs[0] = oldHeadCountedNodePtr;
+            pNodeAddresses[0] = {oldHeadCountedNodePtr.getOffset(), oldHeadCountedNodePtr.getRank(), 0};
+            size_t chainCount{1};
+
+            // Чтение цепочки узлов от вершины до maxCount узлов или до конца стека.
+            CountedNodePtr countedNodePtrNext;
+            for (;;)
+            {
+                readNodeNext(pNodeAddresses[chainCount - 1], countedNodePtrNext,
+                             getPayloadSlot(pPayloads, chainCount - 1));
+                if (chainCount == maxCount || countedNodePtrNext.isDummy())
+                    break;
+
+                m_batchCountedNodePtrs[chainCount] = countedNodePtrNext;
+                pNodeAddresses[chainCount] = {countedNodePtrNext.getOffset(), countedNodePtrNext.getRank(), 0};
+                ++chainCount;
+            }
+
+            CountedNodePtr resHeadCountedNodePtr;
+            m_intraNodeHeadWin.compareAndSwap(&countedNodePtrNext,
+                                              &oldHeadCountedNodePtr,
+                                              &resHeadCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+            if (resHeadCountedNodePtr == oldHeadCountedNodePtr)
+            {
+                RMA_STACK_TRACE(m_logger, "detached chain of {} nodes in 'popN'", chainCount);
+                if (pPayloads == nullptr)
+                    getDataCallback(pNodeAddresses, chainCount);
+                releaseDetachedNodes(chainCount);
+                poppedCount = chainCount;
+                break;
+            }
+
+            countHeadCasFailure();
+            // Отказ от ссылки на вершину, как при неудачной операции POP.
+            const auto headNodeAddress = pNodeAddresses[0];
+            const auto headNodeRank = static_cast<int>(headNodeAddress.rank);
+            const int32_t countIncrease{-1};
+            int32_t resInternalCount{0};
+
+            m_windowSync.lock(headNodeRank, m_nodesWin);
+            m_intraNodeNodesWin.fetchAndOp(&countIncrease,
+                                           &resInternalCount,
+                                           MPI_INT32_T,
+                                           headNodeRank,
+                                           getNodeInternalCounterOffset(headNodeAddress),
+                                           MPI_SUM,
+                                           m_nodesWin
+            );
+            m_intraNodeNodesWin.flush(headNodeRank, m_nodesWin);
+            if (resInternalCount == 1)
+                releaseNode(headNodeAddress);
+            m_windowSync.unlock(headNodeRank, m_nodesWin);
+
+            RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+            backoffCallback();
+            RMA_STACK_TRACE(m_logger, "executed backoff callback");
+        }
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        if (m_options.elasticNodePool)
+            leaveEpoch();
+
+        RMA_STACK_TRACE(m_logger, "finished 'popN'");
+        return poppedCount;
+    }
+
+    // Пакетная операция POP при освобождении узлов по эпохам, см. popN и popWithEpochs.
+    template<typename Layout>
+    template<typename GetDataCallback, typename BackoffCallback>
+    size_t InnerStack<Layout>::popNWithEpochs(size_t maxCount,
+                                              const GetDataCallback &getDataCallback,
+                                              void *pPayloads,
+                                              const BackoffCallback &backoffCallback)
+    {
+        m_batchNodeAddresses.resize(maxCount);
+        GlobalAddress *pNodeAddresses = m_batchNodeAddresses.data();
+        size_t poppedCount{0};
+
+        enterEpoch();
+
+        CountedNodePtr oldHeadCountedNodePtr;
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &oldHeadCountedNodePtr,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      m_headAddress,
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+        while (!oldHeadCountedNodePtr.isDummy())
+        {
+            pNodeAddresses[0] = {oldHeadCountedNodePtr.getOffset(), oldHeadCountedNodePtr.getRank(), 0};
+            size_t chainCount{1};
+
+            CountedNodePtr countedNodePtrNext;
+            for (;;)
+            {
+                readNodeNext(pNodeAddresses[chainCount - 1], countedNodePtrNext,
+                             getPayloadSlot(pPayloads, chainCount - 1));
+                if (chainCount == maxCount || countedNodePtrNext.isDummy())
+                    break;
+
+                pNodeAddresses[chainCount] = {countedNodePtrNext.getOffset(), countedNodePtrNext.getRank(), 0};
+                ++chainCount;
+            }
+
+            CountedNodePtr resHeadCountedNodePtr;
+            m_intraNodeHeadWin.compareAndSwap(&countedNodePtrNext,
+                                              &oldHeadCountedNodePtr,
+                                              &resHeadCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+
+            if (resHeadCountedNodePtr == oldHeadCountedNodePtr)
+            {
+                RMA_STACK_TRACE(m_logger, "detached chain of {} nodes in 'popN'", chainCount);
+                if (pPayloads == nullptr)
+                    getDataCallback(pNodeAddresses, chainCount);
+                poppedCount = chainCount;
+                break;
+            }
+
+            countHeadCasFailure();
+            RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+            backoffCallback();
+            RMA_STACK_TRACE(m_logger, "executed backoff callback");
+            oldHeadCountedNodePtr = resHeadCountedNodePtr;
+        }
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        leaveEpoch();
+
+        for (size_t i = 0; i < poppedCount; ++i)
+            retireNode(pNodeAddresses[i]);
+
+        return poppedCount;
+    }
+
+    template<typename Layout>
+    template<typename BackoffCallback>
+    size_t InnerStack<Layout>::getSize(const BackoffCallback &backoffCallback)
+    {
+        if (hasSizeCounter())
+            return readSizeCounters();
+        if (!m_options.workStealing)
+            return countNodes(backoffCallback);
+
+        size_t size{0};
+        try
+        {
+            for (int headRank = 0; headRank < m_procNum; ++headRank)
+            {
+                setHeadRank(headRank);
+                size += countNodes(backoffCallback);
+            }
+        }
+        catch (...)
+        {
+            setHeadRank(m_rank);
+            throw;
+        }
+        setHeadRank(m_rank);
+        return size;
+    }
+
+    /*
+     * Подсчёт узлов стека обходом списка. Вершина защищена так же, как в peekN, поэтому если после обхода
+     * голова указывает на тот же узел, то список не изменялся во время обхода. Если вершину извлекли,
+     * то узлы под ней могут быть снова добавлены в стек и образовать цикл при чтении, поэтому голова
+     * проверяется и во время обхода, каждый раз, когда кол-во пройденных узлов удваивается.
+     */
+    template<typename Layout>
+    template<typename BackoffCallback>
+    size_t InnerStack<Layout>::countNodes(const BackoffCallback &backoffCallback)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'countNodes'");
+
+        const bool epochs = m_options.reclamationType == ReclamationType::Epochs;
+        const bool chainEpochs = epochs || m_options.elasticNodePool;
+        size_t nodesCount{0};
+
+        const auto isHeadUnchanged = [this](const CountedNodePtr &headCountedNodePtr) {
+            CountedNodePtr resHeadCountedNodePtr;
+            m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                          &resHeadCountedNodePtr,
+                                          MPI_UINT64_T,
+                                          m_headRank,
+                                          m_headAddress,
+                                          MPI_NO_OP,
+                                          m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+            return resHeadCountedNodePtr.getRank() == headCountedNodePtr.getRank()
+                   && resHeadCountedNodePtr.getOffset() == headCountedNodePtr.getOffset();
+        };
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        for (;;)
+        {
+            if (chainEpochs)
+                enterEpoch();
+
+            CountedNodePtr headCountedNodePtr;
+            m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                          &headCountedNodePtr,
+                                          MPI_UINT64_T,
+                                          m_headRank,
+                                          m_headAddress,
+                                          MPI_NO_OP,
+                                          m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+            if (!epochs)
+                increaseHeadCount(headCountedNodePtr);
+
+            if (headCountedNodePtr.isDummy())
+            {
+                if (chainEpochs)
+                    leaveEpoch();
+                break;
+            }
+
+            const GlobalAddress headNodeAddress{headCountedNodePtr.getOffset(), headCountedNodePtr.getRank(), 0};
+            GlobalAddress nodeAddress = headNodeAddress;
+            size_t chainCount{1};
+            size_t nextCheckCount{2};
+            bool headUnchanged{true};
+
+            CountedNodePtr countedNodePtrNext;
+            for (;;)
+            {
+                readNodeNext(nodeAddress, countedNodePtrNext, nullptr);
+                if (countedNodePtrNext.isDummy())
+                    break;
+
+                nodeAddress = {countedNodePtrNext.getOffset(), countedNodePtrNext.getRank(), 0};
+                if (++chainCount == nextCheckCount)
+                {
+                    nextCheckCount *= 2;
+                    headUnchanged = isHeadUnchanged(headCountedNodePtr);
+                    if (!headUnchanged)
+                        break;
+                }
+            }
+            if (headUnchanged)
+                headUnchanged = isHeadUnchanged(headCountedNodePtr);
+
+            if (!epochs)
+                releaseNodeReference(headNodeAddress);
+            if (chainEpochs)
+                leaveEpoch();
+
+            if (headUnchanged)
+            {
+                nodesCount = chainCount;
+                break;
+            }
+
+            RMA_STACK_TRACE(m_logger, "started to execute backoff callback");
+            backoffCallback();
+            RMA_STACK_TRACE(m_logger, "executed backoff callback");
+        }
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        RMA_STACK_TRACE(m_logger, "finished 'countNodes' ({} nodes)", nodesCount);
+        return nodesCount;
+    }
+
     } // ref_counting
 
 #endif //SOURCES_INNERSTACK_H
@@ -0,0 +1,136 @@
+#ifndef SOURCES_INNERSTACKOPTIONS_H
+#define SOURCES_INNERSTACKOPTIONS_H
+
+#include <cstddef>
+#include <limits>
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Способ поиска свободных узлов в массиве узлов процесса.
+     * FreeList - список свободных узлов с тегированной головой, O(1) атомарных операций на захват.
+     * Bitmap - упакованная битовая карта занятости, одна атомарная операция проверяет 64 узла.
+     */
+    enum class NodeAllocatorType
+    {
+        FreeList,
+        Bitmap
+    };
+
+    /*
+     * Способ безопасного освобождения извлечённых узлов.
+     * ReferenceCounting - разделённый подсчёт ссылок: внешний счётчик в голове и внутренний в узле.
+     * Epochs - распределённые эпохи: процесс объявляет вход в операцию записью в свою ячейку,
+     * а извлечённый узел освобождается, когда каждый процесс завершил операцию,
+     * которая могла его видеть. POP сводится к чтению головы, чтению следующего узла и CAS.
+     */
+    enum class ReclamationType
+    {
+        ReferenceCounting,
+        Epochs
+    };
+
+    // Наибольший размер данных пользователя, которые могут храниться внутри узла.
+    constexpr size_t MaxInlinePayloadSize = 64;
+
+    // Кол-во общих счётчиков размера, при котором общий счётчик расположен на каждом процессе.
+    constexpr size_t PerRankSizeCounterShards = std::numeric_limits<size_t>::max();
+
+    // Необязательные параметры внутреннего стека, одинаковые на всех процессах.
+    struct InnerStackOptions
+    {
+        NodeAllocatorType nodeAllocatorType{NodeAllocatorType::FreeList};
+        // Ёмкость локального кэша узлов процесса, 0 - кэш не используется.
+        size_t nodeMagazineSize{0};
+        /*
+         * Общее кол-во ячеек массива исключения, через которые встречные операции PUSH и POP
+         * обмениваются узлом после неудачного CAS головы, 0 - исключение не используется.
+         */
+        size_t eliminationArraySize{0};
+        ReclamationType reclamationType{ReclamationType::ReferenceCounting};
+        // Кол-во извлечённых узлов, накапливаемых перед проверкой эпох всех процессов.
+        size_t retiredNodesBatchSize{64};
+        /*
+         * Хранить данные пользователя внутри узла сразу за указателем на следующий узел.
+         * PUSH записывает указатель и данные одной операцией MPI_Put, POP читает их одной
+         * операцией MPI_Get, а окно данных пользователя не создаётся. Только в этом режиме запись
+         * данных PUSH не требует отдельного ожидания MPI_Win_flush, см. InnerStack::pushImpl.
+         * Допустимо для тривиально копируемых типов размером не более MaxInlinePayloadSize байт.
+         */
+        bool inlinePayload{false};
+        /*
+         * Открывать одну эпоху доступа MPI_Win_lock_all на каждое окно при создании стека
+         * и закрывать её в release. Операции стека тогда завершаются только вызовами MPI_Win_flush
+         * без MPI_Win_lock/MPI_Win_unlock на каждом обращении к удалённому процессу.
+         */
+        bool persistentLockAll{true};
+        /*
+         * Создавать окна стека вызовом MPI_Win_allocate вместо динамических окон с MPI_Win_attach.
+         * Смещения тогда отсчитываются от начала памяти окна, таблицы базовых адресов процессов
+         * и их рассылка при создании стека не нужны.
+         */
+        bool staticWindows{false};
+        /*
+         * Выделять окна головы, узлов, эпох и данных пользователя в разделяемой памяти узла
+         * (MPI_Win_allocate_shared) и обращаться к ним атомарными операциями процессора вместо MPI RMA.
+         * Включает staticWindows. Используется, только если все процессы находятся на одном узле,
+         * иначе стек работает через MPI RMA.
+         */
+        bool intraNodeSharedMemory{false};
+        /*
+         * Хранить голову собственного стека на каждом процессе (только для децентрализованного стека).
+         * Процесс добавляет и извлекает значения из своего стека, а к стекам других процессов
+         * обращается, только если его стек пуст: забирает значения у случайно выбранного процесса.
+         */
+        bool workStealing{false};
+        /*
+         * Кол-во значений, которые забираются у выбранного процесса одной операцией;
+         * значения сверх запрошенных добавляются в собственный стек процесса, поэтому их забирается
+         * не больше, чем в пуле процесса свободных узлов.
+         */
+        size_t stealBatchSize{1};
+        /*
+         * Расширять пул узлов процесса по требованию: при нехватке узлов выделяется новый сегмент
+         * и присоединяется к динамическому окну узлов, а сегмент, все узлы которого свободны,
+         * освобождается, если в остальных сегментах достаточно свободных узлов. Освобождённый сегмент
+         * отсоединяется от окна после смены эпох процессов, читавших цепочки узлов (см. ReclamationType::Epochs).
+         * elemsUpLimit задаёт размер исходного сегмента. Данные пользователя растут вместе с узлами,
+         * поэтому требуется inlinePayload; также требуются децентрализованный стек, динамические окна,
+         * NodeAllocatorType::FreeList и persistentLockAll.
+         */
+        bool elasticNodePool{false};
+        // Кол-во узлов в каждом дополнительном сегменте, 0 - elemsUpLimit.
+        size_t nodeSegmentSize{0};
+        /*
+         * Кол-во операций процесса между чтениями общих счётчиков конкуренции за голову,
+         * 0 - оценка конкуренции не используется. Счётчики операций и неудачных CAS головы
+         * расположены в окне головы сразу за ней. Неудачный CAS увеличивает счётчик операцией
+         * MPI_Accumulate, которая завершается вместе со следующим MPI_Win_flush окна головы,
+         * а кол-во операций процесса добавляется при чтении счётчиков.
+         */
+        size_t contentionSamplingPeriod{0};
+        /*
+         * Операция POP внешнего стека начинает чтение данных пользователя узла-кандидата запросом
+         * MPI_Rget до чтения указателя на следующий узел и CAS головы; прочитанное значение используется,
+         * если CAS удался, и отбрасывается иначе. Не действует при inlinePayload, когда данные и так
+         * читаются вместе с указателем на следующий узел.
+         */
+        bool prefetchPopPayload{false};
+        /*
+         * Приближённый счётчик размера стека. Каждый процесс накапливает изменение размера от своих операций
+         * и раз в sizeCounterPublishPeriod операций добавляет его операцией MPI_Accumulate к одному из
+         * sizeCounterShardsNum общих счётчиков (счётчику процесса rank % sizeCounterShardsNum). Отправленное
+         * изменение завершается MPI_Win_flush перед отправкой следующего, поэтому в размере не учтено не более
+         * 2 * sizeCounterPublishPeriod операций каждого из остальных процессов, которые продолжают выполнять
+         * операции. Кол-во общих счётчиков ограничено кол-вом процессов. PerRankSizeCounterShards - общий
+         * счётчик на каждом процессе, изменение размера добавляется к счётчику своего процесса: это
+         * рекомендуемый режим. 0 - счётчик размера не используется, а размер считается обходом списка.
+         */
+        size_t sizeCounterShardsNum{0};
+        size_t sizeCounterPublishPeriod{64};
+        // Точный размер: изменение добавляется к общему счётчику после каждой операции и дожидается завершения.
+        bool exactSize{false};
+    };
+}
+
+#endif //SOURCES_INNERSTACKOPTIONS_H
@@ -0,0 +1,144 @@
+#ifndef SOURCES_INNERSTACKREQUEST_H
+#define SOURCES_INNERSTACKREQUEST_H
+
+#include <mpi.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "CountedNodePtr.h"
+#include "InnerStackOptions.h"
+
+namespace rma_stack::ref_counting
+{
+    template<typename Layout>
+    class InnerStack;
+
+    enum class InnerStackRequestType
+    {
+        Push,
+        Pop
+    };
+
+    /*
+     * Состояния неблокирующей операции. В каждом состоянии, кроме Inactive, WaitingEpoch, WaitingHead,
+     * SwappingHead и Complete, операция ожидает завершения одной RMA-операции с запросом (MPI_Rget,
+     * MPI_Rget_accumulate). WaitingHead - операция ожидает, пока другая операция процесса завершит CAS головы,
+     * ReadingHead - чтение головы, IncreasingHeadCount - увеличение внешнего счётчика ссылок головы POP,
+     * WritingNode - запись указателя на следующий узел и данных в узел PUSH, ReadingNode - чтение
+     * указателя на следующий узел и данных узла POP, SwappingHead - повтор CAS головы POP, которая
+     * по-прежнему указывает на узел операции, UpdatingCounter - изменение внутреннего счётчика ссылок узла,
+     * ReadingFreeList, WritingFreeNode и ReleasingNode - возврат узла в список свободных узлов или
+     * в битовую карту, WaitingEpoch - POP ожидает открытия новой эпохи.
+     */
+    enum class InnerStackRequestState
+    {
+        Inactive,
+        WaitingEpoch,
+        WaitingHead,
+        ReadingHead,
+        IncreasingHeadCount,
+        WritingNode,
+        ReadingNode,
+        SwappingHead,
+        UpdatingCounter,
+        ReadingFreeList,
+        WritingFreeNode,
+        ReleasingNode,
+        Complete
+    };
+
+    /*
+     * Дескриптор неблокирующей операции PUSH или POP внутреннего стека (InnerStack::pushInlineAsync,
+     * InnerStack::popInlineAsync). Операция продвигается вызовами test и wait, поэтому процесс может
+     * одновременно выполнять несколько операций. Буферы дескриптора используются как буферы
+     * RMA-операций, а стек хранит указатели на дескрипторы в очереди операций над головой,
+     * поэтому дескриптор нельзя копировать и перемещать.
+     */
+    template<typename Layout = DefaultLayout>
+    class InnerStackRequest
+    {
+        friend class InnerStack<Layout>;
+    public:
+        InnerStackRequest() = default;
+        InnerStackRequest(const InnerStackRequest&) = delete;
+        InnerStackRequest(InnerStackRequest&&) = delete;
+        InnerStackRequest& operator=(const InnerStackRequest&) = delete;
+        InnerStackRequest& operator=(InnerStackRequest&&) = delete;
+        ~InnerStackRequest() = default;
+
+        // Продвижение операции, возвращает true, если операция завершена.
+        bool test();
+        void wait();
+
+        [[nodiscard]] bool isActive() const;
+        /*
+         * Результат завершённой операции: для PUSH - false при нехватке узлов,
+         * для POP - false, если стек был пуст.
+         */
+        [[nodiscard]] bool getResult() const;
+
+    private:
+        InnerStack<Layout> *m_pStack{nullptr};
+        InnerStackRequestType m_type{InnerStackRequestType::Push};
+        InnerStackRequestState m_state{InnerStackRequestState::Inactive};
+        MPI_Request m_mpiRequest{MPI_REQUEST_NULL};
+        bool m_result{false};
+        bool m_headReplaced{false};
+        uint64_t m_seenHeadRequestTestsNum{0};
+
+        GlobalAddress<Layout> m_nodeAddress{0, Layout::DummyRank, 0};
+        CountedNodePtr<Layout> m_oldHeadCountedNodePtr;
+        CountedNodePtr<Layout> m_newCountedNodePtr;
+        CountedNodePtr<Layout> m_resHeadCountedNodePtr;
+        CountedNodePtr<Layout> m_headCountIncrease;
+        int32_t m_countIncrease{0};
+        int32_t m_resInternalCount{0};
+
+        // Буферы возврата узла в пул.
+        FreeListHead m_freeListHead{FreeListEndIndex, 0};
+        FreeListHead m_resFreeListHead{FreeListEndIndex, 0};
+        uint32_t m_nextFreeIndex{FreeListEndIndex};
+        uint32_t m_resNextFreeIndex{0};
+        uint64_t m_nodeBitmapMask{0};
+        uint64_t m_resNodeBitmapWord{0};
+        int64_t m_usedCountIncrease{0};
+        int64_t m_resUsedCount{0};
+
+        void *m_pValue{nullptr};
+        // Указатель на следующий узел и данные пользователя, дополненные до границы 8 байт.
+        alignas(uint64_t) std::array<unsigned char, sizeof(uint64_t) + MaxInlinePayloadSize> m_nodeImage{};
+        alignas(uint64_t) std::array<unsigned char, sizeof(uint64_t) + MaxInlinePayloadSize> m_resNodeImage{};
+        std::array<unsigned char, MaxInlinePayloadSize> m_defaultPayload{};
+    };
+
+    template<typename Layout>
+    bool InnerStackRequest<Layout>::test()
+    {
+        // Неначатая операция считается завершённой, как MPI_REQUEST_NULL.
+        if (m_pStack == nullptr)
+            return true;
+        return m_pStack->testRequest(*this);
+    }
+
+    template<typename Layout>
+    void InnerStackRequest<Layout>::wait()
+    {
+        while (!test())
+            ;
+    }
+
+    template<typename Layout>
+    bool InnerStackRequest<Layout>::isActive() const
+    {
+        return m_state != InnerStackRequestState::Inactive && m_state != InnerStackRequestState::Complete;
+    }
+
+    template<typename Layout>
+    bool InnerStackRequest<Layout>::getResult() const
+    {
+        return m_result;
+    }
+}
+
+#endif //SOURCES_INNERSTACKREQUEST_H
@@ -0,0 +1,33 @@
+#ifndef SOURCES_INNERSTACKSTATISTICS_H
+#define SOURCES_INNERSTACKSTATISTICS_H
+
+#include <cstdint>
+
+namespace rma_stack::ref_counting
+{
+    // Счётчики событий внутреннего стека на текущем процессе.
+    struct InnerStackStatistics
+    {
+        // Попытки обмена через массив исключения и успешные обмены.
+        uint64_t eliminationAttemptsNum{0};
+        uint64_t eliminationHitsNum{0};
+        // Попытки забрать значения из стека другого процесса, успешные попытки и забранные значения.
+        uint64_t stealAttemptsNum{0};
+        uint64_t stealHitsNum{0};
+        uint64_t stolenValuesNum{0};
+        // Выделенные и освобождённые сегменты растущего пула узлов.
+        uint64_t nodeSegmentGrowthsNum{0};
+        uint64_t nodeSegmentShrinksNum{0};
+        // Неудачные CAS головы.
+        uint64_t headCasFailuresNum{0};
+        /*
+         * Операции PUSH и их последовательные обращения к удалённой памяти (ожидания MPI_Win_flush),
+         * не считая захвата узла. Без inlinePayload завершение записи данных пользователя
+         * в окне данных считается отдельным обращением.
+         */
+        uint64_t pushesNum{0};
+        uint64_t pushRoundTripsNum{0};
+    };
+}
+
+#endif //SOURCES_INNERSTACKSTATISTICS_H
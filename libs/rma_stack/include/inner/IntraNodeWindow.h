@@ -0,0 +1,62 @@
+#ifndef SOURCES_INTRANODEWINDOW_H
+#define SOURCES_INTRANODEWINDOW_H
+
+#include <mpi.h>
+#include <vector>
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Доступ к окну, память которого выделена вызовом MPI_Win_allocate_shared.
+     * Если память целевого процесса отображена в адресное пространство текущего процесса,
+     * операция выполняется над ней напрямую (атомарные операции - через std::atomic),
+     * иначе - соответствующей операцией MPI RMA. Сигнатуры методов повторяют функции MPI.
+     *
+     * Стандарт MPI не гарантирует атомарность операций MPI RMA по отношению к атомарным
+     * операциям процессора, поэтому память окна отображается, только если все процессы
+     * окна находятся на одном вычислительном узле и обращаются к ней одинаково.
+     */
+    class IntraNodeWindow
+    {
+    public:
+        // Проверка того, что все процессы коммуникатора разделяют память одного узла.
+        static bool isSingleNode(MPI_Comm comm);
+
+        // Создаёт окно в разделяемой памяти узла и отображает память всех процессов окна.
+        void allocate(MPI_Aint size, MPI_Info info, MPI_Comm comm, void *pBaseAddress, MPI_Win *pWin);
+        // Запрашивает адреса памяти всех процессов окна, созданного MPI_Win_allocate_shared.
+        void map(MPI_Win win);
+        void unmap();
+        [[nodiscard]] bool isMapped(int rank) const;
+
+        void fetchAndOp(const void *pOriginAddr, void *pResultAddr, MPI_Datatype datatype,
+                        int targetRank, MPI_Aint targetDisp, MPI_Op op, MPI_Win win) const;
+        void compareAndSwap(const void *pOriginAddr, const void *pCompareAddr, void *pResultAddr,
+                            MPI_Datatype datatype, int targetRank, MPI_Aint targetDisp, MPI_Win win) const;
+        void accumulate(const void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                        int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                        MPI_Op op, MPI_Win win) const;
+        // Типы данных операций put и get должны описывать непрерывную память.
+        void put(const void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                 int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                 MPI_Win win) const;
+        void get(void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                 int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                 MPI_Win win) const;
+        /*
+         * Чтение, которое завершается MPI_Wait по запросу *pRequest. Из отображённой памяти
+         * данные копируются сразу, а *pRequest получает значение MPI_REQUEST_NULL.
+         */
+        void rget(void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                  int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                  MPI_Win win, MPI_Request *pRequest) const;
+        void flush(int rank, MPI_Win win) const;
+        void flushAll(MPI_Win win) const;
+
+        [[nodiscard]] unsigned char *getAddress(int rank, MPI_Aint displacement) const;
+    private:
+        std::vector<unsigned char*> m_baseAddresses;
+    };
+}
+
+#endif //SOURCES_INTRANODEWINDOW_H
@@ -25,23 +25,64 @@ namespace rma_stack::ref_counting
      * а обыкновенной записью в ячейку памяти с приведением типа.
      * Чаще всего модифицируются эти поля операциями односторонней
      * коммуникации.
+     *
+     * Пока узел свободен, он находится в списке свободных узлов процесса,
+     * которому принадлежит массив узлов, а поле m_nextFreeIndex хранит
+     * индекс следующего свободного узла этого списка.
      */
+    template<typename Layout = DefaultLayout>
     class Node
     {
     public:
         Node();
-        [[nodiscard]] const CountedNodePtr &getCountedNodePtr() const;
-        void setCountedNodePtrNext(const CountedNodePtr &t_countedNodePtr);
+        [[nodiscard]] const CountedNodePtr<Layout> &getCountedNodePtr() const;
+        void setCountedNodePtrNext(const CountedNodePtr<Layout> &t_countedNodePtr);
+        [[nodiscard]] uint32_t getNextFreeIndex() const;
+        void setNextFreeIndex(uint32_t t_nextFreeIndex);
 
     private:
         // Первые 8 байт.
-        uint32_t m_acquired : 1; // 0 - узел свободен, 1 - узел занят.
-        uint32_t m_reserved : 32 - 1; // Выравнивание данных.
+        uint32_t m_nextFreeIndex; // Индекс следующего свободного узла в списке свободных узлов.
         int32_t m_internalCounter; // Внутренний счётчик ссылок
 
         // Вторые 8 байт.
-        CountedNodePtr m_countedNodePtrNext;
+        CountedNodePtr<Layout> m_countedNodePtrNext;
     };
+
+    template<typename Layout>
+    Node<Layout>::Node()
+    :
+    m_nextFreeIndex(FreeListEndIndex),
+    m_internalCounter(0),
+    m_countedNodePtrNext()
+    {
+        // Смещения полей узла используются в RMA-операциях.
+        static_assert(sizeof(Node) == 16, "the node must keep the 16-byte layout");
+    }
+
+    template<typename Layout>
+    const CountedNodePtr<Layout> &Node<Layout>::getCountedNodePtr() const
+    {
+        return m_countedNodePtrNext;
+    }
+
+    template<typename Layout>
+    void Node<Layout>::setCountedNodePtrNext(const CountedNodePtr<Layout> &t_countedNodePtr)
+    {
+        m_countedNodePtrNext = t_countedNodePtr;
+    }
+
+    template<typename Layout>
+    uint32_t Node<Layout>::getNextFreeIndex() const
+    {
+        return m_nextFreeIndex;
+    }
+
+    template<typename Layout>
+    void Node<Layout>::setNextFreeIndex(uint32_t t_nextFreeIndex)
+    {
+        m_nextFreeIndex = t_nextFreeIndex;
+    }
 } // rma_stack
 
 #endif //SOURCES_NODE_H
@@ -0,0 +1,37 @@
+#ifndef SOURCES_NODEBITMAP_H
+#define SOURCES_NODEBITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Битовая карта занятости узлов: i-й бит слова w отвечает за узел с индексом
+     * w * NodeBitmapWordBits + i, 0 - узел свободен, 1 - узел занят. Биты за пределами
+     * массива узлов всегда установлены в 1, чтобы их нельзя было захватить.
+     */
+    constexpr size_t NodeBitmapWordBits     = 64;
+    constexpr uint64_t NodeBitmapFullWord   = UINT64_MAX;
+
+    size_t getNodeBitmapWordsNum(size_t elemsUpLimit);
+    void initNodeBitmap(uint64_t *pWords, size_t elemsUpLimit);
+
+    /*
+     * Поиск первого слова в диапазоне [beginWord, endWord), в котором есть свободный узел.
+     * Если процессор поддерживает AVX2, то слова проверяются по 4 за одну векторную операцию сравнения.
+     * Возвращает endWord, если все слова диапазона заполнены.
+     */
+    size_t findFirstNotFullWord(const uint64_t *pWords, size_t beginWord, size_t endWord);
+    /*
+     * Реализации поиска без векторных операций и с AVX2, между которыми выбирает findFirstNotFullWord.
+     * Вызов findFirstNotFullWordAvx2 допустим, только если isNodeBitmapAvx2Supported возвращает true.
+     */
+    size_t findFirstNotFullWordScalar(const uint64_t *pWords, size_t beginWord, size_t endWord);
+    size_t findFirstNotFullWordAvx2(const uint64_t *pWords, size_t beginWord, size_t endWord);
+    [[nodiscard]] bool isNodeBitmapAvx2Supported();
+    // Номер младшего нулевого бита, слово не должно быть заполненным.
+    unsigned findFirstZeroBit(uint64_t word);
+}
+
+#endif //SOURCES_NODEBITMAP_H
@@ -0,0 +1,86 @@
+#ifndef SOURCES_NODEMAGAZINE_H
+#define SOURCES_NODEMAGAZINE_H
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "ref_counting.h"
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Локальный для процесса кэш зарезервированных узлов. Узлы, освобождённые текущим
+     * процессом, сначала попадают в кэш, а операция PUSH сначала берёт узел из кэша,
+     * поэтому при сбалансированной нагрузке большинство операций обходится без
+     * удалённого захвата и освобождения узлов. Кэш пополняется и опустошается пачками.
+     */
+    template<typename Layout = DefaultLayout>
+    class NodeMagazine
+    {
+    public:
+        explicit NodeMagazine(size_t t_capacity = 0);
+
+        [[nodiscard]] size_t getCapacity() const;
+        [[nodiscard]] size_t getSize() const;
+        [[nodiscard]] bool isEmpty() const;
+        [[nodiscard]] bool isFull() const;
+
+        void push(GlobalAddress<Layout> nodeAddress);
+        GlobalAddress<Layout> pop();
+
+    private:
+        size_t m_capacity;
+        std::vector<GlobalAddress<Layout>> m_nodeAddresses;
+    };
+
+    template<typename Layout>
+    NodeMagazine<Layout>::NodeMagazine(size_t t_capacity)
+    :
+    m_capacity(t_capacity)
+    {
+        m_nodeAddresses.reserve(m_capacity);
+    }
+
+    template<typename Layout>
+    size_t NodeMagazine<Layout>::getCapacity() const
+    {
+        return m_capacity;
+    }
+
+    template<typename Layout>
+    size_t NodeMagazine<Layout>::getSize() const
+    {
+        return m_nodeAddresses.size();
+    }
+
+    template<typename Layout>
+    bool NodeMagazine<Layout>::isEmpty() const
+    {
+        return m_nodeAddresses.empty();
+    }
+
+    template<typename Layout>
+    bool NodeMagazine<Layout>::isFull() const
+    {
+        return m_nodeAddresses.size() >= m_capacity;
+    }
+
+    template<typename Layout>
+    void NodeMagazine<Layout>::push(GlobalAddress<Layout> nodeAddress)
+    {
+        assert(!isFull());
+        m_nodeAddresses.push_back(nodeAddress);
+    }
+
+    template<typename Layout>
+    GlobalAddress<Layout> NodeMagazine<Layout>::pop()
+    {
+        assert(!isEmpty());
+        const auto nodeAddress = m_nodeAddresses.back();
+        m_nodeAddresses.pop_back();
+        return nodeAddress;
+    }
+}
+
+#endif //SOURCES_NODEMAGAZINE_H
@@ -0,0 +1,63 @@
+#ifndef SOURCES_NODESEGMENT_H
+#define SOURCES_NODESEGMENT_H
+
+#include <mpi.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Раскладка смещения узла в растущем пуле узлов (InnerStackOptions::elasticNodePool):
+     * старшие биты - номер сегмента процесса, за ними - поколение сегмента, младшие - индекс узла в сегменте.
+     * Нулевой сегмент - исходный массив узлов поколения 0, поэтому смещение его узлов совпадает с индексом.
+     * Поколение увеличивается при каждом повторном выделении сегмента, поэтому адреса узлов
+     * освобождённого сегмента не совпадают с адресами узлов сегмента, выделенного на его месте.
+     */
+    template<typename Layout>
+    struct NodeSegmentLayout
+    {
+        static constexpr uint64_t SlotBitsLimit       = 4;
+        static constexpr uint64_t GenerationBitsLimit = 6;
+        static constexpr uint64_t IndexBitsLimit      = Layout::OffsetBitsLimit - SlotBitsLimit - GenerationBitsLimit;
+        static constexpr size_t   SlotsNum            = size_t{1} << SlotBitsLimit;
+        static constexpr uint64_t GenerationsNum      = uint64_t{1} << GenerationBitsLimit;
+        static constexpr uint64_t MaxSegmentNodesNum  = uint64_t{1} << IndexBitsLimit;
+
+        static_assert(IndexBitsLimit >= 16, "too few bits are left for the node index in a segment");
+
+        static uint64_t makeOffset(size_t slot, uint64_t generation, uint64_t index)
+        {
+            return (static_cast<uint64_t>(slot) << (GenerationBitsLimit + IndexBitsLimit))
+                   | (generation << IndexBitsLimit)
+                   | index;
+        }
+
+        static size_t getSlot(uint64_t offset)
+        {
+            return static_cast<size_t>(offset >> (GenerationBitsLimit + IndexBitsLimit));
+        }
+
+        static uint64_t getGeneration(uint64_t offset)
+        {
+            return (offset >> IndexBitsLimit) & (GenerationsNum - 1);
+        }
+
+        static uint64_t getIndex(uint64_t offset)
+        {
+            return offset & (MaxSegmentNodesNum - 1);
+        }
+    };
+
+    /*
+     * Запись таблицы сегментов процесса. Таблица присоединена к окну узлов,
+     * другие процессы читают запись при первом обращении к узлу сегмента нового поколения.
+     */
+    struct NodeSegmentDescriptor
+    {
+        MPI_Aint baseAddress{0}; // 0 - сегмент не выделен.
+        uint64_t generation{0};
+    };
+}
+
+#endif //SOURCES_NODESEGMENT_H
@@ -0,0 +1,31 @@
+#ifndef SOURCES_RMAWINDOWSYNC_H
+#define SOURCES_RMAWINDOWSYNC_H
+
+#include <mpi.h>
+
+namespace rma_stack::ref_counting
+{
+    /*
+     * Синхронизация доступа к окнам стека.
+     * В постоянном режиме на каждое окно открывается одна эпоха доступа MPI_Win_lock_all
+     * на всё время жизни стека, а lock/unlock ничего не делают - завершение операций
+     * обеспечивается вызовами MPI_Win_flush. Иначе каждая операция открывает и закрывает
+     * разделяемую блокировку целевого процесса.
+     */
+    class RmaWindowSync
+    {
+    public:
+        explicit RmaWindowSync(bool t_persistent = false);
+
+        void open(MPI_Win win) const;
+        void close(MPI_Win win) const;
+        void lock(int rank, MPI_Win win) const;
+        void unlock(int rank, MPI_Win win) const;
+
+        [[nodiscard]] bool isPersistent() const;
+    private:
+        bool m_persistent;
+    };
+}
+
+#endif //SOURCES_RMAWINDOWSYNC_H
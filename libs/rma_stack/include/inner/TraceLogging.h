@@ -0,0 +1,15 @@
+#ifndef SOURCES_TRACELOGGING_H
+#define SOURCES_TRACELOGGING_H
+
+/*
+ * Трассировка операций стеков. Без RMA_STACK_TRACE_LOGGING (сборка Release без опции CMake
+ * RMA_STACK_TRACE_LOGGING) вызов не выполняется и его аргументы не вычисляются,
+ * но проверяются компилятором, как и при включённой трассировке.
+ */
+#ifdef RMA_STACK_TRACE_LOGGING
+#define RMA_STACK_TRACE(logger, ...) (logger)->trace(__VA_ARGS__)
+#else
+#define RMA_STACK_TRACE(logger, ...) do { if (false) (logger)->trace(__VA_ARGS__); } while (false)
+#endif
+
+#endif //SOURCES_TRACELOGGING_H
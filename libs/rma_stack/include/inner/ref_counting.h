@@ -9,23 +9,75 @@
 
 namespace rma_stack::ref_counting
 {
-    constexpr uint64_t RankBitsLimit            = 13; // Кол-во бит под счётчик количества процессов.
-    constexpr uint64_t ExternalCounterBitsLimit = RankBitsLimit; // Кол-во бит под внешний счётчик ссылок.
+    /*
+     * Раскладка 64-битного глобального указателя со счётчиком ссылок:
+     * t_rankBits бит под номер процесса, t_externalCounterBits бит под внешний счётчик ссылок,
+     * оставшиеся биты - под адресацию узла внутри массива узлов процесса.
+     * Раскладка выбирается на этапе компиляции и не влияет на время выполнения операций.
+     */
+    template<uint64_t t_rankBits, uint64_t t_externalCounterBits>
+    struct CountedNodePtrLayout
+    {
+        static constexpr uint64_t RankBitsLimit            = t_rankBits; // Кол-во бит под счётчик количества процессов.
+        static constexpr uint64_t ExternalCounterBitsLimit = t_externalCounterBits; // Кол-во бит под внешний счётчик ссылок.
+
+        // Оставшееся кол-во бит отводится под адресацию памяти внутри вычислительного узла.
+        static constexpr uint64_t OffsetBitsLimit          = 64 - RankBitsLimit - ExternalCounterBitsLimit;
+        // Необходимо для обозначения глобального указателя на NULL - (DummyRank, любое смещение).
+        static constexpr uint64_t DummyRank                = (uint64_t{1} << RankBitsLimit) - 1;
+        // Наибольшее кол-во процессов, которые можно адресовать.
+        static constexpr uint64_t MaxProcNum               = DummyRank;
+        /*
+         * Наибольшее кол-во узлов, адресуемых смещением. Индексы списка свободных узлов 32-битные,
+         * поэтому конструктор InnerStack дополнительно требует, чтобы узлов было меньше FreeListEndIndex.
+         */
+        static constexpr uint64_t MaxElemsNum              = uint64_t{1} << OffsetBitsLimit;
+
+        static_assert(RankBitsLimit >= 1 && RankBitsLimit <= 31,
+                      "the rank must fit into int and leave room for the dummy rank");
+        // Внешний счётчик добавляется к 32-битному внутреннему счётчику узла.
+        static_assert(ExternalCounterBitsLimit >= 2 && ExternalCounterBitsLimit <= 30,
+                      "the external counter must hold at least two references and fit into the internal counter");
+        static_assert(RankBitsLimit + ExternalCounterBitsLimit < 64 && OffsetBitsLimit >= 16,
+                      "too few bits are left for the node offset");
+    };
 
-    // Оставшееся кол-во бит отводится под адресацию памяти внутри вычислительного узла.
-    constexpr uint64_t OffsetBitsLimit          = 64 - RankBitsLimit * 2;
-    constexpr uint64_t InternalCounterBitsLimit = RankBitsLimit;
-    // Необходимо для обозначения глобального указателя на NULL - (DummyRank, любое смещение).
-    constexpr uint64_t DummyRank                = (1 << RankBitsLimit) - 1;
+    // Во всех раскладках узлов на процесс меньше 2^32 - 1 (FreeListEndIndex).
+    using DefaultLayout  = CountedNodePtrLayout<13, 13>; // До 8191 процесса.
+    using LargeJobLayout = CountedNodePtrLayout<17, 13>; // До 131071 процесса.
+    using SmallJobLayout = CountedNodePtrLayout<8, 18>;  // До 255 процессов, устойчивый к частым POP внешний счётчик.
 
+    template<typename Layout = DefaultLayout>
     struct GlobalAddress
     {
-        uint64_t offset   : OffsetBitsLimit;
-        uint64_t rank     : RankBitsLimit;
-        uint64_t reserved   : 64 - OffsetBitsLimit - RankBitsLimit;
+        uint64_t offset   : Layout::OffsetBitsLimit;
+        uint64_t rank     : Layout::RankBitsLimit;
+        uint64_t reserved   : 64 - Layout::OffsetBitsLimit - Layout::RankBitsLimit;
     };
 
-    bool isGlobalAddressDummy(GlobalAddress globalAddress);
-    bool isValidRank(uint64_t rank);
+    // Признак конца списка свободных узлов.
+    constexpr uint32_t FreeListEndIndex         = UINT32_MAX;
+
+    /*
+     * Голова списка свободных узлов процесса. Тег увеличивается при каждой
+     * успешной замене головы, что исключает ABA-проблему при операции CAS.
+     */
+    struct FreeListHead
+    {
+        uint64_t index  : 32;
+        uint64_t tag    : 32;
+    };
+
+    template<typename Layout>
+    bool isGlobalAddressDummy(GlobalAddress<Layout> globalAddress)
+    {
+        return globalAddress.rank == Layout::DummyRank;
+    }
+
+    template<typename Layout>
+    bool isValidRank(uint64_t rank)
+    {
+        return rank < Layout::DummyRank;
+    }
 }
 #endif //SOURCES_REF_COUNTING_H
@@ -0,0 +1,228 @@
+#ifndef SOURCES_BACKOFFPOLICIES_H
+#define SOURCES_BACKOFFPOLICIES_H
+
+/*
+ * Политики задержки после неудачного CAS внешних стеков. Политика создаётся стеком один раз
+ * и задаётся параметром шаблона стека:
+ *   Backoff(minDelay, maxDelay) - границы задержки;
+ *   void reset(double contentionLevel) - вызывается в начале каждой операции стека с оценкой конкуренции
+ *     за голову (InnerStack::sampleContentionLevel), по которой выбирается начальная задержка;
+ *   void backoff() - вызывается после каждой неудачной попытки операции.
+ * ExponentialBackoff (см. ExponentialBackoff.h) - политика по умолчанию.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "outer/ExponentialBackoff.h"
+
+namespace rma_stack
+{
+    namespace backoff_detail
+    {
+        inline void cpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield" ::: "memory");
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        // Число инструкций pause в наносекунду, измеряется один раз на процесс.
+        inline double getRelaxesPerNs()
+        {
+            static const double relaxesPerNs = [] () {
+                constexpr uint32_t relaxesNum = 1u << 16u;
+                const auto start = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < relaxesNum; ++i)
+                {
+                    cpuRelax();
+                }
+                const auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+                return static_cast<double>(relaxesNum) / static_cast<double>(std::max<int64_t>(elapsedNs, 1));
+            }();
+            return relaxesPerNs;
+        }
+
+        inline void spinFor(const std::chrono::nanoseconds &rDelayNs)
+        {
+            const auto relaxesNum = static_cast<uint64_t>(static_cast<double>(rDelayNs.count()) * getRelaxesPerNs());
+            for (uint64_t i = 0; i < relaxesNum; ++i)
+            {
+                cpuRelax();
+            }
+        }
+
+        inline void checkDelays(const std::chrono::nanoseconds &rMinDelayNs, const std::chrono::nanoseconds &rMaxDelayNs)
+        {
+            const auto upperBoundDelayNs = std::chrono::nanoseconds(std::numeric_limits<int>::max());
+
+            if (rMinDelayNs > upperBoundDelayNs)
+                throw std::invalid_argument("the min delay is out of bounds");
+
+            if (rMaxDelayNs > upperBoundDelayNs)
+                throw std::invalid_argument("the max delay is out of bounds");
+
+            if (rMinDelayNs > rMaxDelayNs)
+                throw std::invalid_argument("the max delay is lower than min delay");
+        }
+
+        inline int doubleDelay(int delayInt, int maxDelayInt)
+        {
+            return static_cast<int>(std::min<int64_t>(2 * static_cast<int64_t>(std::max(delayInt, 1)), maxDelayInt));
+        }
+    } // backoff_detail
+
+    /*
+     * Экспоненциальная задержка активным ожиданием на калиброванном числе инструкций pause:
+     * в отличие от sleep_for не отдаёт процессор планировщику ОС и не округляет задержку до кванта таймера.
+     */
+    class SpinBackoff
+    {
+    public:
+        SpinBackoff(const std::chrono::nanoseconds &t_rMinDelayNs, const std::chrono::nanoseconds &t_rMaxDelayNs)
+        :
+        m_minDelayInt(static_cast<int>(t_rMinDelayNs.count())),
+        m_maxDelayInt(static_cast<int>(t_rMaxDelayNs.count())),
+        m_limitDelayInt(m_minDelayInt),
+        m_randomEngine(std::chrono::steady_clock::now().time_since_epoch().count())
+        {
+            backoff_detail::checkDelays(t_rMinDelayNs, t_rMaxDelayNs);
+            backoff_detail::getRelaxesPerNs();
+        }
+
+        void reset(double contentionLevel = 0.0)
+        {
+            m_limitDelayInt = getContentionDelayLimit(m_minDelayInt, m_maxDelayInt, contentionLevel);
+        }
+
+        void backoff()
+        {
+            const auto delayInt = std::uniform_int_distribution<int>(0, m_limitDelayInt)(m_randomEngine);
+            m_limitDelayInt = backoff_detail::doubleDelay(m_limitDelayInt, m_maxDelayInt);
+            backoff_detail::spinFor(std::chrono::nanoseconds(delayInt));
+        }
+
+    private:
+        int m_minDelayInt;
+        int m_maxDelayInt;
+        int m_limitDelayInt;
+
+        std::minstd_rand m_randomEngine;
+    };
+
+    /*
+     * Активное ожидание с ростом задержки до максимальной, после чего каждая следующая неудачная попытка
+     * операции уступает процессор (yield): при числе процессов больше числа ядер ожидающий процесс
+     * не мешает процессу, удерживающему вершину стека.
+     */
+    class SpinYieldBackoff
+    {
+    public:
+        SpinYieldBackoff(const std::chrono::nanoseconds &t_rMinDelayNs, const std::chrono::nanoseconds &t_rMaxDelayNs)
+        :
+        m_minDelayInt(static_cast<int>(t_rMinDelayNs.count())),
+        m_maxDelayInt(static_cast<int>(t_rMaxDelayNs.count())),
+        m_limitDelayInt(m_minDelayInt),
+        m_spinning(true)
+        {
+            backoff_detail::checkDelays(t_rMinDelayNs, t_rMaxDelayNs);
+            backoff_detail::getRelaxesPerNs();
+        }
+
+        void reset(double contentionLevel = 0.0)
+        {
+            m_limitDelayInt = getContentionDelayLimit(m_minDelayInt, m_maxDelayInt, contentionLevel);
+            m_spinning = true;
+        }
+
+        void backoff()
+        {
+            if (!m_spinning)
+            {
+                std::this_thread::yield();
+                return;
+            }
+
+            backoff_detail::spinFor(std::chrono::nanoseconds(m_limitDelayInt));
+            m_spinning = m_limitDelayInt < m_maxDelayInt;
+            m_limitDelayInt = backoff_detail::doubleDelay(m_limitDelayInt, m_maxDelayInt);
+        }
+
+    private:
+        int m_minDelayInt;
+        int m_maxDelayInt;
+        int m_limitDelayInt;
+        bool m_spinning;
+    };
+
+    /*
+     * Усечённая экспоненциальная задержка с состоянием, сохраняемым между операциями стека:
+     * предел задержки растёт при неудачных попытках и уменьшается вдвое в начале каждой операции,
+     * так что при устойчивой конкуренции операции сразу начинают с подходящей задержки.
+     */
+    class TruncatedExponentialBackoff
+    {
+    public:
+        TruncatedExponentialBackoff(const std::chrono::nanoseconds &t_rMinDelayNs,
+                                    const std::chrono::nanoseconds &t_rMaxDelayNs)
+        :
+        m_minDelayInt(static_cast<int>(t_rMinDelayNs.count())),
+        m_maxDelayInt(static_cast<int>(t_rMaxDelayNs.count())),
+        m_limitDelayInt(m_minDelayInt),
+        m_randomEngine(std::chrono::steady_clock::now().time_since_epoch().count())
+        {
+            backoff_detail::checkDelays(t_rMinDelayNs, t_rMaxDelayNs);
+            backoff_detail::getRelaxesPerNs();
+        }
+
+        void reset(double contentionLevel = 0.0)
+        {
+            m_limitDelayInt = std::max(getContentionDelayLimit(m_minDelayInt, m_maxDelayInt, contentionLevel),
+                                       m_limitDelayInt / 2);
+        }
+
+        void backoff()
+        {
+            const auto delayInt = std::uniform_int_distribution<int>(m_limitDelayInt / 2, m_limitDelayInt)(m_randomEngine);
+            m_limitDelayInt = backoff_detail::doubleDelay(m_limitDelayInt, m_maxDelayInt);
+            backoff_detail::spinFor(std::chrono::nanoseconds(delayInt));
+        }
+
+    private:
+        int m_minDelayInt;
+        int m_maxDelayInt;
+        int m_limitDelayInt;
+
+        std::minstd_rand m_randomEngine;
+    };
+
+    // Без задержки: повтор операции сразу после неудачной попытки.
+    class NoBackoff
+    {
+    public:
+        NoBackoff(const std::chrono::nanoseconds &, const std::chrono::nanoseconds &)
+        {}
+
+        void reset(double = 0.0)
+        {}
+
+        void backoff()
+        {}
+    };
+} // rma_stack
+
+#endif //SOURCES_BACKOFFPOLICIES_H
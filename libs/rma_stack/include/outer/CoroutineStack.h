@@ -0,0 +1,265 @@
+#ifndef SOURCES_COROUTINESTACK_H
+#define SOURCES_COROUTINESTACK_H
+
+/*
+ * Интерфейс стека на сопрограммах C++20 поверх неблокирующих операций pushAsync, popAsync.
+ * Библиотека собирается по стандарту C++17, заголовок подключается только приложениями,
+ * собранными по стандарту C++20 (опция RMA_STACK_COROUTINES).
+ */
+#if !defined(__cpp_impl_coroutine)
+#error "CoroutineStack.h requires a C++20 compiler with coroutine support"
+#endif
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace rma_stack
+{
+    class StackScheduler;
+
+    /*
+     * Сопрограмма, выполняемая планировщиком StackScheduler. Сопрограмма создаётся приостановленной
+     * и запускается после передачи планировщику (StackScheduler::spawn), который и уничтожает её после завершения.
+     */
+    class StackTask
+    {
+    public:
+        struct promise_type
+        {
+            StackScheduler *pScheduler{nullptr};
+
+            StackTask get_return_object()
+            {
+                return StackTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception();
+        };
+
+        StackTask(StackTask &&other) noexcept
+        :
+        m_handle(std::exchange(other.m_handle, nullptr))
+        {}
+        StackTask(const StackTask &) = delete;
+        StackTask &operator=(const StackTask &) = delete;
+        StackTask &operator=(StackTask &&) = delete;
+        ~StackTask()
+        {
+            if (m_handle)
+                m_handle.destroy();
+        }
+
+    private:
+        friend class StackScheduler;
+
+        explicit StackTask(std::coroutine_handle<promise_type> handle)
+        :
+        m_handle(handle)
+        {}
+
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    /*
+     * Планировщик сопрограмм процесса. Сопрограмма, ожидающая операцию стека, приостанавливается,
+     * а планировщик опрашивает дескрипторы незавершённых операций и возобновляет сопрограммы,
+     * операции которых завершены. Так на одном процессе выполняется множество логических операций,
+     * задержки RMA-операций которых перекрываются.
+     */
+    class StackScheduler
+    {
+    public:
+        void spawn(StackTask task)
+        {
+            auto handle = std::exchange(task.m_handle, nullptr);
+            handle.promise().pScheduler = this;
+            m_readyHandles.push_back(handle);
+            ++m_activeTasksNum;
+        }
+
+        // Выполнение сопрограмм до завершения всех, исключение сопрограммы передаётся вызывающему.
+        void run()
+        {
+            while (m_activeTasksNum > 0)
+            {
+                while (!m_readyHandles.empty())
+                {
+                    auto handle = m_readyHandles.front();
+                    m_readyHandles.pop_front();
+                    resume(handle);
+                }
+                poll();
+            }
+            if (m_exception)
+                std::rethrow_exception(std::exchange(m_exception, nullptr));
+        }
+
+        [[nodiscard]] size_t getActiveTasksNum() const
+        {
+            return m_activeTasksNum;
+        }
+
+        /*
+         * Ожидание операции: test продвигает операцию и возвращает true после её завершения.
+         * Дескриптор операции находится в кадре сопрограммы и не перемещается до её возобновления.
+         */
+        template<typename Request>
+        void suspend(std::coroutine_handle<> handle, Request &rRequest)
+        {
+            m_waitingOps.push_back({handle, &rRequest, [](void *pRequest) {
+                return static_cast<Request*>(pRequest)->test();
+            }});
+        }
+
+    private:
+        friend struct StackTask::promise_type;
+
+        struct WaitingOp
+        {
+            std::coroutine_handle<> handle;
+            void *pRequest;
+            bool (*test)(void *pRequest);
+        };
+
+        // Один проход по незавершённым операциям, сопрограммы завершённых операций переводятся в очередь готовых.
+        void poll()
+        {
+            size_t i{0};
+            while (i < m_waitingOps.size())
+            {
+                auto &rOp = m_waitingOps[i];
+                if (rOp.test(rOp.pRequest))
+                {
+                    m_readyHandles.push_back(rOp.handle);
+                    rOp = m_waitingOps.back();
+                    m_waitingOps.pop_back();
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+        }
+
+        void resume(std::coroutine_handle<> handle)
+        {
+            handle.resume();
+            if (handle.done())
+            {
+                handle.destroy();
+                --m_activeTasksNum;
+            }
+        }
+
+        std::deque<std::coroutine_handle<>> m_readyHandles;
+        std::vector<WaitingOp> m_waitingOps;
+        size_t m_activeTasksNum{0};
+        std::exception_ptr m_exception;
+    };
+
+    inline void StackTask::promise_type::unhandled_exception()
+    {
+        if (!pScheduler->m_exception)
+            pScheduler->m_exception = std::current_exception();
+    }
+
+    /*
+     * Обёртка внешнего стека с неблокирующими операциями (RmaTreiberCentralStack, RmaTreiberDecentralizedStack):
+     * co_await push(value) возвращает false при нехватке узлов, co_await pop() - пустое значение, если стек был пуст.
+     * Ограничения неблокирующих операций стека сохраняются (см. InnerStack::pushInlineAsync).
+     */
+    template<typename StackImpl>
+    class CoroutineStack
+    {
+        typedef typename StackImpl::ValueType T;
+        typedef typename StackImpl::RequestType RequestType;
+
+    public:
+        CoroutineStack(StackImpl &rStack, StackScheduler &rScheduler)
+        :
+        m_rStack(rStack),
+        m_rScheduler(rScheduler)
+        {}
+
+        class PushAwaiter
+        {
+        public:
+            PushAwaiter(CoroutineStack &rOwner, const T &rValue)
+            :
+            m_rOwner(rOwner),
+            m_value(rValue)
+            {}
+
+            bool await_ready()
+            {
+                m_rOwner.m_rStack.pushAsync(m_value, m_request);
+                return m_request.test();
+            }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                m_rOwner.m_rScheduler.suspend(handle, m_request);
+            }
+            bool await_resume() const
+            {
+                return m_request.getResult();
+            }
+
+        private:
+            CoroutineStack &m_rOwner;
+            T m_value;
+            RequestType m_request;
+        };
+
+        class PopAwaiter
+        {
+        public:
+            explicit PopAwaiter(CoroutineStack &rOwner)
+            :
+            m_rOwner(rOwner)
+            {}
+
+            bool await_ready()
+            {
+                m_rOwner.m_rStack.popAsync(m_value, m_defaultValue, m_request);
+                return m_request.test();
+            }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                m_rOwner.m_rScheduler.suspend(handle, m_request);
+            }
+            std::optional<T> await_resume() const
+            {
+                if (!m_request.getResult())
+                    return std::nullopt;
+                return m_value;
+            }
+
+        private:
+            CoroutineStack &m_rOwner;
+            T m_value{};
+            T m_defaultValue{};
+            RequestType m_request;
+        };
+
+        PushAwaiter push(const T &rValue)
+        {
+            return PushAwaiter(*this, rValue);
+        }
+        PopAwaiter pop()
+        {
+            return PopAwaiter(*this);
+        }
+
+    private:
+        StackImpl &m_rStack;
+        StackScheduler &m_rScheduler;
+    };
+} // rma_stack
+
+#endif //SOURCES_COROUTINESTACK_H
@@ -10,14 +10,26 @@
 
 namespace rma_stack
 {
+    /*
+     * Начальный предел задержки при среднем кол-ве неудачных CAS на операцию contentionLevel:
+     * предел удваивается на каждую ожидаемую неудачу, как если бы операция их уже встретила.
+     */
+    int getContentionDelayLimit(int minDelayInt, int maxDelayInt, double contentionLevel);
+
     class ExponentialBackoff
     {
     public:
         ExponentialBackoff(const std::chrono::nanoseconds &t_rMinDelayNs, const std::chrono::nanoseconds &t_rMaxDelayNs);
 
+        /*
+         * Сброс предела задержки в начале операции стека. contentionLevel - оценка конкуренции
+         * (InnerStack::sampleContentionLevel), задающая начальный предел задержки.
+         */
+        void reset(double contentionLevel = 0.0);
         void backoff();
 
     private:
+        const std::chrono::nanoseconds m_minDelayNs;
         const std::chrono::nanoseconds m_maxDelayNs;
         int  m_limitDelayInt;
 
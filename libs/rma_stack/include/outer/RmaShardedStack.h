@@ -0,0 +1,416 @@
+#ifndef SOURCES_RMASHARDEDSTACK_H
+#define SOURCES_RMASHARDEDSTACK_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "IStack.h"
+
+#include "outer/RmaTreiberDecentralizedStack.h"
+#include "inner/InnerStack.h"
+#include "inner/TraceLogging.h"
+#include "MpiException.h"
+
+namespace rma_stack
+{
+    namespace custom_mpi = custom_mpi_extensions;
+
+    /*
+     * Кол-во сегментов по умолчанию. Каждый сегмент - отдельный набор окон и узлов на каждом процессе,
+     * поэтому кол-во сегментов не растёт вместе с кол-вом процессов.
+     */
+    constexpr size_t DefaultShardsNum = 4;
+
+    /*
+     * Выбор сегмента для PUSH.
+     * Rank - домашний сегмент процесса, голова которого расположена на ближайшем по номеру процессе.
+     * Random - равновероятно выбранный сегмент.
+     */
+    enum class ShardSelection
+    {
+        Rank,
+        Random
+    };
+
+    /*
+     * Стек из k независимых сегментов - децентрализованных стеков Трейбера, головы которых
+     * расположены на разных процессах (на процессах с номерами s * P / k). Операции над разными
+     * сегментами не конкурируют за одну голову, поэтому пропускная способность растёт с k.
+     *
+     * Порядок извлечения ослаблен (k-relaxed LIFO):
+     * - каждый сегмент линеаризуем как стек LIFO;
+     * - POP возвращает значение с вершины одного из k сегментов, то есть одно из не более чем k
+     *   значений, которые могли бы быть возвращены в момент линеаризации, и начинает с домашнего сегмента;
+     * - при ShardSelection::Rank значения, добавленные процессом, извлекаются им в порядке LIFO,
+     *   если их не извлекли другие процессы;
+     * - POP возвращает значение по умолчанию после того, как все k сегментов оказались пусты
+     *   при последовательной проверке.
+     */
+    template<typename T, typename Layout = ref_counting::DefaultLayout, typename Backoff = ExponentialBackoff>
+    class RmaShardedStack: public stack_interface::IStack<RmaShardedStack<T, Layout, Backoff>>
+    {
+        friend class stack_interface::IStack_traits<rma_stack::RmaShardedStack<T, Layout, Backoff>>;
+    public:
+        typedef typename stack_interface::IStack_traits<RmaShardedStack>::ValueType ValueType;
+
+        explicit RmaShardedStack(MPI_Comm comm,
+                                 std::vector<MPI_Comm> &&t_shardComms,
+                                 std::vector<RmaTreiberDecentralizedStack<T, Layout, Backoff>> &&t_shards,
+                                 ShardSelection t_shardSelection,
+                                 std::shared_ptr<spdlog::logger> t_logger);
+        /*
+         * shardsNum - кол-во сегментов, не больше кол-ва процессов: при большем значении, как и при 0,
+         * создаётся по одному сегменту на процесс.
+         * Общие счётчики размера (InnerStackOptions::sizeCounterShardsNum) делятся между сегментами,
+         * не меньше одного на сегмент, поэтому size читает примерно столько же счётчиков, сколько один стек.
+         * elemsUpLimit - кол-во узлов, которое каждый процесс выделяет в каждом сегменте.
+         */
+        static RmaShardedStack<T, Layout, Backoff> create(
+                MPI_Comm comm,
+                MPI_Info info,
+                const std::chrono::nanoseconds &t_rBackoffMinDelay,
+                const std::chrono::nanoseconds &t_rBackoffMaxDelay,
+                int elemsUpLimit,
+                std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                const ref_counting::InnerStackOptions &innerStackOptions = {},
+                size_t shardsNum = DefaultShardsNum,
+                ShardSelection shardSelection = ShardSelection::Rank
+        );
+
+        RmaShardedStack(RmaShardedStack&) = delete;
+        RmaShardedStack(RmaShardedStack&&)  noexcept = default;
+        RmaShardedStack& operator=(RmaShardedStack&) = delete;
+        RmaShardedStack& operator=(RmaShardedStack&&)  noexcept = default;
+        ~RmaShardedStack() = default;
+
+        void release();
+        [[nodiscard]] size_t getShardsNum() const;
+        // Суммарные счётчики всех сегментов.
+        [[nodiscard]] const ref_counting::InnerStackStatistics &getStatistics() const;
+        // Значение на вершине первого непустого сегмента в порядке извлечения (начиная с домашнего).
+        [[nodiscard]] std::optional<T> peek();
+
+    private:
+        // public stack interface begin
+        void pushImpl(const T &rValue);
+        void popImpl(T &rValue, const T &rDefaultValue);
+        size_t pushNImpl(const T *pValues, size_t count);
+        size_t popNImpl(T *pValues, size_t maxCount);
+        T& topImpl();
+        size_t sizeImpl();
+        bool isEmptyImpl();
+        // public stack interface end
+
+        [[nodiscard]] size_t choosePushShard();
+
+        static std::shared_ptr<spdlog::logger> makeLogger(const std::string &name,
+                                                          std::shared_ptr<spdlog::sinks::sink> loggerSink);
+
+    private:
+        std::vector<MPI_Comm> m_shardComms;
+        std::vector<RmaTreiberDecentralizedStack<T, Layout, Backoff>> m_shards;
+        ShardSelection m_shardSelection;
+        size_t m_homeShard{0};
+        std::mt19937 m_shardRandomEngine;
+        // Значение, на которое ссылается результат top.
+        T m_topValue{};
+        mutable ref_counting::InnerStackStatistics m_statistics;
+        std::shared_ptr<spdlog::logger> m_logger;
+    };
+
+    template<typename T, typename Layout, typename Backoff>
+    RmaShardedStack<T, Layout, Backoff>::RmaShardedStack(MPI_Comm comm,
+                                                std::vector<MPI_Comm> &&t_shardComms,
+                                                std::vector<RmaTreiberDecentralizedStack<T, Layout, Backoff>> &&t_shards,
+                                                ShardSelection t_shardSelection,
+                                                std::shared_ptr<spdlog::logger> t_logger)
+            :
+            m_shardComms(std::move(t_shardComms)),
+            m_shards(std::move(t_shards)),
+            m_shardSelection(t_shardSelection),
+            m_logger(std::move(t_logger))
+    {
+        int rank{-1};
+        int procNum{0};
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &procNum);
+
+        // Голова сегмента s расположена на процессе s * P / k, домашний сегмент - ближайший снизу.
+        m_homeShard = static_cast<size_t>(rank) * m_shards.size() / static_cast<size_t>(procNum);
+        m_shardRandomEngine.seed(static_cast<std::mt19937::result_type>(
+                std::chrono::steady_clock::now().time_since_epoch().count() + rank)
+        );
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaShardedStack<T, Layout, Backoff>::release()
+    {
+        for (auto &rShard: m_shards)
+            rShard.release();
+        for (auto &rShardComm: m_shardComms)
+            MPI_Comm_free(&rShardComm);
+        RMA_STACK_TRACE(m_logger, "freed up shard communicators");
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaShardedStack<T, Layout, Backoff>::getShardsNum() const
+    {
+        return m_shards.size();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    const ref_counting::InnerStackStatistics &RmaShardedStack<T, Layout, Backoff>::getStatistics() const
+    {
+        m_statistics = {};
+        for (const auto &rShard: m_shards)
+        {
+            const auto &rShardStatistics = rShard.getStatistics();
+            m_statistics.eliminationAttemptsNum += rShardStatistics.eliminationAttemptsNum;
+            m_statistics.eliminationHitsNum += rShardStatistics.eliminationHitsNum;
+            m_statistics.stealAttemptsNum += rShardStatistics.stealAttemptsNum;
+            m_statistics.stealHitsNum += rShardStatistics.stealHitsNum;
+            m_statistics.stolenValuesNum += rShardStatistics.stolenValuesNum;
+            m_statistics.nodeSegmentGrowthsNum += rShardStatistics.nodeSegmentGrowthsNum;
+            m_statistics.nodeSegmentShrinksNum += rShardStatistics.nodeSegmentShrinksNum;
+            m_statistics.headCasFailuresNum += rShardStatistics.headCasFailuresNum;
+            m_statistics.pushesNum += rShardStatistics.pushesNum;
+            m_statistics.pushRoundTripsNum += rShardStatistics.pushRoundTripsNum;
+        }
+        return m_statistics;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaShardedStack<T, Layout, Backoff>::choosePushShard()
+    {
+        if (m_shardSelection == ShardSelection::Random)
+            return std::uniform_int_distribution<size_t>(0, m_shards.size() - 1)(m_shardRandomEngine);
+        return m_homeShard;
+    }
+
+    // Если в выбранном сегменте закончились узлы, значение добавляется в следующий сегмент.
+    template<typename T, typename Layout, typename Backoff>
+    void RmaShardedStack<T, Layout, Backoff>::pushImpl(const T &rValue)
+    {
+        const auto shardsNum = m_shards.size();
+        const auto firstShard = choosePushShard();
+        for (size_t i = 0; i < shardsNum; ++i)
+        {
+            if (m_shards[(firstShard + i) % shardsNum].tryPush(rValue))
+                return;
+        }
+        RMA_STACK_TRACE(m_logger, "all shards are full in 'pushImpl'");
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaShardedStack<T, Layout, Backoff>::popImpl(T &rValue, const T &rDefaultValue)
+    {
+        const auto shardsNum = m_shards.size();
+        for (size_t i = 0; i < shardsNum; ++i)
+        {
+            if (m_shards[(m_homeShard + i) % shardsNum].tryPop(rValue))
+                return;
+        }
+        rValue = rDefaultValue;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaShardedStack<T, Layout, Backoff>::pushNImpl(const T *pValues, size_t count)
+    {
+        const auto shardsNum = m_shards.size();
+        const auto firstShard = choosePushShard();
+        size_t pushedCount{0};
+        for (size_t i = 0; i < shardsNum && pushedCount < count; ++i)
+            pushedCount += m_shards[(firstShard + i) % shardsNum].pushN(pValues + pushedCount, count - pushedCount);
+
+        RMA_STACK_TRACE(m_logger, "finished 'pushNImpl' ({} of {} values)", pushedCount, count);
+        return pushedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaShardedStack<T, Layout, Backoff>::popNImpl(T *pValues, size_t maxCount)
+    {
+        const auto shardsNum = m_shards.size();
+        size_t poppedCount{0};
+        for (size_t i = 0; i < shardsNum && poppedCount < maxCount; ++i)
+            poppedCount += m_shards[(m_homeShard + i) % shardsNum].popN(pValues + poppedCount, maxCount - poppedCount);
+
+        RMA_STACK_TRACE(m_logger, "finished 'popNImpl' ({} of {} values)", poppedCount, maxCount);
+        return poppedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    std::shared_ptr<spdlog::logger> RmaShardedStack<T, Layout, Backoff>::makeLogger(const std::string &name,
+                                                                   std::shared_ptr<spdlog::sinks::sink> loggerSink)
+    {
+        auto pLogger = std::make_shared<spdlog::logger>(name, std::move(loggerSink));
+        spdlog::register_logger(pLogger);
+        pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+        pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+        return pLogger;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    T &rma_stack::RmaShardedStack<T, Layout, Backoff>::topImpl() {
+        // Ссылка действительна до следующего вызова top, для пустого стека значение по умолчанию.
+        m_topValue = peek().value_or(T{});
+        return m_topValue;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    std::optional<T> RmaShardedStack<T, Layout, Backoff>::peek()
+    {
+        const auto shardsNum = m_shards.size();
+        for (size_t i = 0; i < shardsNum; ++i)
+        {
+            if (auto value = m_shards[(m_homeShard + i) % shardsNum].peek())
+                return value;
+        }
+        return std::nullopt;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaShardedStack<T, Layout, Backoff>::sizeImpl()
+    {
+        size_t size{0};
+        for (auto &rShard: m_shards)
+            size += rShard.size();
+        return size;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaShardedStack<T, Layout, Backoff>::isEmptyImpl()
+    {
+        return std::all_of(m_shards.begin(), m_shards.end(), [](auto &rShard) {
+            return rShard.isEmpty();
+        });
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    RmaShardedStack<T, Layout, Backoff> RmaShardedStack<T, Layout, Backoff>::create(MPI_Comm comm, MPI_Info info,
+                                                                  const std::chrono::nanoseconds &t_rBackoffMinDelay,
+                                                                  const std::chrono::nanoseconds &t_rBackoffMaxDelay,
+                                                                  int elemsUpLimit,
+                                                                  std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                                                                  const ref_counting::InnerStackOptions &innerStackOptions,
+                                                                  size_t shardsNum,
+                                                                  ShardSelection shardSelection) {
+        ref_counting::InnerStack<Layout>::checkCommSize(comm);
+        if (innerStackOptions.inlinePayload
+            && !(std::is_trivially_copyable_v<T> && sizeof(T) <= ref_counting::MaxInlinePayloadSize))
+            throw std::invalid_argument("the inline payload requires a small trivially copyable value type");
+
+        int rank{-1};
+        int procNum{0};
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &procNum);
+        if (shardsNum == 0 || shardsNum > static_cast<size_t>(procNum))
+            shardsNum = static_cast<size_t>(procNum);
+
+        auto shardOptions = innerStackOptions;
+        if (shardOptions.sizeCounterShardsNum != 0
+            && shardOptions.sizeCounterShardsNum != ref_counting::PerRankSizeCounterShards)
+            shardOptions.sizeCounterShardsNum = std::max<size_t>(1, shardOptions.sizeCounterShardsNum / shardsNum);
+
+        std::vector<MPI_Comm> shardComms;
+        std::vector<RmaTreiberDecentralizedStack<T, Layout, Backoff>> shards;
+        shardComms.reserve(shardsNum);
+        shards.reserve(shardsNum);
+        for (size_t shard = 0; shard < shardsNum; ++shard)
+        {
+            /*
+             * Коммуникатор сегмента - тот же набор процессов, номера которых сдвинуты так,
+             * что процесс s * P / k получает номер HEAD_RANK и хранит голову сегмента.
+             */
+            const auto headRank = static_cast<int>(shard * static_cast<size_t>(procNum) / shardsNum);
+            MPI_Comm shardComm{MPI_COMM_NULL};
+            {
+                auto mpiStatus = MPI_Comm_split(comm, 0, (rank - headRank + procNum) % procNum, &shardComm);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to create shard communicator", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+            shardComms.push_back(shardComm);
+
+            const auto shardName = std::to_string(shard);
+            ref_counting::InnerStack<Layout> innerStack(
+                    shardComm,
+                    info,
+                    false,
+                    elemsUpLimit,
+                    makeLogger("ShardInnerStack" + shardName, loggerSink),
+                    shardOptions,
+                    sizeof(T)
+            );
+            shards.emplace_back(
+                    shardComm,
+                    info,
+                    t_rBackoffMinDelay,
+                    t_rBackoffMaxDelay,
+                    std::move(innerStack),
+                    makeLogger("ShardRmaTreiberDecentralizedStack" + shardName, loggerSink)
+            );
+        }
+
+        RmaShardedStack<T, Layout, Backoff> stack(
+                comm,
+                std::move(shardComms),
+                std::move(shards),
+                shardSelection,
+                makeLogger("RmaShardedStack", loggerSink)
+        );
+
+        MPI_Barrier(comm);
+        RMA_STACK_TRACE(stack.m_logger, "finished RmaShardedStack construction ({} shards)", shardsNum);
+        return stack;
+    }
+} // rma_stack
+
+
+namespace stack_interface
+{
+    template<typename T, typename Layout, typename Backoff>
+    struct IStack_traits<rma_stack::RmaShardedStack<T, Layout, Backoff>>
+    {
+        friend class IStack<rma_stack::RmaShardedStack<T, Layout, Backoff>>;
+        friend class rma_stack::RmaShardedStack<T, Layout, Backoff>;
+        typedef T ValueType;
+
+    private:
+        static void pushImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack, const T &value)
+        {
+            stack.pushImpl(value);
+        }
+        static void popImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack, ValueType &rValue, const ValueType &rDefaultValue)
+        {
+            stack.popImpl(rValue, rDefaultValue);
+        }
+        static size_t pushNImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack, const ValueType *pValues, size_t count)
+        {
+            return stack.pushNImpl(pValues, count);
+        }
+        static size_t popNImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack, ValueType *pValues, size_t maxCount)
+        {
+            return stack.popNImpl(pValues, maxCount);
+        }
+        static ValueType& topImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack)
+        {
+            return stack.topImpl();
+        }
+        static size_t sizeImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack)
+        {
+            return stack.sizeImpl();
+        }
+        static bool isEmptyImpl(rma_stack::RmaShardedStack<T, Layout, Backoff>& stack)
+        {
+            return stack.isEmptyImpl();
+        }
+    };
+}
+#endif //SOURCES_RMASHARDEDSTACK_H
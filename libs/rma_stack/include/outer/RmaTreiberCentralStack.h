@@ -8,36 +8,44 @@
 #include <mpi.h>
 #include <memory>
 #include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 #include "IStack.h"
 
-#include "outer/ExponentialBackoff.h"
+#include "outer/BackoffPolicies.h"
+#include "outer/UserDataBatch.h"
+#include "outer/UserDataPrefetch.h"
 #include "inner/InnerStack.h"
+#include "inner/TraceLogging.h"
 #include "MpiException.h"
 
 namespace rma_stack
 {
     namespace custom_mpi = custom_mpi_extensions;
 
-    template<typename T>
-    class RmaTreiberCentralStack: public stack_interface::IStack<RmaTreiberCentralStack<T>>
+    template<typename T, typename Layout = ref_counting::DefaultLayout, typename Backoff = ExponentialBackoff>
+    class RmaTreiberCentralStack: public stack_interface::IStack<RmaTreiberCentralStack<T, Layout, Backoff>>
     {
-        friend class stack_interface::IStack_traits<rma_stack::RmaTreiberCentralStack<T>>;
+        friend class stack_interface::IStack_traits<rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>>;
     public:
         typedef typename stack_interface::IStack_traits<RmaTreiberCentralStack>::ValueType ValueType;
+        typedef ref_counting::InnerStackRequest<Layout> RequestType;
 
         explicit RmaTreiberCentralStack(MPI_Comm comm, MPI_Info info,
                                         const std::chrono::nanoseconds &t_rBackoffMinDelay,
                                         const std::chrono::nanoseconds &t_rBackoffMaxDelay,
-                                        ref_counting::InnerStack &&t_innerStack,
+                                        ref_counting::InnerStack<Layout> &&t_innerStack,
                                         std::shared_ptr<spdlog::logger> t_logger);
-        static RmaTreiberCentralStack <T> create(
+        static RmaTreiberCentralStack<T, Layout, Backoff> create(
                 MPI_Comm comm,
                 MPI_Info info,
                 const std::chrono::nanoseconds &t_rBackoffMinDelay,
                 const std::chrono::nanoseconds &t_rBackoffMaxDelay,
                 int elemsUpLimit,
-                std::shared_ptr<spdlog::sinks::sink> loggerSink
+                std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                const ref_counting::InnerStackOptions &innerStackOptions = {}
         );
 
         RmaTreiberCentralStack(RmaTreiberCentralStack&) = delete;
@@ -47,66 +55,162 @@ namespace rma_stack
         ~RmaTreiberCentralStack() = default;
 
         void release();
+        [[nodiscard]] const ref_counting::InnerStackStatistics &getStatistics() const;
+
+        /*
+         * Неблокирующие операции, см. InnerStack::pushInlineAsync. Требуют InnerStackOptions::inlinePayload.
+         * rValue операции popAsync должен существовать до завершения операции.
+         */
+        void pushAsync(const T &rValue, RequestType &rRequest);
+        void popAsync(T &rValue, const T &rDefaultValue, RequestType &rRequest);
+
+        /*
+         * PUSH и POP одного значения с результатом: tryPush возвращает false при нехватке узлов,
+         * tryPop - если стек пуст, rValue при этом не изменяется. В отличие от pushN и popN
+         * функции обратного вызова встраиваются в операцию, см. InnerStack::push.
+         */
+        bool tryPush(const T &rValue);
+        bool tryPop(T &rValue);
+
+        /*
+         * Чтение без извлечения, см. InnerStack::peekN: peek возвращает значение на вершине
+         * или std::nullopt, если стек пуст, peekTopK - до k значений, начиная с вершины.
+         */
+        [[nodiscard]] std::optional<T> peek();
+        [[nodiscard]] std::vector<T> peekTopK(size_t k);
+
+        /*
+         * Резервирование до maxCount узлов для следующих pushN процесса, см. InnerStack::reserveNodes.
+         * Возвращает кол-во зарезервированных узлов.
+         */
+        size_t reserveNodes(size_t maxCount);
+        void releaseReservedNodes();
 
     private:
         // public stack interface begin
         void pushImpl(const T &rValue);
         void  popImpl(T &rValue, const T &rDefaultValue);
+        size_t pushNImpl(const T *pValues, size_t count);
+        size_t popNImpl(T *pValues, size_t maxCount);
         T& topImpl();
         size_t sizeImpl();
         bool isEmptyImpl();
         // public stack interface end
 
         void initRemoteAccessMemory(MPI_Comm comm, MPI_Info info);
+        [[nodiscard]] auto getDataBaseAddressGetter() const;
+        size_t peekValues(T *pValues, size_t maxCount);
 
     private:
-        std::chrono::nanoseconds m_backoffMinDelay;
-        std::chrono::nanoseconds m_backoffMaxDelay;
+        // Состояние политики задержки сохраняется между операциями стека.
+        Backoff m_backoff;
 
-        ref_counting::InnerStack m_innerStack;
+        ref_counting::InnerStack<Layout> m_innerStack;
         int m_rank{-1};
         MPI_Win m_userDataWin{MPI_WIN_NULL};
+        ref_counting::IntraNodeWindow m_intraNodeUserDataWin;
         T* m_pUserDataArr{nullptr};
         MPI_Aint m_userDataBaseAddress{(MPI_Aint)MPI_BOTTOM};
+        // Значение, на которое ссылается результат top.
+        T m_topValue{};
+
         std::shared_ptr<spdlog::logger> m_logger;
     };
 
-    template<typename T>
-    void RmaTreiberCentralStack<T>::release()
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::release()
     {
         m_innerStack.release();
+        if (m_innerStack.hasInlinePayload())
+            return;
+
+        m_innerStack.getWindowSync().close(m_userDataWin);
+
+        // Память статического окна освобождается вместе с окном.
+        if (m_innerStack.hasStaticWindows())
+        {
+            MPI_Win_free(&m_userDataWin);
+            m_pUserDataArr = nullptr;
+            m_intraNodeUserDataWin.unmap();
+            RMA_STACK_TRACE(m_logger, "freed up data win RMA memory");
+            return;
+        }
 
         MPI_Free_mem(m_pUserDataArr);
         m_pUserDataArr = nullptr;
-        m_logger->trace("freed up data arr RMA memory");
+        RMA_STACK_TRACE(m_logger, "freed up data arr RMA memory");
 
         MPI_Win_free(&m_userDataWin);
-        m_logger->trace("freed up data win RMA memory");
+        RMA_STACK_TRACE(m_logger, "freed up data win RMA memory");
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    const ref_counting::InnerStackStatistics &RmaTreiberCentralStack<T, Layout, Backoff>::getStatistics() const
+    {
+        return m_innerStack.getStatistics();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberCentralStack<T, Layout, Backoff>::reserveNodes(size_t maxCount)
+    {
+        return m_innerStack.reserveNodes(maxCount);
     }
 
-    template<typename T>
-    RmaTreiberCentralStack<T>::RmaTreiberCentralStack(MPI_Comm comm, MPI_Info info,
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::releaseReservedNodes()
+    {
+        m_innerStack.releaseReservedNodes();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::pushAsync(const T &rValue, RequestType &rRequest)
+    {
+        m_innerStack.pushInlineAsync(&rValue, rRequest);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::popAsync(T &rValue, const T &rDefaultValue, RequestType &rRequest)
+    {
+        m_innerStack.popInlineAsync(&rValue, &rDefaultValue, rRequest);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    RmaTreiberCentralStack<T, Layout, Backoff>::RmaTreiberCentralStack(MPI_Comm comm, MPI_Info info,
                                                       const std::chrono::nanoseconds &t_rBackoffMinDelay,
                                                       const std::chrono::nanoseconds &t_rBackoffMaxDelay,
-                                                      ref_counting::InnerStack &&t_innerStack,
+                                                      ref_counting::InnerStack<Layout> &&t_innerStack,
                                                       std::shared_ptr<spdlog::logger> t_logger)
     :
-    m_backoffMinDelay(t_rBackoffMinDelay),
-    m_backoffMaxDelay(t_rBackoffMaxDelay),
+    m_backoff(t_rBackoffMinDelay, t_rBackoffMaxDelay),
     m_innerStack(std::move(t_innerStack)),
     m_logger(std::move(t_logger))
     {
         MPI_Comm_rank(comm, &m_rank);
+        m_innerStack.setFreeListBackoffDelays(t_rBackoffMinDelay, t_rBackoffMaxDelay);
 
         initRemoteAccessMemory(comm, info);
     }
 
-    template<typename T>
-    void RmaTreiberCentralStack<T>::pushImpl(const T &rValue)
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::pushImpl(const T &rValue)
+    {
+        tryPush(rValue);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberCentralStack<T, Layout, Backoff>::tryPush(const T &rValue)
     {
-        ExponentialBackoff backoff(m_backoffMinDelay, m_backoffMaxDelay);
-        m_innerStack.push([&rValue, &win = m_userDataWin, &dataBaseAddress = m_userDataBaseAddress](
-                const ref_counting::GlobalAddress &dataAddress) {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            const auto isPushed = m_innerStack.pushInline(&rValue, [this] () {
+                m_backoff.backoff();
+            });
+            RMA_STACK_TRACE(m_logger, "finished 'push'");
+            return isPushed;
+        }
+        const auto isPushed = m_innerStack.push([&rValue, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &dataBaseAddress = m_userDataBaseAddress](
+                const ref_counting::GlobalAddress<Layout> &dataAddress) {
                 if (ref_counting::isGlobalAddressDummy(dataAddress))
                     return;
 
@@ -114,8 +218,8 @@ namespace rma_stack
                 const auto displacement = dataAddress.offset * valueSize;
                 const auto offset = MPI_Aint_add(dataBaseAddress, displacement);
 
-                MPI_Win_lock(MPI_LOCK_SHARED, dataAddress.rank, MPI_MODE_NOCHECK, win);
-                MPI_Put(&rValue,
+                rWindowSync.lock(dataAddress.rank, win);
+                rIntraNodeWin.put(&rValue,
                         valueSize,
                         MPI_UNSIGNED_CHAR,
                         dataAddress.rank,
@@ -124,34 +228,73 @@ namespace rma_stack
                         MPI_UNSIGNED_CHAR,
                         win
                 );
-                MPI_Win_flush(dataAddress.rank, win);
-                MPI_Win_unlock(dataAddress.rank, win);
             },
-             [&backoff] () {
-                 backoff.backoff();
+            // Запись завершается отдельным ожиданием после записи указателя на следующий узел, до CAS головы.
+            [&win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin](
+                    const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                rIntraNodeWin.flush(dataAddress.rank, win);
+                rWindowSync.unlock(dataAddress.rank, win);
+            },
+             [this] () {
+                 m_backoff.backoff();
              }
         );
 
-        m_logger->trace("finished 'push'",m_rank);
+        RMA_STACK_TRACE(m_logger, "finished 'push'");
+        return isPushed;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::popImpl(T &rValue, const T &rDefaultValue)
+    {
+        if (!tryPop(rValue))
+            rValue = rDefaultValue;
     }
 
-    template<typename T>
-    void RmaTreiberCentralStack<T>::popImpl(T &rValue, const T &rDefaultValue)
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberCentralStack<T, Layout, Backoff>::tryPop(T &rValue)
     {
-        ExponentialBackoff backoff(m_backoffMinDelay, m_backoffMaxDelay);
-        m_innerStack.pop([&rValue, &rDefaultValue, &win = m_userDataWin, &dataBaseAddress = m_userDataBaseAddress](
-                const ref_counting::GlobalAddress &dataAddress) {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            const auto isPopped = m_innerStack.popInline(&rValue, [this] () {
+                m_backoff.backoff();
+            });
+            RMA_STACK_TRACE(m_logger, "finished 'popImpl'");
+            return isPopped;
+        }
+        if (m_innerStack.hasPopPayloadPrefetch())
+        {
+            UserDataPrefetch<T> prefetch(m_userDataWin, m_innerStack.getWindowSync(), m_intraNodeUserDataWin);
+            const auto isPopped = m_innerStack.pop([&prefetch, &dataBaseAddress = m_userDataBaseAddress](const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                    prefetch.start(dataAddress.rank, MPI_Aint_add(dataBaseAddress, dataAddress.offset * sizeof(T)));
+                },
+                [&rValue, &prefetch](const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                    if (ref_counting::isGlobalAddressDummy(dataAddress))
+                    {
+                        prefetch.discard();
+                        return;
+                    }
+                    prefetch.complete(rValue);
+                },
+                [this] () {
+                    m_backoff.backoff();
+                }
+            );
+            prefetch.discard();
+            RMA_STACK_TRACE(m_logger, "finished 'popImpl'");
+            return isPopped;
+        }
+        const auto isPopped = m_innerStack.pop([&rValue, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &dataBaseAddress = m_userDataBaseAddress](
+                const ref_counting::GlobalAddress<Layout> &dataAddress) {
                 if (ref_counting::isGlobalAddressDummy(dataAddress))
-                {
-                    rValue = rDefaultValue;
                     return;
-                }
 
                 constexpr auto valueSize = sizeof(rValue);
                 const auto offset = dataAddress.offset * valueSize;
                 const auto displacement = MPI_Aint_add(dataBaseAddress, offset);
-                MPI_Win_lock(MPI_LOCK_SHARED, dataAddress.rank, MPI_MODE_NOCHECK, win);
-                MPI_Get(&rValue,
+                rWindowSync.lock(dataAddress.rank, win);
+                rIntraNodeWin.get(&rValue,
                         valueSize,
                         MPI_UNSIGNED_CHAR,
                         dataAddress.rank,
@@ -160,46 +303,206 @@ namespace rma_stack
                         MPI_UNSIGNED_CHAR,
                         win
                 );
-                MPI_Win_flush(dataAddress.rank, win);
-                MPI_Win_unlock(dataAddress.rank, win);
+                rIntraNodeWin.flush(dataAddress.rank, win);
+                rWindowSync.unlock(dataAddress.rank, win);
             },
-            [&backoff] () {
-                backoff.backoff();
+            [this] () {
+                m_backoff.backoff();
             }
         );
-        m_logger->trace("finished 'popImpl'",m_rank);
+        RMA_STACK_TRACE(m_logger, "finished 'popImpl'");
+        return isPopped;
     }
 
-    template<typename T>
-    T &rma_stack::RmaTreiberCentralStack<T>::topImpl() {
-        T v{};
-        return v;
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberCentralStack<T, Layout, Backoff>::pushNImpl(const T *pValues, size_t count)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            return m_innerStack.pushNInline(count, pValues, [this] () {
+                m_backoff.backoff();
+            });
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        const auto pushedCount = m_innerStack.pushN(count,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Put,
+                                      const_cast<T *>(pValues),
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+
+        RMA_STACK_TRACE(m_logger, "finished 'pushNImpl' ({} of {} values)", pushedCount, count);
+        return pushedCount;
     }
 
-    template<typename T>
-    size_t RmaTreiberCentralStack<T>::sizeImpl()
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberCentralStack<T, Layout, Backoff>::popNImpl(T *pValues, size_t maxCount)
     {
-        return 0;
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            return m_innerStack.popNInline(maxCount, pValues, [this] () {
+                m_backoff.backoff();
+            });
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        const auto poppedCount = m_innerStack.popN(maxCount,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Get,
+                                      pValues,
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+
+        RMA_STACK_TRACE(m_logger, "finished 'popNImpl' ({} of {} values)", poppedCount, maxCount);
+        return poppedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    auto RmaTreiberCentralStack<T, Layout, Backoff>::getDataBaseAddressGetter() const
+    {
+        return [&dataBaseAddress = m_userDataBaseAddress](int) {
+            return dataBaseAddress;
+        };
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    T &rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>::topImpl() {
+        // Ссылка действительна до следующего вызова top, для пустого стека значение по умолчанию.
+        m_topValue = peek().value_or(T{});
+        return m_topValue;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    std::optional<T> RmaTreiberCentralStack<T, Layout, Backoff>::peek()
+    {
+        T value{};
+        if (peekValues(&value, 1) == 0)
+            return std::nullopt;
+        return value;
     }
 
-    template<typename T>
-    bool RmaTreiberCentralStack<T>::isEmptyImpl()
+    template<typename T, typename Layout, typename Backoff>
+    std::vector<T> RmaTreiberCentralStack<T, Layout, Backoff>::peekTopK(size_t k)
     {
-        return true;
+        std::vector<T> values(k);
+        values.resize(peekValues(values.data(), k));
+        return values;
     }
 
-    template<typename T>
-    void RmaTreiberCentralStack<T>::initRemoteAccessMemory(MPI_Comm comm, MPI_Info info)
+    // Данные узлов цепочки читаются одной пакетной операцией на каждый процесс-владелец.
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberCentralStack<T, Layout, Backoff>::peekValues(T *pValues, size_t maxCount)
     {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            return m_innerStack.peekNInline(maxCount, pValues, [this] () {
+                m_backoff.backoff();
+            });
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        const auto peekedCount = m_innerStack.peekN(maxCount,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Get,
+                                      pValues,
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+
+        RMA_STACK_TRACE(m_logger, "finished 'peekValues' ({} of {} values)", peekedCount, maxCount);
+        return peekedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberCentralStack<T, Layout, Backoff>::sizeImpl()
+    {
+        return m_innerStack.getSize(
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberCentralStack<T, Layout, Backoff>::isEmptyImpl()
+    {
+        return m_innerStack.isEmpty();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberCentralStack<T, Layout, Backoff>::initRemoteAccessMemory(MPI_Comm comm, MPI_Info info)
+    {
+        // Данные пользователя хранятся в узлах внутреннего стека, окно данных не нужно.
+        if (m_innerStack.hasInlinePayload())
+            return;
+
+        if (m_innerStack.hasStaticWindows())
+        {
+            const auto isHeadRank = m_rank == ref_counting::InnerStack<Layout>::HEAD_RANK;
+            const auto elemsUpLimit = m_innerStack.getElemsUpLimit();
+            const auto userDataSize = isHeadRank ? static_cast<MPI_Aint>(sizeof(T) * elemsUpLimit) : 0;
+            if (m_innerStack.hasIntraNodeSharedMemory())
+            {
+                m_intraNodeUserDataWin.allocate(userDataSize, info, comm, &m_pUserDataArr, &m_userDataWin);
+            }
+            else
+            {
+                auto mpiStatus = MPI_Win_allocate(userDataSize, 1, info, comm, &m_pUserDataArr, &m_userDataWin);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to allocate RMA window for user data", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+            if (isHeadRank)
+                std::fill_n(m_pUserDataArr, elemsUpLimit, T());
+            else
+                m_pUserDataArr = nullptr;
+            m_userDataBaseAddress = 0;
+
+            m_innerStack.getWindowSync().open(m_userDataWin);
+            return;
+        }
+
         {
             auto mpiStatus = MPI_Win_create_dynamic(info, comm, &m_userDataWin);
             if (mpiStatus != MPI_SUCCESS)
                 throw custom_mpi::MpiException("failed to create RMA window for head", __FILE__, __func__, __LINE__, mpiStatus);
         }
 
-        if (m_rank == ref_counting::InnerStack::HEAD_RANK)
+        if (m_rank == ref_counting::InnerStack<Layout>::HEAD_RANK)
         {
-            m_logger->trace("started to initialize user data array");
+            RMA_STACK_TRACE(m_logger, "started to initialize user data array");
             auto elemsUpLimit = m_innerStack.getElemsUpLimit();
             constexpr auto elemSize = sizeof(T);
             {
@@ -215,39 +518,49 @@ namespace rma_stack
                     );
             }
             std::fill_n(m_pUserDataArr, elemsUpLimit, T());
-            m_logger->trace("initialized user data array");
+            RMA_STACK_TRACE(m_logger, "initialized user data array");
             {
                 auto mpiStatus = MPI_Win_attach(m_userDataWin, m_pUserDataArr, elemSize * elemsUpLimit);
                 if (mpiStatus != MPI_SUCCESS)
                     throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
             }
-            m_logger->trace("attached user data RMA window");
+            RMA_STACK_TRACE(m_logger, "attached user data RMA window");
             MPI_Get_address(m_pUserDataArr, &m_userDataBaseAddress);
         }
-        m_logger->trace("started to broadcast user data base address");
-        auto mpiStatus = MPI_Bcast(&m_userDataBaseAddress, 1, MPI_AINT, ref_counting::InnerStack::HEAD_RANK, comm);
+        RMA_STACK_TRACE(m_logger, "started to broadcast user data base address");
+        auto mpiStatus = MPI_Bcast(&m_userDataBaseAddress, 1, MPI_AINT, ref_counting::InnerStack<Layout>::HEAD_RANK, comm);
         if (mpiStatus != MPI_SUCCESS)
             throw custom_mpi::MpiException("failed to broadcast head address", __FILE__, __func__ , __LINE__, mpiStatus);
-        m_logger->trace("broadcasted user data base address");
+        RMA_STACK_TRACE(m_logger, "broadcasted user data base address");
+
+        m_innerStack.getWindowSync().open(m_userDataWin);
     }
 
-    template<typename T>
-    RmaTreiberCentralStack<T> RmaTreiberCentralStack<T>::create(MPI_Comm comm, MPI_Info info,
+    template<typename T, typename Layout, typename Backoff>
+    RmaTreiberCentralStack<T, Layout, Backoff> RmaTreiberCentralStack<T, Layout, Backoff>::create(MPI_Comm comm, MPI_Info info,
                                                                                       const std::chrono::nanoseconds &t_rBackoffMinDelay,
                                                                                       const std::chrono::nanoseconds &t_rBackoffMaxDelay,
                                                                                       int elemsUpLimit,
-                                                                                      std::shared_ptr<spdlog::sinks::sink> loggerSink) {
+                                                                                      std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                                                                                      const ref_counting::InnerStackOptions &innerStackOptions) {
+        ref_counting::InnerStack<Layout>::checkCommSize(comm);
+        if (innerStackOptions.inlinePayload
+            && !(std::is_trivially_copyable_v<T> && sizeof(T) <= ref_counting::MaxInlinePayloadSize))
+            throw std::invalid_argument("the inline payload requires a small trivially copyable value type");
+
         auto pInnerStackLogger = std::make_shared<spdlog::logger>("InnerStack", loggerSink);
         spdlog::register_logger(pInnerStackLogger);
         pInnerStackLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
         pInnerStackLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
 
-        ref_counting::InnerStack innerStack(
+        ref_counting::InnerStack<Layout> innerStack(
                 comm,
                 info,
                 true,
                 elemsUpLimit,
-                std::move(pInnerStackLogger)
+                std::move(pInnerStackLogger),
+                innerStackOptions,
+                sizeof(T)
         );
 
         auto pOuterStackLogger = std::make_shared<spdlog::logger>("RmaTreiberCentralStack", loggerSink);
@@ -255,7 +568,7 @@ namespace rma_stack
         pOuterStackLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
         pOuterStackLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
         
-        RmaTreiberCentralStack<T> stack(
+        RmaTreiberCentralStack<T, Layout, Backoff> stack(
                 comm,
                 info,
                 t_rBackoffMinDelay,
@@ -265,7 +578,7 @@ namespace rma_stack
         );
 
         MPI_Barrier(comm);
-        stack.m_logger->trace("finished RmaTreiberCentralStack construction");
+        RMA_STACK_TRACE(stack.m_logger, "finished RmaTreiberCentralStack construction");
         return stack;
     }
 } // rma_stack
@@ -273,31 +586,39 @@ namespace rma_stack
 
 namespace stack_interface
 {
-    template<typename T>
-    struct IStack_traits<rma_stack::RmaTreiberCentralStack < T>>
+    template<typename T, typename Layout, typename Backoff>
+    struct IStack_traits<rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>>
     {
-        friend class IStack<rma_stack::RmaTreiberCentralStack < T>>;
-        friend class rma_stack::RmaTreiberCentralStack<T>;
+        friend class IStack<rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>>;
+        friend class rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>;
         typedef T ValueType;
 
     private:
-        static void pushImpl(rma_stack::RmaTreiberCentralStack<T>& stack, const T &value)
+        static void pushImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack, const T &value)
         {
             stack.pushImpl(value);
         }
-        static void popImpl(rma_stack::RmaTreiberCentralStack<T>& stack, ValueType &rValue, const ValueType &rDefaultValue)
+        static void popImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack, ValueType &rValue, const ValueType &rDefaultValue)
         {
             stack.popImpl(rValue, rDefaultValue);
         }
-        static ValueType& topImpl(rma_stack::RmaTreiberCentralStack<T>& stack)
+        static size_t pushNImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack, const ValueType *pValues, size_t count)
+        {
+            return stack.pushNImpl(pValues, count);
+        }
+        static size_t popNImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack, ValueType *pValues, size_t maxCount)
+        {
+            return stack.popNImpl(pValues, maxCount);
+        }
+        static ValueType& topImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack)
         {
             return stack.topImpl();
         }
-        static size_t sizeImpl(rma_stack::RmaTreiberCentralStack<T>& stack)
+        static size_t sizeImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack)
         {
             return stack.sizeImpl();
         }
-        static bool isEmptyImpl(rma_stack::RmaTreiberCentralStack<T>& stack)
+        static bool isEmptyImpl(rma_stack::RmaTreiberCentralStack<T, Layout, Backoff>& stack)
         {
             return stack.isEmptyImpl();
         }
@@ -6,38 +6,49 @@
 #define SOURCES_RMATREIBERDECENTRALIZEDSTACK_H
 
 #include <mpi.h>
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <optional>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 #include "IStack.h"
 
-#include "outer/ExponentialBackoff.h"
+#include "outer/BackoffPolicies.h"
+#include "outer/UserDataBatch.h"
+#include "outer/UserDataPrefetch.h"
 #include "inner/InnerStack.h"
+#include "inner/TraceLogging.h"
 #include "MpiException.h"
 
 namespace rma_stack
 {
     namespace custom_mpi = custom_mpi_extensions;
 
-    template<typename T>
-    class RmaTreiberDecentralizedStack: public stack_interface::IStack<RmaTreiberDecentralizedStack<T>>
+    template<typename T, typename Layout = ref_counting::DefaultLayout, typename Backoff = ExponentialBackoff>
+    class RmaTreiberDecentralizedStack: public stack_interface::IStack<RmaTreiberDecentralizedStack<T, Layout, Backoff>>
     {
-        friend class stack_interface::IStack_traits<rma_stack::RmaTreiberDecentralizedStack<T>>;
+        friend class stack_interface::IStack_traits<rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>>;
     public:
         typedef typename stack_interface::IStack_traits<RmaTreiberDecentralizedStack>::ValueType ValueType;
+        typedef ref_counting::InnerStackRequest<Layout> RequestType;
 
         explicit RmaTreiberDecentralizedStack(MPI_Comm comm, MPI_Info info,
                                               const std::chrono::nanoseconds &t_rBackoffMinDelay,
                                               const std::chrono::nanoseconds &t_rBackoffMaxDelay,
-                                              ref_counting::InnerStack &&t_innerStack,
+                                              ref_counting::InnerStack<Layout> &&t_innerStack,
                                               std::shared_ptr<spdlog::logger> t_logger);
-        static RmaTreiberDecentralizedStack <T> create(
+        static RmaTreiberDecentralizedStack<T, Layout, Backoff> create(
                 MPI_Comm comm,
                 MPI_Info info,
                 const std::chrono::nanoseconds &t_rBackoffMinDelay,
                 const std::chrono::nanoseconds &t_rBackoffMaxDelay,
                 int elemsUpLimit,
-                std::shared_ptr<spdlog::sinks::sink> loggerSink
+                std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                const ref_counting::InnerStackOptions &innerStackOptions = {}
         );
 
         RmaTreiberDecentralizedStack(RmaTreiberDecentralizedStack&) = delete;
@@ -47,71 +58,183 @@ namespace rma_stack
         ~RmaTreiberDecentralizedStack() = default;
 
         void release();
+        [[nodiscard]] const ref_counting::InnerStackStatistics &getStatistics() const;
+
+        /*
+         * Неблокирующие операции, см. InnerStack::pushInlineAsync. Требуют InnerStackOptions::inlinePayload
+         * и недоступны при InnerStackOptions::workStealing.
+         * rValue операции popAsync должен существовать до завершения операции.
+         */
+        void pushAsync(const T &rValue, RequestType &rRequest);
+        void popAsync(T &rValue, const T &rDefaultValue, RequestType &rRequest);
+
+        /*
+         * PUSH и POP одного значения с результатом: tryPush возвращает false при нехватке узлов,
+         * tryPop - если стек пуст (при InnerStackOptions::workStealing - если пусты стеки всех процессов),
+         * rValue при этом не изменяется. В отличие от pushN и popN функции обратного вызова
+         * встраиваются в операцию, см. InnerStack::push.
+         */
+        bool tryPush(const T &rValue);
+        bool tryPop(T &rValue);
+
+        /*
+         * Чтение без извлечения, см. InnerStack::peekN: peek возвращает значение на вершине
+         * или std::nullopt, если стек пуст, peekTopK - до k значений, начиная с вершины.
+         */
+        [[nodiscard]] std::optional<T> peek();
+        [[nodiscard]] std::vector<T> peekTopK(size_t k);
+
+        /*
+         * Резервирование до maxCount узлов для следующих pushN процесса, см. InnerStack::reserveNodes.
+         * Возвращает кол-во зарезервированных узлов.
+         */
+        size_t reserveNodes(size_t maxCount);
+        void releaseReservedNodes();
 
     private:
         // public stack interface begin
         void pushImpl(const T &rValue);
         void popImpl(T &rValue, const T &rDefaultValue);
+        size_t pushNImpl(const T *pValues, size_t count);
+        size_t popNImpl(T *pValues, size_t maxCount);
         T& topImpl();
         size_t sizeImpl();
         bool isEmptyImpl();
         // public stack interface end
 
+        bool popOwnValue(T &rValue);
+        size_t stealValues(T *pValues, size_t count);
+        size_t stealValuesFrom(int victimRank, T *pValues, size_t maxCount);
+
         void initRemoteAccessMemory(MPI_Comm comm, MPI_Info info);
+        [[nodiscard]] auto getDataBaseAddressGetter() const;
+        size_t peekValues(T *pValues, size_t maxCount);
+        [[nodiscard]] MPI_Aint getUserDataBaseAddress(int rank) const;
 
     private:
-        std::chrono::nanoseconds m_backoffMinDelay;
-        std::chrono::nanoseconds m_backoffMaxDelay;
+        // Состояние политики задержки сохраняется между операциями стека.
+        Backoff m_backoff;
 
-        ref_counting::InnerStack m_innerStack;
+        ref_counting::InnerStack<Layout> m_innerStack;
         int m_rank{-1};
         MPI_Win m_userDataWin{MPI_WIN_NULL};
+        ref_counting::IntraNodeWindow m_intraNodeUserDataWin;
         T* m_pUserDataArr{nullptr};
         std::unique_ptr<MPI_Aint[]> m_pUserDataBaseAddresses;
+        // Значения, забранные у другого процесса при InnerStackOptions::workStealing.
+        std::vector<T> m_stealBuffer;
+        std::mt19937 m_stealRandomEngine;
+        // Значение, на которое ссылается результат top.
+        T m_topValue{};
+
         std::shared_ptr<spdlog::logger> m_logger;
     };
 
-    template<typename T>
-    void RmaTreiberDecentralizedStack<T>::release()
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::release()
     {
         m_innerStack.release();
+        if (m_innerStack.hasInlinePayload())
+            return;
+
+        m_innerStack.getWindowSync().close(m_userDataWin);
+
+        // Память статического окна освобождается вместе с окном.
+        if (m_innerStack.hasStaticWindows())
+        {
+            MPI_Win_free(&m_userDataWin);
+            m_pUserDataArr = nullptr;
+            m_intraNodeUserDataWin.unmap();
+            RMA_STACK_TRACE(m_logger, "freed up data win RMA memory");
+            return;
+        }
 
         MPI_Free_mem(m_pUserDataArr);
         m_pUserDataArr = nullptr;
-        m_logger->trace("freed up data arr RMA memory");
+        RMA_STACK_TRACE(m_logger, "freed up data arr RMA memory");
 
         MPI_Win_free(&m_userDataWin);
-        m_logger->trace("freed up data win RMA memory");
+        RMA_STACK_TRACE(m_logger, "freed up data win RMA memory");
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    const ref_counting::InnerStackStatistics &RmaTreiberDecentralizedStack<T, Layout, Backoff>::getStatistics() const
+    {
+        return m_innerStack.getStatistics();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::reserveNodes(size_t maxCount)
+    {
+        return m_innerStack.reserveNodes(maxCount);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::releaseReservedNodes()
+    {
+        m_innerStack.releaseReservedNodes();
     }
 
-    template<typename T>
-    RmaTreiberDecentralizedStack<T>::RmaTreiberDecentralizedStack(MPI_Comm comm, MPI_Info info,
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::pushAsync(const T &rValue, RequestType &rRequest)
+    {
+        m_innerStack.pushInlineAsync(&rValue, rRequest);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::popAsync(T &rValue, const T &rDefaultValue, RequestType &rRequest)
+    {
+        m_innerStack.popInlineAsync(&rValue, &rDefaultValue, rRequest);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    RmaTreiberDecentralizedStack<T, Layout, Backoff>::RmaTreiberDecentralizedStack(MPI_Comm comm, MPI_Info info,
                                                                   const std::chrono::nanoseconds &t_rBackoffMinDelay,
                                                                   const std::chrono::nanoseconds &t_rBackoffMaxDelay,
-                                                                  ref_counting::InnerStack &&t_innerStack,
+                                                                  ref_counting::InnerStack<Layout> &&t_innerStack,
                                                                   std::shared_ptr<spdlog::logger> t_logger)
             :
-            m_backoffMinDelay(t_rBackoffMinDelay),
-            m_backoffMaxDelay(t_rBackoffMaxDelay),
+            m_backoff(t_rBackoffMinDelay, t_rBackoffMaxDelay),
             m_innerStack(std::move(t_innerStack)),
             m_logger(std::move(t_logger))
     {
         MPI_Comm_rank(comm, &m_rank);
+        m_innerStack.setFreeListBackoffDelays(t_rBackoffMinDelay, t_rBackoffMaxDelay);
+        m_stealRandomEngine.seed(static_cast<std::mt19937::result_type>(
+                std::chrono::steady_clock::now().time_since_epoch().count() + m_rank)
+        );
 
         initRemoteAccessMemory(comm, info);
     }
 
-    template<typename T>
-    void RmaTreiberDecentralizedStack<T>::pushImpl(const T &rValue)
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::pushImpl(const T &rValue)
     {
-        ExponentialBackoff backoff(m_backoffMinDelay, m_backoffMaxDelay);
-        m_innerStack.push([&rValue, &win = m_userDataWin, &pDataBaseAddresses = m_pUserDataBaseAddresses](
-                                  const ref_counting::GlobalAddress &dataAddress) {
+        tryPush(rValue);
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberDecentralizedStack<T, Layout, Backoff>::tryPush(const T &rValue)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            const auto isPushed = m_innerStack.pushInline(&rValue, [this] () {
+                m_backoff.backoff();
+            });
+            RMA_STACK_TRACE(m_logger, "finished 'push'");
+            return isPushed;
+        }
+        const auto isPushed = m_innerStack.push([&rValue, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, this](
+                                  const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                if (ref_counting::isGlobalAddressDummy(dataAddress))
+                    return;
+
                 constexpr auto valueSize = sizeof(rValue);
                 const auto offset = dataAddress.offset * valueSize;
-                const auto displacement = MPI_Aint_add(pDataBaseAddresses[dataAddress.rank], offset);
-                MPI_Win_lock(MPI_LOCK_SHARED, dataAddress.rank, MPI_MODE_NOCHECK, win);
-                MPI_Put(&rValue,
+                const auto displacement = MPI_Aint_add(getUserDataBaseAddress(dataAddress.rank), offset);
+                rWindowSync.lock(dataAddress.rank, win);
+                rIntraNodeWin.put(&rValue,
                       valueSize,
                       MPI_UNSIGNED_CHAR,
                       dataAddress.rank,
@@ -120,34 +243,82 @@ namespace rma_stack
                       MPI_UNSIGNED_CHAR,
                       win
                 );
-                MPI_Win_flush(dataAddress.rank, win);
-                MPI_Win_unlock(dataAddress.rank, win);
             },
-            [&backoff] () {
-                backoff.backoff();
+            // Запись завершается отдельным ожиданием после записи указателя на следующий узел, до CAS головы.
+            [&win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin](
+                    const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                rIntraNodeWin.flush(dataAddress.rank, win);
+                rWindowSync.unlock(dataAddress.rank, win);
+            },
+            [this] () {
+                m_backoff.backoff();
             }
         );
 
-        m_logger->trace("finished 'pushImpl'", m_rank);
+        RMA_STACK_TRACE(m_logger, "finished 'pushImpl'");
+        return isPushed;
     }
 
-    template<typename T>
-    void RmaTreiberDecentralizedStack<T>::popImpl(T &rValue, const T &rDefaultValue)
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::popImpl(T &rValue, const T &rDefaultValue)
     {
-        ExponentialBackoff backoff(m_backoffMinDelay, m_backoffMaxDelay);
-        m_innerStack.pop([&rValue, &rDefaultValue, &win = m_userDataWin, &pDataBaseAddresses = m_pUserDataBaseAddresses](
-                                 const ref_counting::GlobalAddress &dataAddress) {
+        if (!tryPop(rValue))
+            rValue = rDefaultValue;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberDecentralizedStack<T, Layout, Backoff>::tryPop(T &rValue)
+    {
+        if (popOwnValue(rValue))
+            return true;
+        return m_innerStack.hasWorkStealing() && stealValues(&rValue, 1) == 1;
+    }
+
+    // POP из стека процесса без кражи значений.
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberDecentralizedStack<T, Layout, Backoff>::popOwnValue(T &rValue)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            const auto isPopped = m_innerStack.popInline(&rValue, [this] () {
+                m_backoff.backoff();
+            });
+            RMA_STACK_TRACE(m_logger, "finished 'popImpl'");
+            return isPopped;
+        }
+        if (m_innerStack.hasPopPayloadPrefetch())
+        {
+            UserDataPrefetch<T> prefetch(m_userDataWin, m_innerStack.getWindowSync(), m_intraNodeUserDataWin);
+            const auto isPopped = m_innerStack.pop([&prefetch, this](const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                    prefetch.start(dataAddress.rank, MPI_Aint_add(getUserDataBaseAddress(dataAddress.rank), dataAddress.offset * sizeof(T)));
+                },
+                [&rValue, &prefetch](const ref_counting::GlobalAddress<Layout> &dataAddress) {
+                    if (ref_counting::isGlobalAddressDummy(dataAddress))
+                    {
+                        prefetch.discard();
+                        return;
+                    }
+                    prefetch.complete(rValue);
+                },
+                [this] () {
+                    m_backoff.backoff();
+                }
+            );
+            prefetch.discard();
+            RMA_STACK_TRACE(m_logger, "finished 'popImpl'");
+            return isPopped;
+        }
+        const auto isPopped = m_innerStack.pop([&rValue, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, this](
+                                 const ref_counting::GlobalAddress<Layout> &dataAddress) {
             if (ref_counting::isGlobalAddressDummy(dataAddress))
-            {
-                rValue = rDefaultValue;
                 return;
-            }
 
             constexpr auto valueSize = sizeof(rValue);
             const auto offset = dataAddress.offset * valueSize;
-            const auto displacement = MPI_Aint_add(pDataBaseAddresses[dataAddress.rank], offset);
-            MPI_Win_lock(MPI_LOCK_SHARED, dataAddress.rank, MPI_MODE_NOCHECK, win);
-            MPI_Get(&rValue,
+            const auto displacement = MPI_Aint_add(getUserDataBaseAddress(dataAddress.rank), offset);
+            rWindowSync.lock(dataAddress.rank, win);
+            rIntraNodeWin.get(&rValue,
                  valueSize,
                  MPI_UNSIGNED_CHAR,
                  dataAddress.rank,
@@ -156,37 +327,279 @@ namespace rma_stack
                  MPI_UNSIGNED_CHAR,
                  win
             );
-            MPI_Win_flush(dataAddress.rank, win);
-            MPI_Win_unlock(dataAddress.rank, win);
+            rIntraNodeWin.flush(dataAddress.rank, win);
+            rWindowSync.unlock(dataAddress.rank, win);
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+        RMA_STACK_TRACE(m_logger, "finished 'popImpl'");
+        return isPopped;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::pushNImpl(const T *pValues, size_t count)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            return m_innerStack.pushNInline(count, pValues, [this] () {
+                m_backoff.backoff();
+            });
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        const auto pushedCount = m_innerStack.pushN(count,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Put,
+                                      const_cast<T *>(pValues),
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+
+        RMA_STACK_TRACE(m_logger, "finished 'pushNImpl' ({} of {} values)", pushedCount, count);
+        return pushedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::popNImpl(T *pValues, size_t maxCount)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            auto poppedCount = m_innerStack.popNInline(maxCount, pValues, [this] () {
+                m_backoff.backoff();
+            });
+            if (m_innerStack.hasWorkStealing() && poppedCount < maxCount)
+                poppedCount += stealValues(pValues + poppedCount, maxCount - poppedCount);
+            return poppedCount;
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        auto poppedCount = m_innerStack.popN(maxCount,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Get,
+                                      pValues,
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+
+        if (m_innerStack.hasWorkStealing() && poppedCount < maxCount)
+            poppedCount += stealValues(pValues + poppedCount, maxCount - poppedCount);
+
+        RMA_STACK_TRACE(m_logger, "finished 'popNImpl' ({} of {} values)", poppedCount, maxCount);
+        return poppedCount;
+    }
+
+    /*
+     * Стек процесса пуст: процессы-жертвы перебираются, начиная со случайно выбранного,
+     * пока у одного из них не удастся забрать значения. Забирается до stealBatchSize значений,
+     * но значений сверх count - не больше, чем удалось зарезервировать узлов собственного пула:
+     * они добавляются в собственный стек в прежнем порядке на зарезервированных узлах, поэтому
+     * забранные значения всегда остаются в памяти стека, доступной остальным процессам.
+     * Возвращает кол-во значений, записанных в pValues, 0 - стеки всех процессов пусты.
+     */
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::stealValues(T *pValues, size_t count)
+    {
+        const auto procNum = m_innerStack.getProcNum();
+        if (procNum == 1)
+            return 0;
+
+        const auto batchSize = m_innerStack.getStealBatchSize();
+        const auto reservedCount = batchSize > count ? m_innerStack.reserveNodes(batchSize - count) : 0;
+        const auto stealCount = count + reservedCount;
+        m_stealBuffer.resize(stealCount);
+
+        size_t takenCount{0};
+        const auto firstVictimShift = std::uniform_int_distribution<int>(0, procNum - 2)(m_stealRandomEngine);
+        for (int i = 0; i < procNum - 1; ++i)
+        {
+            const auto victimRank = (m_rank + 1 + (firstVictimShift + i) % (procNum - 1)) % procNum;
+            const auto stolenCount = stealValuesFrom(victimRank, m_stealBuffer.data(), stealCount);
+            if (stolenCount == 0)
+                continue;
+
+            takenCount = std::min(stolenCount, count);
+            std::copy_n(m_stealBuffer.begin(), takenCount, pValues);
+            if (stolenCount > takenCount)
+            {
+                // Вершина забранной цепочки должна оказаться вершиной собственного стека.
+                std::reverse(m_stealBuffer.begin() + takenCount, m_stealBuffer.begin() + stolenCount);
+                pushNImpl(m_stealBuffer.data() + takenCount, stolenCount - takenCount);
+            }
+            RMA_STACK_TRACE(m_logger, "stole {} values from {}", stolenCount, victimRank);
+            break;
+        }
+        m_innerStack.releaseReservedNodes();
+        return takenCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::stealValuesFrom(int victimRank, T *pValues, size_t maxCount)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            return m_innerStack.stealNInline(victimRank, maxCount, pValues, [this] () {
+                m_backoff.backoff();
+            });
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        return m_innerStack.stealN(victimRank, maxCount,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Get,
+                                      pValues,
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
             },
-            [&backoff] () {
-                backoff.backoff();
+            [this] () {
+                m_backoff.backoff();
             }
         );
-        m_logger->trace("finished 'popImpl'",m_rank);
     }
 
-    template<typename T>
-    T &rma_stack::RmaTreiberDecentralizedStack<T>::topImpl() {
-        T v{};
-        return v;
+    template<typename T, typename Layout, typename Backoff>
+    auto RmaTreiberDecentralizedStack<T, Layout, Backoff>::getDataBaseAddressGetter() const
+    {
+        return [this](int rank) {
+            return getUserDataBaseAddress(rank);
+        };
     }
 
-    template<typename T>
-    size_t RmaTreiberDecentralizedStack<T>::sizeImpl()
+    // В статическом окне данные пользователя каждого процесса начинаются с нулевого смещения.
+    template<typename T, typename Layout, typename Backoff>
+    MPI_Aint RmaTreiberDecentralizedStack<T, Layout, Backoff>::getUserDataBaseAddress(int rank) const
     {
-        return 0;
+        return m_innerStack.hasStaticWindows() ? 0 : m_pUserDataBaseAddresses[rank];
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    T &rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>::topImpl() {
+        // Ссылка действительна до следующего вызова top, для пустого стека значение по умолчанию.
+        m_topValue = peek().value_or(T{});
+        return m_topValue;
     }
 
-    template<typename T>
-    bool RmaTreiberDecentralizedStack<T>::isEmptyImpl()
+    template<typename T, typename Layout, typename Backoff>
+    std::optional<T> RmaTreiberDecentralizedStack<T, Layout, Backoff>::peek()
     {
-        return true;
+        T value{};
+        if (peekValues(&value, 1) == 0)
+            return std::nullopt;
+        return value;
     }
 
-    template<typename T>
-    void RmaTreiberDecentralizedStack<T>::initRemoteAccessMemory(MPI_Comm comm, MPI_Info info)
+    template<typename T, typename Layout, typename Backoff>
+    std::vector<T> RmaTreiberDecentralizedStack<T, Layout, Backoff>::peekTopK(size_t k)
     {
+        std::vector<T> values(k);
+        values.resize(peekValues(values.data(), k));
+        return values;
+    }
+
+    // Данные узлов цепочки читаются одной пакетной операцией на каждый процесс-владелец.
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::peekValues(T *pValues, size_t maxCount)
+    {
+        m_backoff.reset(m_innerStack.sampleContentionLevel());
+        if (m_innerStack.hasInlinePayload())
+        {
+            return m_innerStack.peekNInline(maxCount, pValues, [this] () {
+                m_backoff.backoff();
+            });
+        }
+        const auto getDataBaseAddress = getDataBaseAddressGetter();
+        const auto peekedCount = m_innerStack.peekN(maxCount,
+            [pValues, &win = m_userDataWin, &rWindowSync = m_innerStack.getWindowSync(), &rIntraNodeWin = m_intraNodeUserDataWin, &getDataBaseAddress](const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t dataCount) {
+                transferUserDataBatch(UserDataTransfer::Get,
+                                      pValues,
+                                      sizeof(T),
+                                      pDataAddresses,
+                                      dataCount,
+                                      getDataBaseAddress,
+                                      win,
+                                      rWindowSync,
+                                      rIntraNodeWin
+                );
+            },
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+
+        RMA_STACK_TRACE(m_logger, "finished 'peekValues' ({} of {} values)", peekedCount, maxCount);
+        return peekedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberDecentralizedStack<T, Layout, Backoff>::sizeImpl()
+    {
+        return m_innerStack.getSize(
+            [this] () {
+                m_backoff.backoff();
+            }
+        );
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberDecentralizedStack<T, Layout, Backoff>::isEmptyImpl()
+    {
+        return m_innerStack.isEmpty();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberDecentralizedStack<T, Layout, Backoff>::initRemoteAccessMemory(MPI_Comm comm, MPI_Info info)
+    {
+        // Данные пользователя хранятся в узлах внутреннего стека, окно данных не нужно.
+        if (m_innerStack.hasInlinePayload())
+            return;
+
+        if (m_innerStack.hasStaticWindows())
+        {
+            const auto elemsUpLimit = m_innerStack.getElemsUpLimit();
+            const auto userDataSize = static_cast<MPI_Aint>(sizeof(T) * elemsUpLimit);
+            if (m_innerStack.hasIntraNodeSharedMemory())
+            {
+                m_intraNodeUserDataWin.allocate(userDataSize, info, comm, &m_pUserDataArr, &m_userDataWin);
+            }
+            else
+            {
+                auto mpiStatus = MPI_Win_allocate(userDataSize, 1, info, comm, &m_pUserDataArr, &m_userDataWin);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to allocate RMA window for user data", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+            std::fill_n(m_pUserDataArr, elemsUpLimit, T());
+
+            m_innerStack.getWindowSync().open(m_userDataWin);
+            return;
+        }
+
         {
             auto mpiStatus = MPI_Win_create_dynamic(info, comm, &m_userDataWin);
             if (mpiStatus != MPI_SUCCESS)
@@ -224,25 +637,35 @@ namespace rma_stack
             if (mpiStatus != MPI_SUCCESS)
                 throw custom_mpi::MpiException("failed to broadcast data array base address", __FILE__, __func__ , __LINE__, mpiStatus);
         }
+
+        m_innerStack.getWindowSync().open(m_userDataWin);
     }
 
-    template<typename T>
-    RmaTreiberDecentralizedStack<T> RmaTreiberDecentralizedStack<T>::create(MPI_Comm comm, MPI_Info info,
+    template<typename T, typename Layout, typename Backoff>
+    RmaTreiberDecentralizedStack<T, Layout, Backoff> RmaTreiberDecentralizedStack<T, Layout, Backoff>::create(MPI_Comm comm, MPI_Info info,
                                                                 const std::chrono::nanoseconds &t_rBackoffMinDelay,
                                                                 const std::chrono::nanoseconds &t_rBackoffMaxDelay,
                                                                 int elemsUpLimit,
-                                                                std::shared_ptr<spdlog::sinks::sink> loggerSink) {
+                                                                std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                                                                const ref_counting::InnerStackOptions &innerStackOptions) {
+        ref_counting::InnerStack<Layout>::checkCommSize(comm);
+        if (innerStackOptions.inlinePayload
+            && !(std::is_trivially_copyable_v<T> && sizeof(T) <= ref_counting::MaxInlinePayloadSize))
+            throw std::invalid_argument("the inline payload requires a small trivially copyable value type");
+
         auto pInnerStackLogger = std::make_shared<spdlog::logger>("InnerStack", loggerSink);
         spdlog::register_logger(pInnerStackLogger);
         pInnerStackLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
         pInnerStackLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
 
-        ref_counting::InnerStack innerStack(
+        ref_counting::InnerStack<Layout> innerStack(
                 comm,
                 info,
                 false,
                 elemsUpLimit,
-                std::move(pInnerStackLogger)
+                std::move(pInnerStackLogger),
+                innerStackOptions,
+                sizeof(T)
         );
 
         auto pOuterStackLogger = std::make_shared<spdlog::logger>("RmaTreiberDecentralizedStack", loggerSink);
@@ -250,7 +673,7 @@ namespace rma_stack
         pOuterStackLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
         pOuterStackLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
 
-        RmaTreiberDecentralizedStack<T> stack(
+        RmaTreiberDecentralizedStack<T, Layout, Backoff> stack(
                 comm,
                 info,
                 t_rBackoffMinDelay,
@@ -260,7 +683,7 @@ namespace rma_stack
         );
 
         MPI_Barrier(comm);
-        stack.m_logger->trace("finished RmaTreiberDecentralizedStack construction");
+        RMA_STACK_TRACE(stack.m_logger, "finished RmaTreiberDecentralizedStack construction");
         return stack;
     }
 } // rma_stack
@@ -268,31 +691,39 @@ namespace rma_stack
 
 namespace stack_interface
 {
-    template<typename T>
-    struct IStack_traits<rma_stack::RmaTreiberDecentralizedStack < T>>
+    template<typename T, typename Layout, typename Backoff>
+    struct IStack_traits<rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>>
     {
-        friend class IStack<rma_stack::RmaTreiberDecentralizedStack < T>>;
-        friend class rma_stack::RmaTreiberDecentralizedStack<T>;
+        friend class IStack<rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>>;
+        friend class rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>;
         typedef T ValueType;
 
     private:
-        static void pushImpl(rma_stack::RmaTreiberDecentralizedStack<T>& stack, const T &value)
+        static void pushImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack, const T &value)
         {
             stack.pushImpl(value);
         }
-        static void popImpl(rma_stack::RmaTreiberDecentralizedStack<T>& stack, ValueType &rValue, const ValueType &rDefaultValue)
+        static void popImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack, ValueType &rValue, const ValueType &rDefaultValue)
         {
             stack.popImpl(rValue, rDefaultValue);
         }
-        static ValueType& topImpl(rma_stack::RmaTreiberDecentralizedStack<T>& stack)
+        static size_t pushNImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack, const ValueType *pValues, size_t count)
+        {
+            return stack.pushNImpl(pValues, count);
+        }
+        static size_t popNImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack, ValueType *pValues, size_t maxCount)
+        {
+            return stack.popNImpl(pValues, maxCount);
+        }
+        static ValueType& topImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack)
         {
             return stack.topImpl();
         }
-        static size_t sizeImpl(rma_stack::RmaTreiberDecentralizedStack<T>& stack)
+        static size_t sizeImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack)
         {
             return stack.sizeImpl();
         }
-        static bool isEmptyImpl(rma_stack::RmaTreiberDecentralizedStack<T>& stack)
+        static bool isEmptyImpl(rma_stack::RmaTreiberDecentralizedStack<T, Layout, Backoff>& stack)
         {
             return stack.isEmptyImpl();
         }
@@ -0,0 +1,415 @@
+#ifndef SOURCES_RMATREIBERHIERARCHICALSTACK_H
+#define SOURCES_RMATREIBERHIERARCHICALSTACK_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "IStack.h"
+
+#include "outer/RmaTreiberCentralStack.h"
+#include "outer/RmaTreiberDecentralizedStack.h"
+#include "inner/InnerStack.h"
+#include "inner/TraceLogging.h"
+#include "MpiException.h"
+
+namespace rma_stack
+{
+    namespace custom_mpi = custom_mpi_extensions;
+
+    // Кол-во значений, переносимых между уровнями стека за одну операцию по умолчанию.
+    constexpr size_t DefaultTransferBatchSize = 64;
+
+    /*
+     * Двухуровневый стек. Процессы одного вычислительного узла (MPI_Comm_split_type)
+     * работают с локальным централизованным стеком, голова которого расположена на первом
+     * процессе узла. Глобальный децентрализованный стек общий для всех процессов:
+     * при переполнении локального стека в него переносится пачка значений с вершины
+     * локального стека, а при опустошении локального стека пачка значений забирается из него.
+     * Порядок LIFO соблюдается в пределах узла, между узлами порядок ослаблен.
+     */
+    template<typename T, typename Layout = ref_counting::DefaultLayout, typename Backoff = ExponentialBackoff>
+    class RmaTreiberHierarchicalStack: public stack_interface::IStack<RmaTreiberHierarchicalStack<T, Layout, Backoff>>
+    {
+        friend class stack_interface::IStack_traits<rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>>;
+    public:
+        typedef typename stack_interface::IStack_traits<RmaTreiberHierarchicalStack>::ValueType ValueType;
+
+        explicit RmaTreiberHierarchicalStack(MPI_Comm t_nodeComm,
+                                             RmaTreiberCentralStack<T, Layout, Backoff> &&t_nodeStack,
+                                             RmaTreiberDecentralizedStack<T, Layout, Backoff> &&t_globalStack,
+                                             size_t t_transferBatchSize,
+                                             std::shared_ptr<spdlog::logger> t_logger);
+        /*
+         * elemsUpLimit - кол-во узлов, которое каждый процесс выделяет на каждом уровне стека.
+         * Параметры innerStackOptions применяются к обоим уровням, кроме workStealing и elasticNodePool:
+         * они требуют децентрализованного стека и действуют только на глобальный стек.
+         */
+        static RmaTreiberHierarchicalStack<T, Layout, Backoff> create(
+                MPI_Comm comm,
+                MPI_Info info,
+                const std::chrono::nanoseconds &t_rBackoffMinDelay,
+                const std::chrono::nanoseconds &t_rBackoffMaxDelay,
+                int elemsUpLimit,
+                std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                const ref_counting::InnerStackOptions &innerStackOptions = {},
+                size_t transferBatchSize = DefaultTransferBatchSize
+        );
+
+        RmaTreiberHierarchicalStack(RmaTreiberHierarchicalStack&) = delete;
+        RmaTreiberHierarchicalStack(RmaTreiberHierarchicalStack&&)  noexcept = default;
+        RmaTreiberHierarchicalStack& operator=(RmaTreiberHierarchicalStack&) = delete;
+        RmaTreiberHierarchicalStack& operator=(RmaTreiberHierarchicalStack&&)  noexcept = default;
+        ~RmaTreiberHierarchicalStack() = default;
+
+        void release();
+        // Суммарные счётчики обоих уровней стека.
+        [[nodiscard]] const ref_counting::InnerStackStatistics &getStatistics() const;
+        // Значение на вершине локального стека, а если он пуст - на вершине глобального стека.
+        [[nodiscard]] std::optional<T> peek();
+
+    private:
+        // public stack interface begin
+        void pushImpl(const T &rValue);
+        void popImpl(T &rValue, const T &rDefaultValue);
+        size_t pushNImpl(const T *pValues, size_t count);
+        size_t popNImpl(T *pValues, size_t maxCount);
+        T& topImpl();
+        size_t sizeImpl();
+        bool isEmptyImpl();
+        // public stack interface end
+
+        void spillToGlobalStack();
+        size_t refillFromGlobalStack(T *pValues, size_t maxCount);
+
+        static std::shared_ptr<spdlog::logger> makeLogger(const std::string &name,
+                                                          std::shared_ptr<spdlog::sinks::sink> loggerSink);
+
+    private:
+        MPI_Comm m_nodeComm{MPI_COMM_NULL};
+        RmaTreiberCentralStack<T, Layout, Backoff> m_nodeStack;
+        RmaTreiberDecentralizedStack<T, Layout, Backoff> m_globalStack;
+        size_t m_transferBatchSize;
+        std::vector<T> m_transferBuffer;
+        // Значение, на которое ссылается результат top.
+        T m_topValue{};
+        mutable ref_counting::InnerStackStatistics m_statistics;
+        std::shared_ptr<spdlog::logger> m_logger;
+    };
+
+    template<typename T, typename Layout, typename Backoff>
+    RmaTreiberHierarchicalStack<T, Layout, Backoff>::RmaTreiberHierarchicalStack(MPI_Comm t_nodeComm,
+                                                                RmaTreiberCentralStack<T, Layout, Backoff> &&t_nodeStack,
+                                                                RmaTreiberDecentralizedStack<T, Layout, Backoff> &&t_globalStack,
+                                                                size_t t_transferBatchSize,
+                                                                std::shared_ptr<spdlog::logger> t_logger)
+            :
+            m_nodeComm(t_nodeComm),
+            m_nodeStack(std::move(t_nodeStack)),
+            m_globalStack(std::move(t_globalStack)),
+            m_transferBatchSize(t_transferBatchSize),
+            m_transferBuffer(t_transferBatchSize),
+            m_logger(std::move(t_logger))
+    {
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberHierarchicalStack<T, Layout, Backoff>::release()
+    {
+        m_nodeStack.release();
+        m_globalStack.release();
+        MPI_Comm_free(&m_nodeComm);
+        RMA_STACK_TRACE(m_logger, "freed up node communicator");
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    const ref_counting::InnerStackStatistics &RmaTreiberHierarchicalStack<T, Layout, Backoff>::getStatistics() const
+    {
+        const auto &rNodeStatistics = m_nodeStack.getStatistics();
+        const auto &rGlobalStatistics = m_globalStack.getStatistics();
+        m_statistics.eliminationAttemptsNum = rNodeStatistics.eliminationAttemptsNum + rGlobalStatistics.eliminationAttemptsNum;
+        m_statistics.eliminationHitsNum = rNodeStatistics.eliminationHitsNum + rGlobalStatistics.eliminationHitsNum;
+        m_statistics.stealAttemptsNum = rNodeStatistics.stealAttemptsNum + rGlobalStatistics.stealAttemptsNum;
+        m_statistics.stealHitsNum = rNodeStatistics.stealHitsNum + rGlobalStatistics.stealHitsNum;
+        m_statistics.stolenValuesNum = rNodeStatistics.stolenValuesNum + rGlobalStatistics.stolenValuesNum;
+        m_statistics.nodeSegmentGrowthsNum = rNodeStatistics.nodeSegmentGrowthsNum + rGlobalStatistics.nodeSegmentGrowthsNum;
+        m_statistics.nodeSegmentShrinksNum = rNodeStatistics.nodeSegmentShrinksNum + rGlobalStatistics.nodeSegmentShrinksNum;
+        m_statistics.headCasFailuresNum = rNodeStatistics.headCasFailuresNum + rGlobalStatistics.headCasFailuresNum;
+        m_statistics.pushesNum = rNodeStatistics.pushesNum + rGlobalStatistics.pushesNum;
+        m_statistics.pushRoundTripsNum = rNodeStatistics.pushRoundTripsNum + rGlobalStatistics.pushRoundTripsNum;
+        return m_statistics;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberHierarchicalStack<T, Layout, Backoff>::pushImpl(const T &rValue)
+    {
+        if (m_nodeStack.tryPush(rValue))
+            return;
+
+        spillToGlobalStack();
+        if (m_nodeStack.tryPush(rValue))
+            return;
+
+        // Локальный стек заполняют другие процессы узла быстрее, чем он освобождается.
+        m_globalStack.tryPush(rValue);
+        RMA_STACK_TRACE(m_logger, "finished 'pushImpl' on global stack");
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberHierarchicalStack<T, Layout, Backoff>::popImpl(T &rValue, const T &rDefaultValue)
+    {
+        if (m_nodeStack.tryPop(rValue))
+            return;
+
+        if (refillFromGlobalStack(&rValue, 1) == 0)
+            rValue = rDefaultValue;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberHierarchicalStack<T, Layout, Backoff>::pushNImpl(const T *pValues, size_t count)
+    {
+        auto pushedCount = m_nodeStack.pushN(pValues, count);
+        if (pushedCount == count)
+            return pushedCount;
+
+        spillToGlobalStack();
+        pushedCount += m_nodeStack.pushN(pValues + pushedCount, count - pushedCount);
+        if (pushedCount < count)
+            pushedCount += m_globalStack.pushN(pValues + pushedCount, count - pushedCount);
+
+        RMA_STACK_TRACE(m_logger, "finished 'pushNImpl' ({} of {} values)", pushedCount, count);
+        return pushedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberHierarchicalStack<T, Layout, Backoff>::popNImpl(T *pValues, size_t maxCount)
+    {
+        auto poppedCount = m_nodeStack.popN(pValues, maxCount);
+        if (poppedCount < maxCount)
+            poppedCount += refillFromGlobalStack(pValues + poppedCount, maxCount - poppedCount);
+
+        RMA_STACK_TRACE(m_logger, "finished 'popNImpl' ({} of {} values)", poppedCount, maxCount);
+        return poppedCount;
+    }
+
+    /*
+     * Пачка значений с вершины локального стека переносится в глобальный стек с сохранением порядка.
+     * Из локального стека забирается не больше значений, чем удалось зарезервировать узлов
+     * глобального стека, поэтому извлечённые значения всегда помещаются в глобальный стек.
+     */
+    template<typename T, typename Layout, typename Backoff>
+    void RmaTreiberHierarchicalStack<T, Layout, Backoff>::spillToGlobalStack()
+    {
+        const auto reservedCount = m_globalStack.reserveNodes(m_transferBatchSize);
+        const auto poppedCount = m_nodeStack.popN(m_transferBuffer.data(), reservedCount);
+        if (poppedCount > 0)
+        {
+            // popN возвращает значения начиная с вершины, а pushN делает вершиной последнее значение.
+            std::reverse(m_transferBuffer.begin(), m_transferBuffer.begin() + poppedCount);
+            m_globalStack.pushN(m_transferBuffer.data(), poppedCount);
+        }
+        m_globalStack.releaseReservedNodes();
+
+        RMA_STACK_TRACE(m_logger, "spilled {} values to global stack", poppedCount);
+    }
+
+    /*
+     * Из глобального стека забирается пачка значений: первые maxCount значений возвращаются
+     * вызывающему, остальные добавляются в локальный стек. Значений сверх maxCount забирается
+     * не больше, чем удалось зарезервировать узлов локального стека, поэтому все они в него помещаются.
+     * Возвращает кол-во значений в pValues.
+     */
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberHierarchicalStack<T, Layout, Backoff>::refillFromGlobalStack(T *pValues, size_t maxCount)
+    {
+        const auto reservedCount = m_transferBatchSize > maxCount
+                                   ? m_nodeStack.reserveNodes(m_transferBatchSize - maxCount)
+                                   : 0;
+        const auto batchSize = maxCount + reservedCount;
+        if (m_transferBuffer.size() < batchSize)
+            m_transferBuffer.resize(batchSize);
+
+        const auto poppedCount = m_globalStack.popN(m_transferBuffer.data(), batchSize);
+        const auto returnedCount = std::min(poppedCount, maxCount);
+        std::copy_n(m_transferBuffer.begin(), returnedCount, pValues);
+        if (poppedCount > returnedCount)
+        {
+            const auto restBegin = m_transferBuffer.begin() + returnedCount;
+            const auto restEnd = m_transferBuffer.begin() + poppedCount;
+            std::reverse(restBegin, restEnd);
+            m_nodeStack.pushN(&*restBegin, poppedCount - returnedCount);
+        }
+        m_nodeStack.releaseReservedNodes();
+
+        RMA_STACK_TRACE(m_logger, "refilled {} values from global stack", poppedCount - returnedCount);
+        return returnedCount;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    T &rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>::topImpl() {
+        // Ссылка действительна до следующего вызова top, для пустого стека значение по умолчанию.
+        m_topValue = peek().value_or(T{});
+        return m_topValue;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    std::optional<T> RmaTreiberHierarchicalStack<T, Layout, Backoff>::peek()
+    {
+        if (auto value = m_nodeStack.peek())
+            return value;
+        return m_globalStack.peek();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    size_t RmaTreiberHierarchicalStack<T, Layout, Backoff>::sizeImpl()
+    {
+        return m_nodeStack.size() + m_globalStack.size();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    bool RmaTreiberHierarchicalStack<T, Layout, Backoff>::isEmptyImpl()
+    {
+        return m_nodeStack.isEmpty() && m_globalStack.isEmpty();
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    std::shared_ptr<spdlog::logger> RmaTreiberHierarchicalStack<T, Layout, Backoff>::makeLogger(const std::string &name,
+                                                                               std::shared_ptr<spdlog::sinks::sink> loggerSink)
+    {
+        auto pLogger = std::make_shared<spdlog::logger>(name, std::move(loggerSink));
+        spdlog::register_logger(pLogger);
+        pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+        pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+        return pLogger;
+    }
+
+    template<typename T, typename Layout, typename Backoff>
+    RmaTreiberHierarchicalStack<T, Layout, Backoff> RmaTreiberHierarchicalStack<T, Layout, Backoff>::create(MPI_Comm comm, MPI_Info info,
+                                                                const std::chrono::nanoseconds &t_rBackoffMinDelay,
+                                                                const std::chrono::nanoseconds &t_rBackoffMaxDelay,
+                                                                int elemsUpLimit,
+                                                                std::shared_ptr<spdlog::sinks::sink> loggerSink,
+                                                                const ref_counting::InnerStackOptions &innerStackOptions,
+                                                                size_t transferBatchSize) {
+        ref_counting::InnerStack<Layout>::checkCommSize(comm);
+        if (innerStackOptions.inlinePayload
+            && !(std::is_trivially_copyable_v<T> && sizeof(T) <= ref_counting::MaxInlinePayloadSize))
+            throw std::invalid_argument("the inline payload requires a small trivially copyable value type");
+        if (transferBatchSize == 0)
+            throw std::invalid_argument("the transfer batch size must be positive");
+
+        int rank{-1};
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm nodeComm{MPI_COMM_NULL};
+        {
+            auto mpiStatus = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, info, &nodeComm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to split communicator by node", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        int nodeProcNum{0};
+        MPI_Comm_size(nodeComm, &nodeProcNum);
+
+        /*
+         * Все узлы локального стека расположены на первом процессе узла, поэтому кража
+         * и растущий пул узлов применяются только к общему стеку.
+         */
+        auto nodeInnerStackOptions = innerStackOptions;
+        nodeInnerStackOptions.workStealing = false;
+        nodeInnerStackOptions.elasticNodePool = false;
+        ref_counting::InnerStack<Layout> nodeInnerStack(
+                nodeComm,
+                info,
+                true,
+                static_cast<size_t>(elemsUpLimit) * nodeProcNum,
+                makeLogger("NodeInnerStack", loggerSink),
+                nodeInnerStackOptions,
+                sizeof(T)
+        );
+        RmaTreiberCentralStack<T, Layout, Backoff> nodeStack(
+                nodeComm,
+                info,
+                t_rBackoffMinDelay,
+                t_rBackoffMaxDelay,
+                std::move(nodeInnerStack),
+                makeLogger("NodeRmaTreiberCentralStack", loggerSink)
+        );
+
+        ref_counting::InnerStack<Layout> globalInnerStack(
+                comm,
+                info,
+                false,
+                elemsUpLimit,
+                makeLogger("GlobalInnerStack", loggerSink),
+                innerStackOptions,
+                sizeof(T)
+        );
+        RmaTreiberDecentralizedStack<T, Layout, Backoff> globalStack(
+                comm,
+                info,
+                t_rBackoffMinDelay,
+                t_rBackoffMaxDelay,
+                std::move(globalInnerStack),
+                makeLogger("GlobalRmaTreiberDecentralizedStack", loggerSink)
+        );
+
+        RmaTreiberHierarchicalStack<T, Layout, Backoff> stack(
+                nodeComm,
+                std::move(nodeStack),
+                std::move(globalStack),
+                transferBatchSize,
+                makeLogger("RmaTreiberHierarchicalStack", loggerSink)
+        );
+
+        MPI_Barrier(comm);
+        RMA_STACK_TRACE(stack.m_logger, "finished RmaTreiberHierarchicalStack construction");
+        return stack;
+    }
+} // rma_stack
+
+
+namespace stack_interface
+{
+    template<typename T, typename Layout, typename Backoff>
+    struct IStack_traits<rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>>
+    {
+        friend class IStack<rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>>;
+        friend class rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>;
+        typedef T ValueType;
+
+    private:
+        static void pushImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack, const T &value)
+        {
+            stack.pushImpl(value);
+        }
+        static void popImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack, ValueType &rValue, const ValueType &rDefaultValue)
+        {
+            stack.popImpl(rValue, rDefaultValue);
+        }
+        static size_t pushNImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack, const ValueType *pValues, size_t count)
+        {
+            return stack.pushNImpl(pValues, count);
+        }
+        static size_t popNImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack, ValueType *pValues, size_t maxCount)
+        {
+            return stack.popNImpl(pValues, maxCount);
+        }
+        static ValueType& topImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack)
+        {
+            return stack.topImpl();
+        }
+        static size_t sizeImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack)
+        {
+            return stack.sizeImpl();
+        }
+        static bool isEmptyImpl(rma_stack::RmaTreiberHierarchicalStack<T, Layout, Backoff>& stack)
+        {
+            return stack.isEmptyImpl();
+        }
+    };
+}
+#endif //SOURCES_RMATREIBERHIERARCHICALSTACK_H
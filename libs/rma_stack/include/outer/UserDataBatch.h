@@ -0,0 +1,126 @@
+#ifndef SOURCES_USERDATABATCH_H
+#define SOURCES_USERDATABATCH_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "inner/ref_counting.h"
+#include "inner/RmaWindowSync.h"
+#include "inner/IntraNodeWindow.h"
+#include "MpiException.h"
+
+namespace rma_stack
+{
+    namespace custom_mpi = custom_mpi_extensions;
+
+    enum class UserDataTransfer
+    {
+        Put,
+        Get
+    };
+
+    /*
+     * Пакетный обмен пользовательскими данными узлов. Для каждого процесса-владельца
+     * выполняется одна операция MPI_Put или MPI_Get с индексными типами данных, которые
+     * описывают положение значений в локальном буфере pValues и в массиве пользовательских
+     * данных процесса. Значение i соответствует узлу pDataAddresses[i].
+     * Значения процессов, память которых отображена в rIntraNodeWin, копируются напрямую.
+     * getDataBaseAddress возвращает адрес массива пользовательских данных процесса по его номеру.
+     */
+    template<typename Layout, typename DataBaseAddressGetter>
+    void transferUserDataBatch(UserDataTransfer transfer, void *pValues, size_t valueSize,
+                               const ref_counting::GlobalAddress<Layout> *pDataAddresses, size_t count,
+                               const DataBaseAddressGetter &getDataBaseAddress, MPI_Win win,
+                               const ref_counting::RmaWindowSync &rWindowSync,
+                               const ref_counting::IntraNodeWindow &rIntraNodeWin)
+    {
+        if (count == 0)
+            return;
+
+        // Группировка значений по процессам-владельцам с сохранением порядка внутри группы.
+        std::vector<size_t> valueIndices(count);
+        std::iota(valueIndices.begin(), valueIndices.end(), 0);
+        std::stable_sort(valueIndices.begin(), valueIndices.end(), [pDataAddresses](size_t lhs, size_t rhs) {
+            return pDataAddresses[lhs].rank < pDataAddresses[rhs].rank;
+        });
+
+        const auto blockLength = static_cast<int>(valueSize);
+        // Смещения в байтах хранятся в MPI_Aint: при большом числе узлов и размере значения
+        // смещение в массиве пользовательских данных превышает диапазон int.
+        std::vector<MPI_Aint> originDisplacements;
+        std::vector<MPI_Aint> targetDisplacements;
+        originDisplacements.reserve(count);
+        targetDisplacements.reserve(count);
+
+        for (size_t beginIdx = 0; beginIdx < count;)
+        {
+            const auto rank = static_cast<int>(pDataAddresses[valueIndices[beginIdx]].rank);
+
+            originDisplacements.clear();
+            targetDisplacements.clear();
+            size_t endIdx = beginIdx;
+            for (; endIdx < count && pDataAddresses[valueIndices[endIdx]].rank == static_cast<uint64_t>(rank); ++endIdx)
+            {
+                const auto valueIdx = valueIndices[endIdx];
+                originDisplacements.push_back(static_cast<MPI_Aint>(valueIdx * valueSize));
+                targetDisplacements.push_back(static_cast<MPI_Aint>(pDataAddresses[valueIdx].offset * valueSize));
+            }
+            const auto blocksNum = static_cast<int>(endIdx - beginIdx);
+
+            if (rIntraNodeWin.isMapped(rank))
+            {
+                auto pValueBytes = static_cast<unsigned char*>(pValues);
+                const auto dataBaseAddress = getDataBaseAddress(rank);
+                for (int i = 0; i < blocksNum; ++i)
+                {
+                    auto pTarget = rIntraNodeWin.getAddress(rank, MPI_Aint_add(dataBaseAddress, targetDisplacements[i]));
+                    if (transfer == UserDataTransfer::Put)
+                        std::memcpy(pTarget, pValueBytes + originDisplacements[i], valueSize);
+                    else
+                        std::memcpy(pValueBytes + originDisplacements[i], pTarget, valueSize);
+                }
+                rIntraNodeWin.flush(rank, win);
+
+                beginIdx = endIdx;
+                continue;
+            }
+
+            MPI_Datatype originType{MPI_DATATYPE_NULL};
+            MPI_Datatype targetType{MPI_DATATYPE_NULL};
+            {
+                auto mpiStatus = MPI_Type_create_hindexed_block(blocksNum, blockLength, originDisplacements.data(),
+                                                                MPI_UNSIGNED_CHAR, &originType);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to create origin datatype", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+            {
+                auto mpiStatus = MPI_Type_create_hindexed_block(blocksNum, blockLength, targetDisplacements.data(),
+                                                                MPI_UNSIGNED_CHAR, &targetType);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to create target datatype", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+            MPI_Type_commit(&originType);
+            MPI_Type_commit(&targetType);
+
+            const auto dataBaseAddress = getDataBaseAddress(rank);
+            rWindowSync.lock(rank, win);
+            if (transfer == UserDataTransfer::Put)
+                MPI_Put(pValues, 1, originType, rank, dataBaseAddress, 1, targetType, win);
+            else
+                MPI_Get(pValues, 1, originType, rank, dataBaseAddress, 1, targetType, win);
+            MPI_Win_flush(rank, win);
+            rWindowSync.unlock(rank, win);
+
+            MPI_Type_free(&originType);
+            MPI_Type_free(&targetType);
+
+            beginIdx = endIdx;
+        }
+    }
+} // rma_stack
+
+#endif //SOURCES_USERDATABATCH_H
@@ -0,0 +1,90 @@
+#ifndef SOURCES_USERDATAPREFETCH_H
+#define SOURCES_USERDATAPREFETCH_H
+
+#include <mpi.h>
+#include <cstring>
+
+#include "inner/RmaWindowSync.h"
+#include "inner/IntraNodeWindow.h"
+
+namespace rma_stack
+{
+    /*
+     * Упреждающее чтение значения узла-кандидата операции POP (InnerStackOptions::prefetchPopPayload).
+     * Чтение начинается запросом MPI_Rget и завершается MPI_Wait, поэтому оно выполняется одновременно
+     * с чтением указателя на следующий узел и CAS головы. Одновременно выполняется не более одного
+     * чтения: начало следующего чтения отбрасывает предыдущее.
+     */
+    template<typename T>
+    class UserDataPrefetch
+    {
+    public:
+        UserDataPrefetch(MPI_Win t_win, const ref_counting::RmaWindowSync &t_rWindowSync,
+                         const ref_counting::IntraNodeWindow &t_rIntraNodeWin)
+        :
+        m_win(t_win),
+        m_rWindowSync(t_rWindowSync),
+        m_rIntraNodeWin(t_rIntraNodeWin)
+        {}
+
+        UserDataPrefetch(const UserDataPrefetch &) = delete;
+        UserDataPrefetch &operator=(const UserDataPrefetch &) = delete;
+
+        // Начало чтения значения из памяти процесса rank по смещению displacement окна.
+        void start(int rank, MPI_Aint displacement)
+        {
+            discard();
+
+            constexpr auto valueSize = static_cast<int>(sizeof(T));
+            m_rWindowSync.lock(rank, m_win);
+            m_rIntraNodeWin.rget(m_valueBytes,
+                                 valueSize,
+                                 MPI_UNSIGNED_CHAR,
+                                 rank,
+                                 displacement,
+                                 valueSize,
+                                 MPI_UNSIGNED_CHAR,
+                                 m_win,
+                                 &m_request
+            );
+            m_rank = rank;
+        }
+
+        // Завершение последнего начатого чтения и копирование значения в rValue.
+        void complete(T &rValue)
+        {
+            if (m_rank < 0)
+                return;
+
+            finish();
+            std::memcpy(&rValue, m_valueBytes, sizeof(T));
+        }
+
+        // Завершение чтения без использования значения.
+        void discard()
+        {
+            if (m_rank < 0)
+                return;
+
+            finish();
+        }
+
+    private:
+        void finish()
+        {
+            MPI_Wait(&m_request, MPI_STATUS_IGNORE);
+            m_rWindowSync.unlock(m_rank, m_win);
+            m_rank = -1;
+        }
+
+        MPI_Win m_win;
+        const ref_counting::RmaWindowSync &m_rWindowSync;
+        const ref_counting::IntraNodeWindow &m_rIntraNodeWin;
+
+        alignas(T) unsigned char m_valueBytes[sizeof(T)]{};
+        MPI_Request m_request{MPI_REQUEST_NULL};
+        int m_rank{-1};
+    };
+} // rma_stack
+
+#endif //SOURCES_USERDATAPREFETCH_H
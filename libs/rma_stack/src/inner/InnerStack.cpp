@@ -2,410 +2,2137 @@
 // Created by denis on 20.04.23.
 //
 
-#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <numeric>
+
 #include "inner/InnerStack.h"
 #include "MpiException.h"
 
-namespace rma_stack::ref_counting
-{
-    namespace custom_mpi = custom_mpi_extensions;
+namespace rma_stack::ref_counting
+{
+    namespace custom_mpi = custom_mpi_extensions;
+
+    template<typename Layout>
+    size_t InnerStack<Layout>::reserveNodes(size_t maxCount)
+    {
+        releaseReservedNodes();
+        if (maxCount == 0)
+            return 0;
+
+        // acquireNodesBatch сначала берёт зарезервированные узлы, поэтому узлы захватываются в буфер пакетных операций.
+        const int rank = getNodePoolRank();
+        m_batchNodeAddresses.resize(maxCount);
+        GlobalAddress *pNodeAddresses = m_batchNodeAddresses.data();
+        auto reservedCount = acquireNodesBatch(rank, maxCount, pNodeAddresses);
+        if (reservedCount < maxCount
+            && m_options.reclamationType == ReclamationType::Epochs
+            && reclaimRetiredNodes() > 0)
+        {
+            reservedCount += acquireNodesBatch(rank, maxCount - reservedCount, pNodeAddresses + reservedCount);
+        }
+        m_reservedNodeAddresses.assign(pNodeAddresses, pNodeAddresses + reservedCount);
+
+        RMA_STACK_TRACE(m_logger, "reserved {} of {} nodes", reservedCount, maxCount);
+        return reservedCount;
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::releaseReservedNodes()
+    {
+        if (m_reservedNodeAddresses.empty())
+            return;
+
+        const int rank = getNodePoolRank();
+        m_windowSync.lock(rank, m_nodesWin);
+        for (const auto &rNodeAddress: m_reservedNodeAddresses)
+            releaseNode(rNodeAddress);
+        m_windowSync.unlock(rank, m_nodesWin);
+
+        RMA_STACK_TRACE(m_logger, "released {} reserved nodes", m_reservedNodeAddresses.size());
+        m_reservedNodeAddresses.clear();
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::setHeadRank(int rank)
+    {
+        m_headRank = rank;
+        if (!m_options.staticWindows)
+            m_headAddress = m_pBaseHeadAddresses[rank];
+    }
+
+    /*
+     * Неблокирующий PUSH: узел захватывается сразу, а чтение головы и запись узла выполняются
+     * операциями с запросами. Для CAS в MPI нет операции с запросом, поэтому он
+     * завершается вызовом MPI_Win_flush_local, см. compareAndSwapRequestHead. Перед CAS
+     * запись узла завершается в памяти целевого процесса вызовом MPI_Win_flush, см. flushRequestNode.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::pushInlineAsync(const void *pValue, Request &rRequest)
+    {
+        startRequest(rRequest, InnerStackRequestType::Push);
+        RMA_STACK_TRACE(m_logger, "started 'pushAsync'");
+
+        auto nodeAddress = acquireNode(getNodePoolRank());
+        if (isGlobalAddressDummy(nodeAddress)
+            && m_options.reclamationType == ReclamationType::Epochs
+            && reclaimRetiredNodes() > 0)
+        {
+            nodeAddress = acquireNode(getNodePoolRank());
+        }
+        if (isGlobalAddressDummy(nodeAddress))
+        {
+            RMA_STACK_TRACE(m_logger, "failed to find free node in 'pushAsync'");
+            completeRequest(rRequest, false);
+            return;
+        }
+
+        rRequest.m_nodeAddress = nodeAddress;
+        rRequest.m_newCountedNodePtr = CountedNodePtr();
+        rRequest.m_newCountedNodePtr.setRank(nodeAddress.rank);
+        rRequest.m_newCountedNodePtr.setOffset(nodeAddress.offset);
+        rRequest.m_newCountedNodePtr.incExternalCounter();
+        std::memcpy(rRequest.m_nodeImage.data() + sizeof(CountedNodePtr), pValue, m_inlinePayloadSize);
+
+        startHeadPhase(rRequest);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::popInlineAsync(void *pValue, const void *pDefaultValue, Request &rRequest)
+    {
+        startRequest(rRequest, InnerStackRequestType::Pop);
+        RMA_STACK_TRACE(m_logger, "started 'popAsync'");
+
+        rRequest.m_pValue = pValue;
+        std::memcpy(rRequest.m_defaultPayload.data(), pDefaultValue, m_inlinePayloadSize);
+
+        if (m_options.reclamationType == ReclamationType::Epochs)
+        {
+            rRequest.m_state = InnerStackRequestState::WaitingEpoch;
+            progressPopRequestWithEpochs(rRequest);
+            return;
+        }
+        startHeadPhase(rRequest);
+    }
+
+    // Если ожидаемая RMA-операция завершена, то операция переходит в следующее состояние.
+    template<typename Layout>
+    bool InnerStack<Layout>::testRequest(Request &rRequest)
+    {
+        if (rRequest.m_state == InnerStackRequestState::Complete)
+            return true;
+
+        /*
+         * Операция начнётся, когда текущая операция завершит CAS головы, поэтому продвигается текущая,
+         * если её не продвигали после предыдущего вызова для этой операции. Иначе при опросе всех
+         * операций текущая проверялась бы столько раз, сколько операций её ожидает.
+         */
+        if (rRequest.m_state == InnerStackRequestState::WaitingHead)
+        {
+            if (rRequest.m_seenHeadRequestTestsNum == m_headRequestTestsNum)
+                testRequest(*m_pHeadRequest);
+            rRequest.m_seenHeadRequestTestsNum = m_headRequestTestsNum;
+            return false;
+        }
+        if (&rRequest == m_pHeadRequest)
+            ++m_headRequestTestsNum;
+
+        if (rRequest.m_mpiRequest != MPI_REQUEST_NULL)
+        {
+            int flag{0};
+            auto mpiStatus = MPI_Test(&rRequest.m_mpiRequest, &flag, MPI_STATUS_IGNORE);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to test RMA request", __FILE__, __func__, __LINE__, mpiStatus);
+            if (!flag)
+                return false;
+        }
+
+        if (rRequest.m_type == InnerStackRequestType::Push)
+            progressPushRequest(rRequest);
+        else if (m_options.reclamationType == ReclamationType::Epochs)
+            progressPopRequestWithEpochs(rRequest);
+        else
+            progressPopRequest(rRequest);
+
+        return rRequest.m_state == InnerStackRequestState::Complete;
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::checkAsyncSupport(const Request &rRequest) const
+    {
+        if (!m_options.inlinePayload || !m_options.persistentLockAll || m_intraNodeSharedMemory)
+            throw std::logic_error("asynchronous operations require the inline payload and the persistent lock all "
+                                   "without intra-node shared memory");
+        // POP из собственного стека сообщал бы о пустом стеке, когда значения есть в стеках других процессов.
+        if (m_options.workStealing)
+            throw std::logic_error("asynchronous operations do not support the work stealing mode");
+        if (rRequest.isActive())
+            throw std::logic_error("the request is still active");
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::startRequest(Request &rRequest, InnerStackRequestType type)
+    {
+        checkAsyncSupport(rRequest);
+        rRequest.m_pStack = this;
+        rRequest.m_type = type;
+        rRequest.m_result = false;
+        rRequest.m_headReplaced = false;
+        rRequest.m_nodeAddress = {0, Layout::DummyRank, 0};
+        rRequest.m_pValue = nullptr;
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::progressPushRequest(Request &rRequest)
+    {
+        switch (rRequest.m_state)
+        {
+            case InnerStackRequestState::ReadingHead:
+                startNodeWrite(rRequest);
+                break;
+            case InnerStackRequestState::WritingNode:
+                flushRequestNode(rRequest);
+                if (compareAndSwapRequestHead(rRequest, rRequest.m_newCountedNodePtr))
+                {
+                    finishHeadPhase();
+                    RMA_STACK_TRACE(m_logger, "finished 'pushAsync'");
+                    completeRequest(rRequest, true);
+                    break;
+                }
+                // Узел перезаписывается новой головой, как в цикле pushImpl.
+                rRequest.m_oldHeadCountedNodePtr = rRequest.m_resHeadCountedNodePtr;
+                startNodeWrite(rRequest);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /*
+     * Неблокирующий POP со счётчиками ссылок повторяет шаги popImpl без массива исключения.
+     * Каждый шаг, включая увеличение внешнего счётчика головы и возврат узла в пул, выполняется
+     * RMA-операцией с запросом; ожидание завершения есть только у CAS и у MPI_Win_flush перед ним.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::progressPopRequest(Request &rRequest)
+    {
+        switch (rRequest.m_state)
+        {
+            case InnerStackRequestState::IncreasingHeadCount:
+                rRequest.m_oldHeadCountedNodePtr.incExternalCounter();
+                if (rRequest.m_oldHeadCountedNodePtr.isDummy())
+                {
+                    finishHeadPhase();
+                    completeRequest(rRequest, false);
+                    return;
+                }
+                startNodeRead(rRequest);
+                return;
+            case InnerStackRequestState::ReadingNode:
+            case InnerStackRequestState::SwappingHead:
+                swapRequestHead(rRequest);
+                return;
+            case InnerStackRequestState::UpdatingCounter:
+            {
+                // Узел возвращается в пул операцией, которая сняла с него последнюю ссылку.
+                const bool lastReference = rRequest.m_headReplaced
+                        ? rRequest.m_resInternalCount == -rRequest.m_countIncrease
+                        : rRequest.m_resInternalCount == 1;
+                if (lastReference)
+                    startNodeRelease(rRequest);
+                else
+                    finishPopAttempt(rRequest);
+                return;
+            }
+            case InnerStackRequestState::ReadingFreeList:
+            case InnerStackRequestState::WritingFreeNode:
+            case InnerStackRequestState::ReleasingNode:
+                progressNodeRelease(rRequest);
+                return;
+            default:
+                return;
+        }
+    }
+
+    /*
+     * Пока голова указывает на узел операции, ссылка операции учтена во внешнем счётчике головы,
+     * поэтому при неудачном CAS из-за изменения только счётчика CAS повторяется при следующем
+     * вызове test без отказа от ссылки. Иначе незавершённые POP процесса увеличивали бы счётчик
+     * головы, на которой ожидают CAS остальные, и мешали бы друг другу.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::swapRequestHead(Request &rRequest)
+    {
+        CountedNodePtr countedNodePtrNext;
+        std::memcpy(&countedNodePtrNext, rRequest.m_nodeImage.data(), sizeof(CountedNodePtr));
+
+        rRequest.m_headReplaced = compareAndSwapRequestHead(rRequest, countedNodePtrNext);
+        if (rRequest.m_headReplaced)
+        {
+            finishHeadPhase();
+            std::memcpy(rRequest.m_pValue,
+                        rRequest.m_nodeImage.data() + sizeof(CountedNodePtr),
+                        m_inlinePayloadSize
+            );
+            const auto externalCount = static_cast<int32_t>(rRequest.m_oldHeadCountedNodePtr.getExternalCounter());
+            startInternalCounterUpdate(rRequest, externalCount - 2);
+            return;
+        }
+
+        const auto &rResHeadCountedNodePtr = rRequest.m_resHeadCountedNodePtr;
+        if (rResHeadCountedNodePtr.getRank() == rRequest.m_oldHeadCountedNodePtr.getRank()
+            && rResHeadCountedNodePtr.getOffset() == rRequest.m_oldHeadCountedNodePtr.getOffset())
+        {
+            rRequest.m_oldHeadCountedNodePtr = rResHeadCountedNodePtr;
+            rRequest.m_state = InnerStackRequestState::SwappingHead;
+            return;
+        }
+        finishHeadPhase();
+        startInternalCounterUpdate(rRequest, -1);
+    }
+
+    /*
+     * Неблокирующий POP при освобождении узлов по эпохам. Все незавершённые неблокирующие POP
+     * процесса находятся в одной эпохе, см. m_asyncPopRequests.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::progressPopRequestWithEpochs(Request &rRequest)
+    {
+        switch (rRequest.m_state)
+        {
+            case InnerStackRequestState::WaitingEpoch:
+                // Операции текущей эпохи продвигаются здесь, чтобы её завершение не зависело от порядка вызовов test.
+                if (m_asyncEpochDraining && !m_asyncPopRequests.empty())
+                {
+                    const auto epochRequests = m_asyncPopRequests;
+                    for (auto pEpochRequest: epochRequests)
+                        testRequest(*pEpochRequest);
+                    if (!m_asyncPopRequests.empty())
+                        return;
+                }
+                if (m_asyncPopRequests.empty())
+                {
+                    enterEpoch();
+                    m_asyncEpochDraining = false;
+                }
+                m_asyncPopRequests.push_back(&rRequest);
+                startHeadPhase(rRequest);
+                return;
+            case InnerStackRequestState::ReadingHead:
+                break;
+            case InnerStackRequestState::ReadingNode:
+            {
+                CountedNodePtr countedNodePtrNext;
+                std::memcpy(&countedNodePtrNext, rRequest.m_nodeImage.data(), sizeof(CountedNodePtr));
+
+                if (compareAndSwapRequestHead(rRequest, countedNodePtrNext))
+                {
+                    finishHeadPhase();
+                    std::memcpy(rRequest.m_pValue,
+                                rRequest.m_nodeImage.data() + sizeof(CountedNodePtr),
+                                m_inlinePayloadSize
+                    );
+                    leaveAsyncPopEpoch(rRequest);
+                    retireNode(rRequest.m_nodeAddress);
+                    RMA_STACK_TRACE(m_logger, "finished 'popAsync'");
+                    completeRequest(rRequest, true);
+                    return;
+                }
+                rRequest.m_oldHeadCountedNodePtr = rRequest.m_resHeadCountedNodePtr;
+                break;
+            }
+            default:
+                return;
+        }
+
+        if (rRequest.m_oldHeadCountedNodePtr.isDummy())
+        {
+            finishHeadPhase();
+            leaveAsyncPopEpoch(rRequest);
+            completeRequest(rRequest, false);
+            return;
+        }
+        startNodeRead(rRequest);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::leaveAsyncPopEpoch(Request &rRequest)
+    {
+        m_asyncPopRequests.erase(std::find(m_asyncPopRequests.begin(), m_asyncPopRequests.end(), &rRequest));
+        if (m_asyncPopRequests.empty())
+            leaveEpoch();
+    }
+
+    // Операция начинает шаги с головой, если их не выполняет другая операция процесса, иначе встаёт в очередь.
+    template<typename Layout>
+    void InnerStack<Layout>::startHeadPhase(Request &rRequest)
+    {
+        if (m_pHeadRequest != nullptr)
+        {
+            rRequest.m_state = InnerStackRequestState::WaitingHead;
+            rRequest.m_seenHeadRequestTestsNum = m_headRequestTestsNum;
+            m_headWaitingRequests.push_back(&rRequest);
+            return;
+        }
+
+        m_pHeadRequest = &rRequest;
+        if (rRequest.m_type == InnerStackRequestType::Pop && m_options.reclamationType != ReclamationType::Epochs)
+            startHeadCountIncrease(rRequest);
+        else
+            startHeadRead(rRequest);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::finishHeadPhase()
+    {
+        m_pHeadRequest = nullptr;
+        if (m_headWaitingRequests.empty())
+            return;
+
+        auto pRequest = m_headWaitingRequests.front();
+        m_headWaitingRequests.pop_front();
+        startHeadPhase(*pRequest);
+    }
+
+    // Атомарное чтение головы в m_oldHeadCountedNodePtr.
+    template<typename Layout>
+    void InnerStack<Layout>::startHeadRead(Request &rRequest)
+    {
+        rRequest.m_state = InnerStackRequestState::ReadingHead;
+        auto mpiStatus = MPI_Rget_accumulate(nullptr,
+                                             0,
+                                             MPI_UINT64_T,
+                                             &rRequest.m_oldHeadCountedNodePtr,
+                                             1,
+                                             MPI_UINT64_T,
+                                             m_headRank,
+                                             m_headAddress,
+                                             1,
+                                             MPI_UINT64_T,
+                                             MPI_NO_OP,
+                                             m_headWin,
+                                             &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to read head", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    /*
+     * Внешний счётчик ссылок занимает старшие биты указателя, поэтому он увеличивается атомарным
+     * сложением с указателем, в котором установлен только счётчик, без цикла CAS increaseHeadCount.
+     * Переполнение счётчика не затрагивает номер процесса и смещение узла.
+     * В m_oldHeadCountedNodePtr записывается голова до увеличения счётчика.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::startHeadCountIncrease(Request &rRequest)
+    {
+        rRequest.m_state = InnerStackRequestState::IncreasingHeadCount;
+        rRequest.m_headCountIncrease = CountedNodePtr();
+        rRequest.m_headCountIncrease.setRank(0);
+        rRequest.m_headCountIncrease.setExternalCounter(1);
+        auto mpiStatus = MPI_Rget_accumulate(&rRequest.m_headCountIncrease,
+                                             1,
+                                             MPI_UINT64_T,
+                                             &rRequest.m_oldHeadCountedNodePtr,
+                                             1,
+                                             MPI_UINT64_T,
+                                             m_headRank,
+                                             m_headAddress,
+                                             1,
+                                             MPI_UINT64_T,
+                                             MPI_SUM,
+                                             m_headWin,
+                                             &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to increase head count", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    /*
+     * Указатель на следующий узел и данные пользователя записываются операцией MPI_Rget_accumulate
+     * с MPI_REPLACE. Завершение её запроса означает только локальное завершение: буфер результата
+     * заполнен, а буфер m_nodeImage можно изменять. Запись в памяти целевого процесса завершается
+     * вызовом flushRequestNode перед CAS головы. Узел записывается словами по 8 байт вместе
+     * с выравниванием данных.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::startNodeWrite(Request &rRequest)
+    {
+        rRequest.m_state = InnerStackRequestState::WritingNode;
+        std::memcpy(rRequest.m_nodeImage.data(), &rRequest.m_oldHeadCountedNodePtr, sizeof(CountedNodePtr));
+
+        const auto nodeImageWordsNum = static_cast<int>((m_nodeSize - sizeof(CountedNodePtr)) / sizeof(uint64_t));
+        auto mpiStatus = MPI_Rget_accumulate(rRequest.m_nodeImage.data(),
+                                             nodeImageWordsNum,
+                                             MPI_UINT64_T,
+                                             rRequest.m_resNodeImage.data(),
+                                             nodeImageWordsNum,
+                                             MPI_UINT64_T,
+                                             static_cast<int>(rRequest.m_nodeAddress.rank),
+                                             getNodeNextOffset(rRequest.m_nodeAddress),
+                                             nodeImageWordsNum,
+                                             MPI_UINT64_T,
+                                             MPI_REPLACE,
+                                             m_nodesWin,
+                                             &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to write node", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    // Чтение указателя на следующий узел и данных пользователя узла, на который указывает m_oldHeadCountedNodePtr.
+    template<typename Layout>
+    void InnerStack<Layout>::startNodeRead(Request &rRequest)
+    {
+        rRequest.m_state = InnerStackRequestState::ReadingNode;
+        rRequest.m_nodeAddress = {
+                rRequest.m_oldHeadCountedNodePtr.getOffset(),
+                rRequest.m_oldHeadCountedNodePtr.getRank(),
+                0
+        };
+
+        const auto nodeImageSize = static_cast<int>(m_nodeImage.size());
+        auto mpiStatus = MPI_Rget(rRequest.m_nodeImage.data(),
+                                  nodeImageSize,
+                                  MPI_BYTE,
+                                  static_cast<int>(rRequest.m_nodeAddress.rank),
+                                  getNodeNextOffset(rRequest.m_nodeAddress),
+                                  nodeImageSize,
+                                  MPI_BYTE,
+                                  m_nodesWin,
+                                  &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to read node", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::startInternalCounterUpdate(Request &rRequest, int32_t countIncrease)
+    {
+        rRequest.m_state = InnerStackRequestState::UpdatingCounter;
+        rRequest.m_countIncrease = countIncrease;
+        auto mpiStatus = MPI_Rget_accumulate(&rRequest.m_countIncrease,
+                                             1,
+                                             MPI_INT32_T,
+                                             &rRequest.m_resInternalCount,
+                                             1,
+                                             MPI_INT32_T,
+                                             static_cast<int>(rRequest.m_nodeAddress.rank),
+                                             getNodeInternalCounterOffset(rRequest.m_nodeAddress),
+                                             1,
+                                             MPI_INT32_T,
+                                             MPI_SUM,
+                                             m_nodesWin,
+                                             &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to update internal counter", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    /*
+     * Запись в узел m_nodeAddress, выполненная операцией с запросом, завершается в памяти целевого
+     * процесса. Окно узлов и окно головы не упорядочены между собой, поэтому без MPI_Win_flush
+     * другой процесс мог бы прочитать опубликованный CAS узел до завершения записи.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::flushRequestNode(const Request &rRequest)
+    {
+        const auto nodeRank = static_cast<int>(rRequest.m_nodeAddress.rank);
+        auto mpiStatus = MPI_Win_flush(nodeRank, m_nodesWin);
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to flush RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    /*
+     * MPI_Compare_and_swap не имеет варианта с запросом, поэтому CAS и MPI_Win_flush перед ним -
+     * единственные шаги неблокирующих операций, которые ожидают завершения. Для результата CAS достаточно
+     * локального завершения операции. Голова сравнивается с m_oldHeadCountedNodePtr,
+     * результат записывается в m_resHeadCountedNodePtr.
+     */
+    template<typename Layout>
+    bool InnerStack<Layout>::compareAndSwapRequestHead(Request &rRequest, const CountedNodePtr &newCountedNodePtr)
+    {
+        {
+            auto mpiStatus = MPI_Compare_and_swap(&newCountedNodePtr,
+                                                  &rRequest.m_oldHeadCountedNodePtr,
+                                                  &rRequest.m_resHeadCountedNodePtr,
+                                                  MPI_UINT64_T,
+                                                  m_headRank,
+                                                  m_headAddress,
+                                                  m_headWin
+            );
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to execute CAS", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        {
+            auto mpiStatus = MPI_Win_flush_local(m_headRank, m_headWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to flush RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        if (rRequest.m_resHeadCountedNodePtr != rRequest.m_oldHeadCountedNodePtr)
+        {
+            countHeadCasFailure();
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Возврат узла m_nodeAddress в пул, аналог releaseNode. Узел своего пула кладётся в кэш узлов,
+     * если в нём есть место, иначе возвращается операциями с запросами: в битовой карте бит узла
+     * сбрасывается одной операцией, а в список свободных узлов узел добавляется чтением головы списка,
+     * записью индекса следующего узла и CAS головы списка. Кэш при заполнении не опустошается,
+     * поскольку это требует ожидания завершения RMA-операций.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::startNodeRelease(Request &rRequest)
+    {
+        const auto nodeAddress = rRequest.m_nodeAddress;
+        const auto nodeRank = static_cast<int>(nodeAddress.rank);
+        if (m_nodeMagazine.getCapacity() > 0 && nodeRank == getNodePoolRank() && !m_nodeMagazine.isFull())
+        {
+            m_nodeMagazine.push(nodeAddress);
+            finishPopAttempt(rRequest);
+            return;
+        }
+
+        if (m_options.nodeAllocatorType == NodeAllocatorType::Bitmap)
+        {
+            rRequest.m_state = InnerStackRequestState::ReleasingNode;
+            rRequest.m_nodeBitmapMask = ~(uint64_t{1} << (nodeAddress.offset % NodeBitmapWordBits));
+            const MPI_Aint wordOffset = MPI_Aint_add(getNodeBitmapOffset(nodeRank),
+                                                     static_cast<MPI_Aint>(nodeAddress.offset / NodeBitmapWordBits
+                                                                           * sizeof(uint64_t))
+            );
+            auto mpiStatus = MPI_Rget_accumulate(&rRequest.m_nodeBitmapMask,
+                                                 1,
+                                                 MPI_UINT64_T,
+                                                 &rRequest.m_resNodeBitmapWord,
+                                                 1,
+                                                 MPI_UINT64_T,
+                                                 nodeRank,
+                                                 wordOffset,
+                                                 1,
+                                                 MPI_UINT64_T,
+                                                 MPI_BAND,
+                                                 m_nodesWin,
+                                                 &rRequest.m_mpiRequest
+            );
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to release node", __FILE__, __func__, __LINE__, mpiStatus);
+            return;
+        }
+
+        rRequest.m_state = InnerStackRequestState::ReadingFreeList;
+        auto mpiStatus = MPI_Rget_accumulate(nullptr,
+                                             0,
+                                             MPI_UINT64_T,
+                                             &rRequest.m_freeListHead,
+                                             1,
+                                             MPI_UINT64_T,
+                                             nodeRank,
+                                             getFreeListHeadOffset(nodeRank, nodeAddress.offset),
+                                             1,
+                                             MPI_UINT64_T,
+                                             MPI_NO_OP,
+                                             m_nodesWin,
+                                             &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to read free list head", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::progressNodeRelease(Request &rRequest)
+    {
+        switch (rRequest.m_state)
+        {
+            case InnerStackRequestState::ReadingFreeList:
+                startFreeNodeWrite(rRequest);
+                return;
+            case InnerStackRequestState::WritingFreeNode:
+                flushRequestNode(rRequest);
+                if (!compareAndSwapRequestFreeList(rRequest))
+                {
+                    rRequest.m_freeListHead = rRequest.m_resFreeListHead;
+                    startFreeNodeWrite(rRequest);
+                    return;
+                }
+                if (m_options.elasticNodePool)
+                {
+                    // Уменьшение счётчика занятых узлов сегмента, как в releaseNodesToFreeList.
+                    const auto nodeRank = static_cast<int>(rRequest.m_nodeAddress.rank);
+                    const auto slot = NodeSegmentLayout::getSlot(rRequest.m_nodeAddress.offset);
+                    rRequest.m_state = InnerStackRequestState::ReleasingNode;
+                    rRequest.m_usedCountIncrease = -1;
+                    auto mpiStatus = MPI_Rget_accumulate(&rRequest.m_usedCountIncrease,
+                                                         1,
+                                                         MPI_INT64_T,
+                                                         &rRequest.m_resUsedCount,
+                                                         1,
+                                                         MPI_INT64_T,
+                                                         nodeRank,
+                                                         getNodeSegmentUsedCountOffset(nodeRank, slot),
+                                                         1,
+                                                         MPI_INT64_T,
+                                                         MPI_SUM,
+                                                         m_nodesWin,
+                                                         &rRequest.m_mpiRequest
+                    );
+                    if (mpiStatus != MPI_SUCCESS)
+                        throw custom_mpi::MpiException("failed to update used count", __FILE__, __func__, __LINE__, mpiStatus);
+                    return;
+                }
+                finishPopAttempt(rRequest);
+                return;
+            case InnerStackRequestState::ReleasingNode:
+                finishPopAttempt(rRequest);
+                return;
+            default:
+                return;
+        }
+    }
+
+    /*
+     * Индекс следующего свободного узла записывается в освобождаемый узел до CAS головы списка.
+     * Запись и CAS обращаются к разным адресам окна узлов и не упорядочены, поэтому перед CAS
+     * запись завершается вызовом flushRequestNode.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::startFreeNodeWrite(Request &rRequest)
+    {
+        rRequest.m_state = InnerStackRequestState::WritingFreeNode;
+        rRequest.m_nextFreeIndex = static_cast<uint32_t>(rRequest.m_freeListHead.index);
+
+        const auto nodeRank = static_cast<int>(rRequest.m_nodeAddress.rank);
+        auto mpiStatus = MPI_Rget_accumulate(&rRequest.m_nextFreeIndex,
+                                             1,
+                                             MPI_UINT32_T,
+                                             &rRequest.m_resNextFreeIndex,
+                                             1,
+                                             MPI_UINT32_T,
+                                             nodeRank,
+                                             getNodeOffset(nodeRank, rRequest.m_nodeAddress.offset),
+                                             1,
+                                             MPI_UINT32_T,
+                                             MPI_REPLACE,
+                                             m_nodesWin,
+                                             &rRequest.m_mpiRequest
+        );
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to write free node", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::compareAndSwapRequestFreeList(Request &rRequest)
+    {
+        const auto nodeRank = static_cast<int>(rRequest.m_nodeAddress.rank);
+        const FreeListHead newFreeListHead{getNodeIndex(rRequest.m_nodeAddress.offset),
+                                           rRequest.m_freeListHead.tag + 1u};
+        {
+            auto mpiStatus = MPI_Compare_and_swap(&newFreeListHead,
+                                                  &rRequest.m_freeListHead,
+                                                  &rRequest.m_resFreeListHead,
+                                                  MPI_UINT64_T,
+                                                  nodeRank,
+                                                  getFreeListHeadOffset(nodeRank, rRequest.m_nodeAddress.offset),
+                                                  m_nodesWin
+            );
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to execute CAS", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        {
+            auto mpiStatus = MPI_Win_flush_local(nodeRank, m_nodesWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to flush RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        return rRequest.m_resFreeListHead.index == rRequest.m_freeListHead.index
+               && rRequest.m_resFreeListHead.tag == rRequest.m_freeListHead.tag;
+    }
+
+    // Попытка POP, завершившаяся изменением внутреннего счётчика и, возможно, возвратом узла.
+    template<typename Layout>
+    void InnerStack<Layout>::finishPopAttempt(Request &rRequest)
+    {
+        if (rRequest.m_headReplaced)
+        {
+            RMA_STACK_TRACE(m_logger, "finished 'popAsync'");
+            completeRequest(rRequest, true);
+            return;
+        }
+        startHeadPhase(rRequest);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::completeRequest(Request &rRequest, bool result)
+    {
+        rRequest.m_state = InnerStackRequestState::Complete;
+        rRequest.m_result = result;
+        if (rRequest.m_type == InnerStackRequestType::Pop && !result)
+            std::memcpy(rRequest.m_pValue, rRequest.m_defaultPayload.data(), m_inlinePayloadSize);
+        if (result)
+            addSize(rRequest.m_type == InnerStackRequestType::Push ? 1 : -1);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::readNodeNext(GlobalAddress nodeAddress, CountedNodePtr &rCountedNodePtrNext, void *pPayload)
+    {
+        const auto nodeRank = static_cast<int>(nodeAddress.rank);
+
+        m_windowSync.lock(nodeRank, m_nodesWin);
+        getNodeNext(nodeAddress, rCountedNodePtrNext, pPayload);
+        m_windowSync.unlock(nodeRank, m_nodesWin);
+    }
+
+    /*
+     * Чтение указателя на следующий узел при захваченном окне узлов. Если pPayload не равен nullptr,
+     * то указатель и данные пользователя, которые расположены за ним, читаются одной операцией MPI_Get.
+     * Узел защищён от освобождения счётчиком ссылок или эпохой, а его поля не изменяются,
+     * пока он находится в стеке, поэтому неатомарное чтение допустимо.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::getNodeNext(GlobalAddress nodeAddress, CountedNodePtr &rCountedNodePtrNext, void *pPayload)
+    {
+        const auto nodeRank = static_cast<int>(nodeAddress.rank);
+
+        if (pPayload == nullptr)
+        {
+            m_intraNodeNodesWin.fetchAndOp(nullptr,
+                                           &rCountedNodePtrNext,
+                                           MPI_UINT64_T,
+                                           nodeRank,
+                                           getNodeNextOffset(nodeAddress),
+                                           MPI_NO_OP,
+                                           m_nodesWin
+            );
+            m_intraNodeNodesWin.flush(nodeRank, m_nodesWin);
+            return;
+        }
+
+        const auto nodeImageSize = static_cast<int>(m_nodeImage.size());
+        m_intraNodeNodesWin.get(m_nodeImage.data(),
+                                nodeImageSize,
+                                MPI_BYTE,
+                                nodeRank,
+                                getNodeNextOffset(nodeAddress),
+                                nodeImageSize,
+                                MPI_BYTE,
+                                m_nodesWin
+        );
+        m_intraNodeNodesWin.flush(nodeRank, m_nodesWin);
+        std::memcpy(&rCountedNodePtrNext, m_nodeImage.data(), sizeof(CountedNodePtr));
+        std::memcpy(pPayload, m_nodeImage.data() + sizeof(CountedNodePtr), m_inlinePayloadSize);
+    }
+
+    template<typename Layout>
+    void *InnerStack<Layout>::getPayloadSlot(void *pPayloads, size_t index) const
+    {
+        if (pPayloads == nullptr)
+            return nullptr;
+        return static_cast<unsigned char *>(pPayloads) + index * m_inlinePayloadSize;
+    }
+
+    /*
+     * Эпоха процесса нечётна, пока процесс выполняет операцию POP, и чётна вне операции.
+     * Эпоха хранится в окне текущего процесса, поэтому её объявление не требует
+     * обращения к другим процессам. Незавершённые неблокирующие POP и синхронный POP
+     * находятся в одной эпохе, поэтому вложенные входы в эпоху её не меняют.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::enterEpoch()
+    {
+        if (m_epochNesting++ > 0)
+            return;
+        ++m_epoch;
+        publishEpoch();
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::leaveEpoch()
+    {
+        if (--m_epochNesting > 0)
+            return;
+        ++m_epoch;
+        publishEpoch();
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::publishEpoch()
+    {
+        m_windowSync.lock(m_rank, m_epochsWin);
+        m_intraNodeEpochsWin.accumulate(&m_epoch,
+                                        1,
+                                        MPI_UINT64_T,
+                                        m_rank,
+                                        getEpochBaseAddress(m_rank),
+                                        1,
+                                        MPI_UINT64_T,
+                                        MPI_REPLACE,
+                                        m_epochsWin
+        );
+        m_intraNodeEpochsWin.flush(m_rank, m_epochsWin);
+        m_windowSync.unlock(m_rank, m_epochsWin);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::readEpochs(std::vector<uint64_t> &rEpochs)
+    {
+        rEpochs.resize(static_cast<size_t>(m_procNum));
+        for (int rank = 0; rank < m_procNum; ++rank)
+        {
+            m_windowSync.lock(rank, m_epochsWin);
+            m_intraNodeEpochsWin.fetchAndOp(nullptr,
+                                            &rEpochs[rank],
+                                            MPI_UINT64_T,
+                                            rank,
+                                            getEpochBaseAddress(rank),
+                                            MPI_NO_OP,
+                                            m_epochsWin
+            );
+        }
+        m_intraNodeEpochsWin.flushAll(m_epochsWin);
+        for (int rank = 0; rank < m_procNum; ++rank)
+            m_windowSync.unlock(rank, m_epochsWin);
+    }
+
+    // Каждый процесс в момент снимка rEpochs был вне операции или с тех пор сменил эпоху.
+    template<typename Layout>
+    bool InnerStack<Layout>::haveEpochsPassed(const std::vector<uint64_t> &rEpochs,
+                                              const std::vector<uint64_t> &rCurrentEpochs) const
+    {
+        for (int rank = 0; rank < m_procNum; ++rank)
+        {
+            if (rEpochs[rank] % 2 != 0 && rEpochs[rank] == rCurrentEpochs[rank])
+                return false;
+        }
+        return true;
+    }
+
+    // Извлечённый узел освобождается не сразу, а после проверки эпох в составе пачки.
+    template<typename Layout>
+    void InnerStack<Layout>::retireNode(GlobalAddress nodeAddress)
+    {
+        m_retiredNodes.push_back(nodeAddress);
+        if (m_retiredNodes.size() >= std::max<size_t>(1, m_options.retiredNodesBatchSize))
+            reclaimRetiredNodes();
+    }
+
+    /*
+     * Снимок эпох всех процессов закрывает текущую пачку извлечённых узлов и одновременно
+     * используется для проверки ранее закрытых пачек. Пачка освобождается, если каждый
+     * процесс, включая текущий с его неблокирующими POP, в момент её закрытия был вне операции
+     * или с тех пор сменил эпоху.
+     * Возвращает кол-во освобождённых узлов.
+     */
+    template<typename Layout>
+    size_t InnerStack<Layout>::reclaimRetiredNodes()
+    {
+        readEpochs(m_epochsSnapshot);
+        if (!m_asyncPopRequests.empty())
+            m_asyncEpochDraining = true;
+
+        if (!m_retiredNodes.empty())
+        {
+            m_retiredNodesBatches.push_back({std::move(m_retiredNodes), m_epochsSnapshot});
+            m_retiredNodes.clear();
+        }
+
+        size_t reclaimedCount{0};
+        while (!m_retiredNodesBatches.empty())
+        {
+            const auto &rBatch = m_retiredNodesBatches.front();
+
+            if (!haveEpochsPassed(rBatch.epochs, m_epochsSnapshot))
+                break;
+
+            freeRetiredNodes(rBatch.nodeAddresses);
+            reclaimedCount += rBatch.nodeAddresses.size();
+            m_retiredNodesBatches.pop_front();
+        }
+
+        if (reclaimedCount > 0)
+            RMA_STACK_TRACE(m_logger, "reclaimed {} retired nodes", reclaimedCount);
+        return reclaimedCount;
+    }
+
+    // Подряд идущие узлы одного процесса освобождаются за одну эпоху доступа.
+    template<typename Layout>
+    void InnerStack<Layout>::freeRetiredNodes(const std::vector<GlobalAddress> &nodeAddresses)
+    {
+        for (size_t beginIdx = 0; beginIdx < nodeAddresses.size();)
+        {
+            const auto rank = nodeAddresses[beginIdx].rank;
+            const auto nodeRank = static_cast<int>(rank);
+
+            m_windowSync.lock(nodeRank, m_nodesWin);
+            size_t endIdx = beginIdx;
+            for (; endIdx < nodeAddresses.size() && nodeAddresses[endIdx].rank == rank; ++endIdx)
+                releaseNode(nodeAddresses[endIdx]);
+            m_windowSync.unlock(nodeRank, m_nodesWin);
+
+            beginIdx = endIdx;
+        }
+    }
+
+    /*
+     * Освобождение ссылок на узлы отделённой цепочки. Вершина учитывает собственную
+     * ссылку и ссылку из головы (внешний счётчик минус 2), остальные узлы - только
+     * ссылку из предыдущего узла (внешний счётчик минус 1). Узел освобождается,
+     * если на него не осталось ссылок других операций POP.
+     * Подряд идущие узлы одного процесса обрабатываются за одну эпоху доступа.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::releaseDetachedNodes(size_t count)
+    {
+        const GlobalAddress *pNodeAddresses = m_batchNodeAddresses.data();
+        m_batchCountIncreases.resize(count);
+        m_batchInternalCounts.resize(count);
+
+        for (size_t beginIdx = 0; beginIdx < count;)
+        {
+            const auto rank = pNodeAddresses[beginIdx].rank;
+            size_t endIdx = beginIdx;
+            while (endIdx < count && pNodeAddresses[endIdx].rank == rank)
+                ++endIdx;
+
+            const auto nodeRank = static_cast<int>(rank);
+            m_windowSync.lock(nodeRank, m_nodesWin);
+            for (size_t i = beginIdx; i < endIdx; ++i)
+            {
+                const auto externalCount = static_cast<int32_t>(m_batchCountedNodePtrs[i].getExternalCounter());
+                m_batchCountIncreases[i] = externalCount - (i == 0 ? 2 : 1);
+                m_intraNodeNodesWin.fetchAndOp(&m_batchCountIncreases[i],
+                                               &m_batchInternalCounts[i],
+                                               MPI_INT32_T,
+                                               nodeRank,
+                                               getNodeInternalCounterOffset(pNodeAddresses[i]),
+                                               MPI_SUM,
+                                               m_nodesWin
+                );
+            }
+            m_intraNodeNodesWin.flush(nodeRank, m_nodesWin);
+
+            for (size_t i = beginIdx; i < endIdx; ++i)
+            {
+                if (m_batchInternalCounts[i] == -m_batchCountIncreases[i])
+                    releaseNode(pNodeAddresses[i]);
+            }
+            m_windowSync.unlock(nodeRank, m_nodesWin);
+
+            beginIdx = endIdx;
+        }
+    }
+
+    /*
+     * Захват до maxCount узлов процесса rank: сначала из зарезервированных узлов и кэша узлов,
+     * затем пачками из пула.
+     */
+    template<typename Layout>
+    size_t InnerStack<Layout>::acquireNodesBatch(int rank, size_t maxCount, GlobalAddress *pNodeAddresses)
+    {
+        size_t acquiredCount{0};
+        if (rank == getNodePoolRank())
+        {
+            while (acquiredCount < maxCount && !m_reservedNodeAddresses.empty())
+            {
+                pNodeAddresses[acquiredCount++] = m_reservedNodeAddresses.back();
+                m_reservedNodeAddresses.pop_back();
+            }
+            while (acquiredCount < maxCount && !m_nodeMagazine.isEmpty())
+                pNodeAddresses[acquiredCount++] = m_nodeMagazine.pop();
+        }
+        if (acquiredCount == maxCount)
+            return acquiredCount;
+
+        m_windowSync.lock(rank, m_nodesWin);
+        while (acquiredCount < maxCount)
+        {
+            const auto count = acquireNodes(rank, maxCount - acquiredCount, pNodeAddresses + acquiredCount);
+            if (count == 0)
+                break;
+            acquiredCount += count;
+        }
+        m_windowSync.unlock(rank, m_nodesWin);
+
+        return acquiredCount;
+    }
+
+    // Смещение узла в окне узлов процесса rank с учётом сегмента, которому принадлежит узел.
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeOffset(int rank, uint64_t offset) const
+    {
+        const auto nodeDisplacement = static_cast<MPI_Aint>(getNodeIndex(offset) * m_nodeSize);
+        return MPI_Aint_add(getNodeSegmentBaseAddress(rank, offset), nodeDisplacement);
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeNextOffset(GlobalAddress nodeAddress) const
+    {
+        const auto nodeOffset = getNodeOffset(static_cast<int>(nodeAddress.rank), nodeAddress.offset);
+        return MPI_Aint_add(nodeOffset, static_cast<MPI_Aint>(sizeof(CountedNodePtr)));
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodePayloadOffset(GlobalAddress nodeAddress) const
+    {
+        const auto nodeOffset = getNodeOffset(static_cast<int>(nodeAddress.rank), nodeAddress.offset);
+        return MPI_Aint_add(nodeOffset, static_cast<MPI_Aint>(sizeof(Node)));
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeInternalCounterOffset(GlobalAddress nodeAddress) const
+    {
+        const auto nodeOffset = getNodeOffset(static_cast<int>(nodeAddress.rank), nodeAddress.offset);
+        return MPI_Aint_add(nodeOffset, static_cast<MPI_Aint>(sizeof(int32_t)));
+    }
+
+    /*
+     * Если включён кэш узлов, то узел берётся из кэша, а при пустом кэше кэш
+     * пополняется пачкой узлов за одно обращение к списку свободных узлов или
+     * к битовой карте.
+     */
+    template<typename Layout>
+    GlobalAddress<Layout> InnerStack<Layout>::acquireNode(int rank)
+    {
+        GlobalAddress nodeAddress = {0, Layout::DummyRank, 0};
+
+        if (m_nodeMagazine.getCapacity() == 0 || rank != getNodePoolRank())
+        {
+            // Буфер может содержать адрес узла из неудавшейся попытки захвата, поэтому учитывается только результат.
+            GlobalAddress acquiredNodeAddress = {0, Layout::DummyRank, 0};
+            m_windowSync.lock(rank, m_nodesWin);
+            if (acquireNodes(rank, 1, &acquiredNodeAddress) == 1)
+                nodeAddress = acquiredNodeAddress;
+            m_windowSync.unlock(rank, m_nodesWin);
+            return nodeAddress;
+        }
+
+        if (m_nodeMagazine.isEmpty())
+            refillNodeMagazine();
+
+        if (!m_nodeMagazine.isEmpty())
+            nodeAddress = m_nodeMagazine.pop();
+
+        return nodeAddress;
+    }
+
+    /*
+     * Функция вызывается при уже открытой эпохе доступа к окну узлов процесса,
+     * которому принадлежит узел. Узлы своего пула сначала возвращаются в кэш узлов,
+     * а при переполненном кэше половина кэша возвращается в пул одной пачкой.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::releaseNode(GlobalAddress nodeAddress)
+    {
+        if (m_nodeMagazine.getCapacity() == 0 || nodeAddress.rank != static_cast<uint64_t>(getNodePoolRank()))
+        {
+            releaseNodes(&nodeAddress, 1);
+            return;
+        }
+
+        if (m_nodeMagazine.isFull())
+            drainNodeMagazine(m_nodeMagazine.getCapacity() - m_nodeMagazine.getCapacity() / 2);
+
+        m_nodeMagazine.push(nodeAddress);
+    }
+
+    // Отказ от ссылки на узел, полученной увеличением внешнего счётчика головы, как при неудачной операции POP.
+    template<typename Layout>
+    void InnerStack<Layout>::releaseNodeReference(GlobalAddress nodeAddress)
+    {
+        const auto nodeRank = static_cast<int>(nodeAddress.rank);
+        const int32_t countIncrease{-1};
+        int32_t resInternalCount{0};
+
+        m_windowSync.lock(nodeRank, m_nodesWin);
+        m_intraNodeNodesWin.fetchAndOp(&countIncrease,
+                                       &resInternalCount,
+                                       MPI_INT32_T,
+                                       nodeRank,
+                                       getNodeInternalCounterOffset(nodeAddress),
+                                       MPI_SUM,
+                                       m_nodesWin
+        );
+        m_intraNodeNodesWin.flush(nodeRank, m_nodesWin);
+        if (resInternalCount == 1)
+            releaseNode(nodeAddress);
+        m_windowSync.unlock(nodeRank, m_nodesWin);
+    }
+
+    // Функция вызывается при уже открытой эпохе доступа к окну узлов процесса rank.
+    template<typename Layout>
+    size_t InnerStack<Layout>::acquireNodes(int rank, size_t maxCount, GlobalAddress *pNodeAddresses)
+    {
+        if (!isValidRank<Layout>(rank) || maxCount == 0)
+            return 0;
+
+        if (m_options.nodeAllocatorType == NodeAllocatorType::Bitmap)
+            return acquireNodesFromBitmap(rank, maxCount, pNodeAddresses);
+        return acquireNodesFromFreeList(rank, maxCount, pNodeAddresses);
+    }
+
+    /*
+     * Функция вызывается при уже открытой эпохе доступа к окну узлов процесса,
+     * которому принадлежат узлы. Все узлы должны принадлежать одному процессу.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::releaseNodes(const GlobalAddress *pNodeAddresses, size_t count)
+    {
+        if (count == 0)
+            return;
+
+        if (m_options.nodeAllocatorType == NodeAllocatorType::Bitmap)
+            releaseNodesToBitmap(pNodeAddresses, count);
+        else
+            releaseNodesToFreeList(pNodeAddresses, count);
+    }
 
-    void InnerStack::push(const std::function<void(GlobalAddress)> &putDataCallback,
-                          const std::function<void()> &backoffCallback)
+    // Пополнение кэша узлов до половины его ёмкости.
+    template<typename Layout>
+    void InnerStack<Layout>::refillNodeMagazine()
     {
-        m_logger->trace("started 'push'");
+        const int rank = getNodePoolRank();
+        const auto refillCount = std::max<size_t>(1, m_nodeMagazine.getCapacity() / 2);
 
-        auto nodeAddress = acquireNode(m_centralized ? HEAD_RANK : m_rank);
-        if (isGlobalAddressDummy(nodeAddress))
-        {
-            putDataCallback(nodeAddress);
-            m_logger->trace("failed to find free node in 'push'");
-            return;
-        }
+        m_windowSync.lock(rank, m_nodesWin);
+        while (m_nodeMagazine.getSize() < refillCount)
         {
-            const auto r = nodeAddress.rank;
-            const auto o = nodeAddress.offset;
-            m_logger->trace("acquired free node (rank - {}, offset - {}) in 'push'", r, o);
+            const auto acquiredCount = acquireNodes(rank,
+                                                    refillCount - m_nodeMagazine.getSize(),
+                                                    m_pNodeAddressesBuffer.get()
+            );
+            if (acquiredCount == 0)
+                break;
+
+            for (size_t i = 0; i < acquiredCount; ++i)
+                m_nodeMagazine.push(m_pNodeAddressesBuffer[i]);
         }
+        m_windowSync.unlock(rank, m_nodesWin);
 
-        putDataCallback(nodeAddress);
-        m_logger->trace("put data in 'push'");
+        RMA_STACK_TRACE(m_logger, "refilled node magazine up to {} nodes", m_nodeMagazine.getSize());
+    }
 
-        CountedNodePtr resHeadCountedNodePtr;
+    // Функция вызывается при уже открытой эпохе доступа к окну узлов пула текущего процесса.
+    template<typename Layout>
+    void InnerStack<Layout>::drainNodeMagazine(size_t count)
+    {
+        count = std::min(count, m_nodeMagazine.getSize());
+        for (size_t i = 0; i < count; ++i)
+            m_pNodeAddressesBuffer[i] = m_nodeMagazine.pop();
 
-        // Получение текущей головы списка.
-        MPI_Win_lock(MPI_LOCK_SHARED, HEAD_RANK, MPI_MODE_NOCHECK, m_headWin);
-        MPI_Fetch_and_op(nullptr,
-                         &resHeadCountedNodePtr,
-                         MPI_UINT64_T,
-                         HEAD_RANK,
-                         m_headAddress,
-                         MPI_NO_OP,
-                         m_headWin
-        );
-        MPI_Win_flush(HEAD_RANK, m_headWin);
+        releaseNodes(m_pNodeAddressesBuffer.get(), count);
+        RMA_STACK_TRACE(m_logger, "drained {} nodes from node magazine", count);
+    }
 
-        m_logger->trace("fetched head (rank - {}, offset - {})", resHeadCountedNodePtr.getRank(), resHeadCountedNodePtr.getOffset());
+    template<typename Layout>
+    int InnerStack<Layout>::getNodePoolRank() const
+    {
+        return m_centralized ? HEAD_RANK : m_rank;
+    }
 
-        m_logger->trace("started new head pushing in 'push'");
+    /*
+     * Узлы извлекаются из списка свободных узлов процесса rank. Список является
+     * стеком Трейбера из индексов узлов, голова которого хранится в окне узлов
+     * сразу за массивом узлов и снабжена тегом, поэтому захват узла требует
+     * постоянного количества атомарных операций независимо от заполненности массива.
+     * Цепочка из нескольких узлов отделяется от списка одной операцией CAS.
+     * В растущем пуле у каждого сегмента свой список: узлы берутся из сегментов с меньшими номерами,
+     * чтобы сегменты с большими номерами освобождались, а при нехватке узлов выделяется новый сегмент.
+     */
+    template<typename Layout>
+    size_t InnerStack<Layout>::acquireNodesFromFreeList(int rank, size_t maxCount, GlobalAddress *pNodeAddresses)
+    {
+        if (!m_options.elasticNodePool)
+            return acquireNodesFromSegmentFreeList(rank, 0, maxCount, pNodeAddresses);
 
-        CountedNodePtr newCountedNodePtr;
-        newCountedNodePtr.setRank(nodeAddress.rank);
-        newCountedNodePtr.setOffset(nodeAddress.offset);
-        newCountedNodePtr.incExternalCounter();
+        // Узлы растущего пула захватывает только процесс, которому они принадлежат.
+        size_t acquiredCount{0};
+        for (;;)
+        {
+            for (size_t slot = 0; slot < NodeSegmentLayout::SlotsNum && acquiredCount < maxCount; ++slot)
+            {
+                if (!m_nodeSegments[slot].active)
+                    continue;
+                acquiredCount += acquireNodesFromSegmentFreeList(rank,
+                                                                 slot,
+                                                                 maxCount - acquiredCount,
+                                                                 pNodeAddresses + acquiredCount
+                );
+            }
+            if (acquiredCount > 0 || !growNodePool())
+                break;
+        }
 
-        CountedNodePtr oldHeadCountedNodePtr;
-        CountedNodePtr countedNodePtrNext;
+        constexpr size_t shrinkCheckInterval{64};
+        if (acquiredCount > 0 && ++m_acquiresSinceShrinkCheck >= shrinkCheckInterval)
+        {
+            m_acquiresSinceShrinkCheck = 0;
+            tryShrinkNodePool();
+        }
+        return acquiredCount;
+    }
 
-        constexpr auto nodeSize                     = sizeof(Node);
-        const auto countedNodePtrNextDisplacement   = static_cast<MPI_Aint>(nodeSize * nodeAddress.offset) + 8;
-        const MPI_Aint countedNodePtrNextOffset     = MPI_Aint_add(m_pBaseNodeArrAddresses[nodeAddress.rank], countedNodePtrNextDisplacement);
+    template<typename Layout>
+    size_t InnerStack<Layout>::acquireNodesFromSegmentFreeList(int rank, size_t slot, size_t maxCount,
+                                                               GlobalAddress *pNodeAddresses)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'acquireNodesFromFreeList'");
+
+        const auto generation = m_options.elasticNodePool ? m_nodeSegments[slot].generation : 0;
+        const auto segmentNodeOffset = m_options.elasticNodePool ? NodeSegmentLayout::makeOffset(slot, generation, 0) : 0;
+        const auto segmentNodesNum = getNodeSegmentNodesNum(slot);
+        const MPI_Aint freeListHeadOffset = getFreeListHeadOffset(rank, segmentNodeOffset);
+
+        FreeListHead resFreeListHead{FreeListEndIndex, 0};
+        m_intraNodeNodesWin.fetchAndOp(nullptr,
+                                       &resFreeListHead,
+                                       MPI_UINT64_T,
+                                       rank,
+                                       freeListHeadOffset,
+                                       MPI_NO_OP,
+                                       m_nodesWin
+        );
+        m_intraNodeNodesWin.flush(rank, m_nodesWin);
 
         /*
-         * Пока не удастся заменить текущую голову списка операцией на новый узел
-         * операцией CAS, перезаписывать глобальный указатель на следующий узел
-         * нового узла текущей головой списка.
+         * Узлы нового сегмента и узлы, возвращённые одной цепочкой, связаны по возрастанию индексов,
+         * поэтому вместе со ссылкой узла читаются ссылки нескольких следующих по индексу узлов,
+         * и все они ожидаются одним MPI_Win_flush. Пока ссылки указывают на следующий по индексу
+         * узел, цепочка продолжается без новых ожиданий, а при неудачном предсказании чтение
+         * продолжается с настоящего следующего узла меньшими пачками.
          */
-        MPI_Win_lock(MPI_LOCK_SHARED, nodeAddress.rank, MPI_MODE_NOCHECK, m_nodesWin);
-        do
+        constexpr size_t maxReadBatchSize{16};
+        std::array<uint32_t, maxReadBatchSize> nextFreeIndices{};
+        size_t readBatchSize{maxReadBatchSize};
+
+        if (m_freeListBackoff)
+            m_freeListBackoff->reset();
+
+        size_t acquiredCount{0};
+        for (;;)
         {
-            countedNodePtrNext = resHeadCountedNodePtr;
-            MPI_Put(&countedNodePtrNext,
-                    1,
-                    MPI_UINT64_T,
-                    nodeAddress.rank,
-                    countedNodePtrNextOffset,
-                    1,
-                    MPI_UINT64_T,
-                    m_nodesWin
-            );
-            MPI_Win_flush(nodeAddress.rank, m_nodesWin);
+            if (resFreeListHead.index == FreeListEndIndex)
+            {
+                RMA_STACK_TRACE(m_logger, "free list of rank {} is empty in 'acquireNodesFromFreeList'", rank);
+                break;
+            }
+
+            /*
+             * Если за время чтения индексов следующих свободных узлов голова
+             * списка изменилась, то тег головы тоже изменился, и CAS не выполнится,
+             * даже если прочитанные индексы уже не актуальны.
+             */
+            uint32_t nextFreeIndex = resFreeListHead.index;
+            size_t chainLength{0};
+            while (chainLength < maxCount && nextFreeIndex != FreeListEndIndex && nextFreeIndex < segmentNodesNum)
+            {
+                const auto readCount = std::min({readBatchSize, maxCount - chainLength, segmentNodesNum - nextFreeIndex});
+                for (size_t i = 0; i < readCount; ++i)
+                {
+                    m_intraNodeNodesWin.fetchAndOp(nullptr,
+                                                   &nextFreeIndices[i],
+                                                   MPI_UINT32_T,
+                                                   rank,
+                                                   getNodeOffset(rank, segmentNodeOffset | (nextFreeIndex + i)),
+                                                   MPI_NO_OP,
+                                                   m_nodesWin
+                    );
+                }
+                m_intraNodeNodesWin.flush(rank, m_nodesWin);
+
+                size_t linkedCount{0};
+                while (linkedCount < readCount)
+                {
+                    const auto nodeIndex = static_cast<uint32_t>(nextFreeIndex + linkedCount);
+                    pNodeAddresses[chainLength] = {segmentNodeOffset | nodeIndex, static_cast<uint64_t>(rank), 0};
+                    ++chainLength;
+                    ++linkedCount;
+                    if (nextFreeIndices[linkedCount - 1] != nodeIndex + 1)
+                        break;
+                }
+                nextFreeIndex = nextFreeIndices[linkedCount - 1];
+                readBatchSize = linkedCount == readCount
+                        ? std::min(readBatchSize * 2, maxReadBatchSize)
+                        : std::max<size_t>(linkedCount, 1);
+            }
 
-            oldHeadCountedNodePtr = resHeadCountedNodePtr;
+            FreeListHead oldFreeListHead = resFreeListHead;
+            FreeListHead newFreeListHead{nextFreeIndex, oldFreeListHead.tag + 1u};
 
-            MPI_Compare_and_swap(&newCountedNodePtr,
-                                 &oldHeadCountedNodePtr,
-                                 &resHeadCountedNodePtr,
-                                 MPI_UINT64_T,
-                                 HEAD_RANK,
-                                 m_headAddress,
-                                 m_headWin
+            m_intraNodeNodesWin.compareAndSwap(&newFreeListHead,
+                                               &oldFreeListHead,
+                                               &resFreeListHead,
+                                               MPI_UINT64_T,
+                                               rank,
+                                               freeListHeadOffset,
+                                               m_nodesWin
             );
-            MPI_Win_flush(HEAD_RANK, m_headWin);
+            m_intraNodeNodesWin.flush(rank, m_nodesWin);
 
-            if (resHeadCountedNodePtr != oldHeadCountedNodePtr)
+            if (resFreeListHead.index == oldFreeListHead.index && resFreeListHead.tag == oldFreeListHead.tag)
             {
-                m_logger->trace("started to execute backoff callback");
-                backoffCallback();
-                m_logger->trace("executed backoff callback");
+                acquiredCount = chainLength;
+                break;
             }
+            backoffFreeList();
         }
-        while (resHeadCountedNodePtr != oldHeadCountedNodePtr);
 
-        MPI_Win_unlock(HEAD_RANK, m_headWin);
-        MPI_Win_unlock(nodeAddress.rank, m_nodesWin);
+        if (m_options.elasticNodePool && acquiredCount > 0)
+            addNodeSegmentUsedCount(rank, slot, static_cast<int64_t>(acquiredCount));
 
-        m_logger->trace("finished 'push'");
+        RMA_STACK_TRACE(m_logger, "finished 'acquireNodesFromFreeList'");
+        return acquiredCount;
     }
 
-    GlobalAddress InnerStack::acquireNode(int rank) const
+    /*
+     * Узлы связываются в цепочку, которая возвращается в список свободных
+     * узлов процесса, которому они принадлежат, одной операцией CAS.
+     * В растущем пуле узлы возвращаются в списки своих сегментов, после чего
+     * уменьшаются счётчики занятых узлов этих сегментов, см. addNodeSegmentUsedCount.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::releaseNodesToFreeList(const GlobalAddress *pNodeAddresses, size_t count)
     {
-        m_logger->trace("started 'acquireNode'");
-        GlobalAddress nodeGlobalAddress = {0, DummyRank, 0};
+        if (!m_options.elasticNodePool)
+        {
+            releaseNodesToSegmentFreeList(pNodeAddresses, count);
+            return;
+        }
 
-        if (!isValidRank(rank))
+        // Как правило, все узлы принадлежат одному сегменту, и упорядочивать их не нужно.
+        const auto firstSlot = NodeSegmentLayout::getSlot(pNodeAddresses[0].offset);
+        const bool singleSegment = std::all_of(pNodeAddresses, pNodeAddresses + count, [firstSlot](GlobalAddress nodeAddress) {
+            return NodeSegmentLayout::getSlot(nodeAddress.offset) == firstSlot;
+        });
+        if (!singleSegment)
         {
-            m_logger->trace("finished 'acquireNode'");
-            return nodeGlobalAddress;
+            m_releaseNodeAddresses.assign(pNodeAddresses, pNodeAddresses + count);
+            std::sort(m_releaseNodeAddresses.begin(), m_releaseNodeAddresses.end(), [](GlobalAddress lhs, GlobalAddress rhs) {
+                return NodeSegmentLayout::getSlot(lhs.offset) < NodeSegmentLayout::getSlot(rhs.offset);
+            });
+            pNodeAddresses = m_releaseNodeAddresses.data();
         }
 
-        std::random_device rd;
-        std::mt19937 mt(rd());
+        // Накопленные ранее возвраты узлов процесса rank завершаются вместе с возвратом этих узлов.
+        const int rank = static_cast<int>(pNodeAddresses[0].rank);
+        if (rank != m_rank)
+            startNodeSegmentReleasesPublication(rank);
+
+        size_t beginIdx{0};
+        while (beginIdx < count)
+        {
+            const auto slot = NodeSegmentLayout::getSlot(pNodeAddresses[beginIdx].offset);
+            auto endIdx = beginIdx + 1;
+            while (endIdx < count && NodeSegmentLayout::getSlot(pNodeAddresses[endIdx].offset) == slot)
+                ++endIdx;
+
+            releaseNodesToSegmentFreeList(pNodeAddresses + beginIdx, endIdx - beginIdx);
+            addNodeSegmentUsedCount(rank, slot, -static_cast<int64_t>(endIdx - beginIdx));
+            beginIdx = endIdx;
+        }
+    }
 
-        std::uniform_int_distribution<int> dist(0, static_cast<int>(m_elemsUpLimit - 1));
+    // Все узлы должны принадлежать одному сегменту пула узлов одного процесса.
+    template<typename Layout>
+    void InnerStack<Layout>::releaseNodesToSegmentFreeList(const GlobalAddress *pNodeAddresses, size_t count)
+    {
+        const int rank = static_cast<int>(pNodeAddresses[0].rank);
+        {
+            const auto o = pNodeAddresses[0].offset;
+            RMA_STACK_TRACE(m_logger, "started to release {} nodes (rank - {}, offset - {}, ...)", count, rank, o);
+        }
 
-        MPI_Win_lock(MPI_LOCK_SHARED, rank, MPI_MODE_NOCHECK, m_nodesWin);
+        const MPI_Aint freeListHeadOffset = getFreeListHeadOffset(rank, pNodeAddresses[0].offset);
 
-        /* Поиск свободного адреса работает слишком медленно,
-         * если искать его без случайного выбора, поэтому сначала
-         * производится несколько попыток угадать, какой адрес не
-         * занят. Если угадать не удалось, тогда сканируется весь
-         * массив адресов.
-         */
-        bool foundFreeNodeRandomly{false};
-        const auto randomTriesNumber = static_cast<MPI_Aint>(std::floor((double)m_elemsUpLimit * 0.05));
-        for (MPI_Aint i = 0; i < randomTriesNumber; ++i)
-        {
-            const auto idx = static_cast<MPI_Aint>(dist(mt));
-            const auto nodeDisplacement = idx * static_cast<MPI_Aint>(sizeof(Node));
-            const MPI_Aint nodeOffset = MPI_Aint_add(m_pBaseNodeArrAddresses[rank], nodeDisplacement);
-
-            uint32_t newAcquiredField{1};
-            uint32_t oldAcquiredField{0};
-            uint32_t resAcquiredField{0};
-
-            MPI_Compare_and_swap(&newAcquiredField,
-                                 &oldAcquiredField,
-                                 &resAcquiredField,
-                                 MPI_UINT32_T,
-                                 rank,
-                                 nodeOffset,
-                                 m_nodesWin
+        if (m_releaseNextFreeIndices.size() < count)
+            m_releaseNextFreeIndices.resize(count);
+        for (size_t i = 0; i + 1 < count; ++i)
+        {
+            m_releaseNextFreeIndices[i] = static_cast<uint32_t>(getNodeIndex(pNodeAddresses[i + 1].offset));
+            m_intraNodeNodesWin.accumulate(&m_releaseNextFreeIndices[i],
+                                           1,
+                                           MPI_UINT32_T,
+                                           rank,
+                                           getNodeOffset(rank, pNodeAddresses[i].offset),
+                                           1,
+                                           MPI_UINT32_T,
+                                           MPI_REPLACE,
+                                           m_nodesWin
             );
-            MPI_Win_flush(rank, m_nodesWin);
+        }
+
+        FreeListHead resFreeListHead{FreeListEndIndex, 0};
+        m_intraNodeNodesWin.fetchAndOp(nullptr,
+                                       &resFreeListHead,
+                                       MPI_UINT64_T,
+                                       rank,
+                                       freeListHeadOffset,
+                                       MPI_NO_OP,
+                                       m_nodesWin
+        );
+        m_intraNodeNodesWin.flush(rank, m_nodesWin);
 
-            m_logger->trace("resAcquiredField = {} of (rank - {}, offset - {}) in 'acquireNode'",
-                            resAcquiredField,
-                            rank,
-                            i
+        const MPI_Aint tailNodeOffset = getNodeOffset(rank, pNodeAddresses[count - 1].offset);
+        const auto headNodeIndex = getNodeIndex(pNodeAddresses[0].offset);
+        if (m_freeListBackoff)
+            m_freeListBackoff->reset();
+        FreeListHead oldFreeListHead{FreeListEndIndex, 0};
+        for (;;)
+        {
+            oldFreeListHead = resFreeListHead;
+
+            uint32_t nextFreeIndex = oldFreeListHead.index;
+            uint32_t resNextFreeIndex{0};
+            m_intraNodeNodesWin.fetchAndOp(&nextFreeIndex,
+                                           &resNextFreeIndex,
+                                           MPI_UINT32_T,
+                                           rank,
+                                           tailNodeOffset,
+                                           MPI_REPLACE,
+                                           m_nodesWin
             );
-            assert(resAcquiredField == 0 || resAcquiredField == 1);
-            if (!resAcquiredField)
-            {
-                nodeGlobalAddress.rank = rank;
-                nodeGlobalAddress.offset = idx;
-                foundFreeNodeRandomly = true;
+            m_intraNodeNodesWin.flush(rank, m_nodesWin);
+
+            FreeListHead newFreeListHead{headNodeIndex, oldFreeListHead.tag + 1u};
+            m_intraNodeNodesWin.compareAndSwap(&newFreeListHead,
+                                               &oldFreeListHead,
+                                               &resFreeListHead,
+                                               MPI_UINT64_T,
+                                               rank,
+                                               freeListHeadOffset,
+                                               m_nodesWin
+            );
+            m_intraNodeNodesWin.flush(rank, m_nodesWin);
+
+            if (resFreeListHead.index == oldFreeListHead.index && resFreeListHead.tag == oldFreeListHead.tag)
                 break;
-            }
+            backoffFreeList();
         }
-        if (!foundFreeNodeRandomly)
+
+        RMA_STACK_TRACE(m_logger, "released {} nodes of rank {}", count, rank);
+    }
+
+    /*
+     * Новый сегмент выделяется в первом свободном слоте, присоединяется к окну узлов
+     * и публикуется в таблице сегментов до того, как адреса его узлов попадут в стек.
+     */
+    template<typename Layout>
+    bool InnerStack<Layout>::growNodePool()
+    {
+        size_t slot{1};
+        while (slot < NodeSegmentLayout::SlotsNum
+               && (m_nodeSegments[slot].active || m_nodeSegments[slot].retired || m_nodeSegments[slot].detaching))
+            ++slot;
+        if (slot == NodeSegmentLayout::SlotsNum)
         {
-            for (MPI_Aint i = 0; i < static_cast<MPI_Aint>(m_elemsUpLimit); ++i)
-            {
-                constexpr auto nodeSize = static_cast<MPI_Aint>(sizeof(Node));
-                const auto nodeDisplacement = i * nodeSize;
-                const MPI_Aint nodeOffset = MPI_Aint_add(m_pBaseNodeArrAddresses[rank], nodeDisplacement);
-
-                uint32_t newAcquiredField{1};
-                uint32_t oldAcquiredField{0};
-                uint32_t resAcquiredField{0};
-
-                MPI_Compare_and_swap(&newAcquiredField,
-                                     &oldAcquiredField,
-                                     &resAcquiredField,
-                                     MPI_UINT32_T,
-                                     rank,
-                                     nodeOffset,
-                                     m_nodesWin
-                );
-                MPI_Win_flush(rank, m_nodesWin);
+            RMA_STACK_TRACE(m_logger, "node pool cannot grow, all segment slots are used");
+            return false;
+        }
 
-                m_logger->trace("resAcquiredField = {} of (rank - {}, offset - {}) in 'acquireNode'",
-                                resAcquiredField,
-                                rank,
-                                i
-                );
-                assert(resAcquiredField == 0 || resAcquiredField == 1);
-                if (!resAcquiredField)
-                {
-                    nodeGlobalAddress.rank = rank;
-                    nodeGlobalAddress.offset = i;
-                    break;
-                }
-            }
+        auto &rSegment = m_nodeSegments[slot];
+        const auto segmentSize = getNodeSegmentSize(m_nodeSegmentSize);
+        {
+            auto mpiStatus = MPI_Alloc_mem(segmentSize, MPI_INFO_NULL, &rSegment.pMemory);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to allocate RMA memory", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        initNodeSegment(rSegment.pMemory, m_nodeSegmentSize);
+        {
+            auto mpiStatus = MPI_Win_attach(m_nodesWin, rSegment.pMemory, segmentSize);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        MPI_Get_address(rSegment.pMemory, &rSegment.baseAddress);
+        rSegment.nodesNum = m_nodeSegmentSize;
+        rSegment.active = true;
+
+        m_pNodeSegmentTable[slot] = {rSegment.baseAddress, rSegment.generation};
+        m_pNodeSegmentUsedCounts[slot] = 0;
+        rSegment.usedCount = 0;
+        MPI_Win_sync(m_nodesWin);
+
+        ++m_statistics.nodeSegmentGrowthsNum;
+        RMA_STACK_TRACE(m_logger, "node pool grew by segment {} of generation {}", slot, rSegment.generation);
+        return true;
+    }
+
+    /*
+     * Освобождается только последний активный сегмент, если ни один его узел не занят
+     * и в остальных сегментах свободна хотя бы половина его узлов, чтобы пул не
+     * освобождал и не выделял сегмент на каждой операции.
+     * Узлы захватывает только процесс-владелец, поэтому нулевой счётчик не может
+     * увеличиться во время освобождения сегмента.
+     * Операции, которые читают цепочку узлов под защищённой вершиной, могли прочитать адрес узла
+     * сегмента до его освобождения, поэтому сегмент отсоединяется от окна, только когда каждый
+     * процесс, находившийся в операции в момент освобождения, сменит эпоху. Операции, начатые позже,
+     * узлов сегмента не встретят: все они были свободны, а поколение сегмента входит в смещения узлов.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::tryShrinkNodePool()
+    {
+        detachNodeSegments();
+
+        size_t slot{NodeSegmentLayout::SlotsNum - 1};
+        while (slot > 0 && !m_nodeSegments[slot].active)
+            --slot;
+        if (slot == 0)
+            return;
+
+        auto &rSegment = m_nodeSegments[slot];
+        if (getNodeSegmentUsedCount(slot) != 0)
+            return;
+
+        int64_t freeNodesNum{0};
+        for (size_t i = 0; i < slot; ++i)
+        {
+            if (m_nodeSegments[i].active)
+                freeNodesNum += static_cast<int64_t>(m_nodeSegments[i].nodesNum) - getNodeSegmentUsedCount(i);
         }
+        if (freeNodesNum < static_cast<int64_t>(rSegment.nodesNum / 2))
+            return;
 
-        MPI_Win_unlock(rank, m_nodesWin);
+        rSegment.active = false;
+        rSegment.detaching = true;
+        readEpochs(rSegment.detachEpochs);
+        RMA_STACK_TRACE(m_logger, "node segment {} is waiting to be detached", slot);
 
-        m_logger->trace("finished 'acquireNode'");
-        return nodeGlobalAddress;
+        detachNodeSegments();
     }
 
-    void InnerStack::releaseNode(GlobalAddress nodeAddress) const
+    // Отсоединение освобождённых сегментов, для которых сменились эпохи всех процессов.
+    template<typename Layout>
+    void InnerStack<Layout>::detachNodeSegments()
     {
-        constexpr auto nodeSize = sizeof(Node);
-        const auto nodeDisplacement = static_cast<MPI_Aint>(nodeAddress.offset * nodeSize);
-        const MPI_Aint nodeOffset = MPI_Aint_add(m_pBaseNodeArrAddresses[nodeAddress.rank],
-                                                 nodeDisplacement
-        );
-        int32_t acquiredField{1};
-        int32_t acquiredField1{acquiredField};
-        {
-            const auto r = nodeAddress.rank;
-            const auto o = nodeAddress.offset;
-            m_logger->trace("started to release node (rank - {}, offset - {})", r, o);
-        }
-        const MPI_Aint countedNodePtrOffset = nodeOffset + 8;
-        CountedNodePtr dummyCountedNodePtr;
-        MPI_Put(&dummyCountedNodePtr,
-            1,
-            MPI_UINT64_T,
-            nodeAddress.rank,
-            countedNodePtrOffset,
-            1,
-            MPI_UINT64_T,
-            m_nodesWin
-        );
-        MPI_Fetch_and_op(&acquiredField,
-                         &acquiredField1,
-                         MPI_UINT32_T,
-                         nodeAddress.rank,
-                         nodeOffset,
-                         MPI_REPLACE,
-                         m_nodesWin
-        );
-        MPI_Win_flush(nodeAddress.rank, m_nodesWin);
+        bool epochsRead{false};
+        for (size_t slot = 1; slot < NodeSegmentLayout::SlotsNum; ++slot)
         {
-            const auto r = nodeAddress.rank;
-            const auto o = nodeAddress.offset;
-            m_logger->trace("released node (rank - {}, offset - {})", r, o);
+            if (!m_nodeSegments[slot].detaching)
+                continue;
+
+            if (!epochsRead)
+            {
+                readEpochs(m_epochsSnapshot);
+                epochsRead = true;
+            }
+            if (haveEpochsPassed(m_nodeSegments[slot].detachEpochs, m_epochsSnapshot))
+                detachNodeSegment(slot);
         }
     }
 
-    void InnerStack::pop(const std::function<void(GlobalAddress)> &getDataCallback,
-                         const std::function<void()> &backoffCallback)
+    template<typename Layout>
+    void InnerStack<Layout>::detachNodeSegment(size_t slot)
     {
-        m_logger->trace("started 'pop'");
+        auto &rSegment = m_nodeSegments[slot];
+        m_pNodeSegmentTable[slot] = {0, rSegment.generation};
+        MPI_Win_sync(m_nodesWin);
+        {
+            auto mpiStatus = MPI_Win_detach(m_nodesWin, rSegment.pMemory);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to detach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        MPI_Free_mem(rSegment.pMemory);
+        rSegment.pMemory = nullptr;
+        rSegment.baseAddress = 0;
+        rSegment.detaching = false;
 
-        CountedNodePtr oldHeadCountedNodePtr;
+        // Поколение входит в смещения узлов, поэтому после исчерпания поколений слот больше не используется.
+        if (++rSegment.generation == NodeSegmentLayout::GenerationsNum)
+            rSegment.retired = true;
 
-        // Чтение текущей головы односвязного списка.
-        MPI_Win_lock(MPI_LOCK_SHARED, HEAD_RANK, MPI_MODE_NOCHECK, m_headWin);
-        MPI_Fetch_and_op(nullptr,
-                         &oldHeadCountedNodePtr,
-                         MPI_UINT64_T,
-                         HEAD_RANK,
-                         m_headAddress,
-                         MPI_NO_OP,
-                         m_headWin
-        );
-        MPI_Win_flush(HEAD_RANK, m_headWin);
+        ++m_statistics.nodeSegmentShrinksNum;
+        RMA_STACK_TRACE(m_logger, "node pool shrank by segment {}", slot);
+    }
 
+    /*
+     * Счётчик занятых узлов сегмента складывается из локального счётчика владельца, который учитывает
+     * захваты и возвраты самого владельца, и счётчика в окне узлов, из которого другие процессы вычитают
+     * возвращённые ими узлы. Узлы растущего пула захватывает только владелец, поэтому захват не требует
+     * обращений к памяти. Другие процессы накапливают возвраты и отправляют их без отдельного ожидания
+     * вместе со следующим возвратом узлов тому же процессу, а раз в nodeSegmentReleasesPublishPeriod
+     * возвратов - все накопленные одним ожиданием. Неотправленные возвраты только завышают счётчик,
+     * поэтому сегмент с занятыми узлами не может быть освобождён.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::addNodeSegmentUsedCount(int rank, size_t slot, int64_t countIncrease)
+    {
+        if (rank == m_rank)
         {
-            const auto r = oldHeadCountedNodePtr.getRank();
-            const auto o = oldHeadCountedNodePtr.getOffset();
-            const auto e = oldHeadCountedNodePtr.getExternalCounter();
-            m_logger->trace("fetched head (rank - {}, offset - {}, ext_cnt - {}) before loop in 'pop'", r, o, e);
+            m_nodeSegments[slot].usedCount += countIncrease;
+            return;
         }
-        for (;;)
+
+        m_pendingNodeSegmentReleases[static_cast<size_t>(rank) * NodeSegmentLayout::SlotsNum + slot] += countIncrease;
+        constexpr size_t nodeSegmentReleasesPublishPeriod{64};
+        if (++m_nodeSegmentReleasesNum >= nodeSegmentReleasesPublishPeriod)
+            publishNodeSegmentReleases();
+    }
+
+    // Начало отправки накопленных возвратов узлов сегментов процесса rank, завершается ожиданием окна узлов.
+    template<typename Layout>
+    void InnerStack<Layout>::startNodeSegmentReleasesPublication(int rank)
+    {
+        const auto beginIdx = static_cast<size_t>(rank) * NodeSegmentLayout::SlotsNum;
+        for (size_t slot = 0; slot < NodeSegmentLayout::SlotsNum; ++slot)
+        {
+            auto &rPendingReleases = m_pendingNodeSegmentReleases[beginIdx + slot];
+            if (rPendingReleases == 0)
+                continue;
+
+            auto &rPublishedReleases = m_publishedNodeSegmentReleases[beginIdx + slot];
+            rPublishedReleases = rPendingReleases;
+            rPendingReleases = 0;
+            m_intraNodeNodesWin.accumulate(&rPublishedReleases,
+                                           1,
+                                           MPI_INT64_T,
+                                           rank,
+                                           getNodeSegmentUsedCountOffset(rank, slot),
+                                           1,
+                                           MPI_INT64_T,
+                                           MPI_SUM,
+                                           m_nodesWin
+            );
+        }
+    }
+
+    // Растущий пул требует persistentLockAll, поэтому окно узлов не захватывается.
+    template<typename Layout>
+    void InnerStack<Layout>::publishNodeSegmentReleases()
+    {
+        m_nodeSegmentReleasesNum = 0;
+        for (int rank = 0; rank < m_procNum; ++rank)
+        {
+            if (rank != m_rank)
+                startNodeSegmentReleasesPublication(rank);
+        }
+        m_intraNodeNodesWin.flushAll(m_nodesWin);
+    }
+
+    template<typename Layout>
+    int64_t InnerStack<Layout>::getNodeSegmentUsedCount(size_t slot) const
+    {
+        int64_t usedCount{0};
+        m_intraNodeNodesWin.fetchAndOp(nullptr,
+                                       &usedCount,
+                                       MPI_INT64_T,
+                                       m_rank,
+                                       getNodeSegmentUsedCountOffset(m_rank, slot),
+                                       MPI_NO_OP,
+                                       m_nodesWin
+        );
+        m_intraNodeNodesWin.flush(m_rank, m_nodesWin);
+        return m_nodeSegments[slot].usedCount + usedCount;
+    }
+
+    /*
+     * Узлы захватываются установкой свободных битов в битовой карте процесса rank
+     * операцией MPI_Fetch_and_op с MPI_BOR: одна операция пытается захватить до maxCount
+     * узлов одного слова, а результат операции содержит всё слово, поэтому при неудаче
+     * следующие свободные биты выбираются без дополнительного чтения.
+     * Если процесс rank - текущий, то незаполненное слово ищется векторным просмотром
+     * локальной памяти, иначе слова проверяются последовательно, начиная с последнего
+     * слова, в котором удалось захватить узел.
+     */
+    template<typename Layout>
+    size_t InnerStack<Layout>::acquireNodesFromBitmap(int rank, size_t maxCount, GlobalAddress *pNodeAddresses)
+    {
+        RMA_STACK_TRACE(m_logger, "started 'acquireNodesFromBitmap'");
+
+        const auto wordsNum = getNodeBitmapWordsNum(m_elemsUpLimit);
+        const MPI_Aint nodeBitmapOffset = getNodeBitmapOffset(rank);
+        /*
+         * Локальная копия битовой карты используется только как подсказка,
+         * захват узла всегда выполняется атомарной операцией MPI.
+         */
+        const uint64_t *pLocalWords = rank == m_rank ? m_pNodeBitmap : nullptr;
+
+        size_t wordIdx = (rank == m_bitmapHintRank && m_bitmapWordHint < wordsNum) ? m_bitmapWordHint : 0;
+        size_t acquiredCount{0};
+
+        for (size_t visitedWordsNum = 0; visitedWordsNum < wordsNum && acquiredCount == 0;)
         {
-            // Увеличение кол-во внешних ссылок на голову на 1.
-            increaseHeadCount(oldHeadCountedNodePtr);
+            uint64_t word{0};
+            if (pLocalWords != nullptr)
             {
-                const auto r = oldHeadCountedNodePtr.getRank();
-                const auto o = oldHeadCountedNodePtr.getOffset();
-                const auto e = oldHeadCountedNodePtr.getExternalCounter();
-                m_logger->trace("head (rank - {}, offset - {}, ext_cnt - {})) after increaseHeadCount in 'pop'", r, o, e);
+                const auto notFullWordIdx = findFirstNotFullWord(pLocalWords, wordIdx, wordsNum);
+                if (notFullWordIdx == wordsNum)
+                {
+                    visitedWordsNum += wordsNum - wordIdx;
+                    wordIdx = 0;
+                    continue;
+                }
+                visitedWordsNum += notFullWordIdx - wordIdx;
+                wordIdx = notFullWordIdx;
+                word = pLocalWords[wordIdx];
             }
-            GlobalAddress nodeAddress = {
-                    oldHeadCountedNodePtr.getOffset(),
-                    oldHeadCountedNodePtr.getRank(),
-                    0
-            };
-            if (isGlobalAddressDummy(nodeAddress))
+            else if (rank == m_bitmapHintRank && wordIdx == m_bitmapWordHint)
             {
-                /*
-                 * Если глобальный указатель указывает на NULL, то стек пуст,
-                 * и нужно сообщить об этом пользователю, а затем завершить POP.
-                 */
-                getDataCallback(nodeAddress);
-                break;
+                word = m_bitmapWordCache;
             }
 
-            /*
-             * Получение указателя на следующий за головой списка узел
-             * с последующей заменой головы на этот узел операцией CAS.
-             */
-            CountedNodePtr countedNodePtrNext;
+            const MPI_Aint wordOffset = MPI_Aint_add(nodeBitmapOffset, static_cast<MPI_Aint>(wordIdx * sizeof(uint64_t)));
+            while (word != NodeBitmapFullWord)
+            {
+                uint64_t mask{0};
+                for (size_t i = 0; i < maxCount && (word | mask) != NodeBitmapFullWord; ++i)
+                    mask |= uint64_t{1} << findFirstZeroBit(word | mask);
+
+                uint64_t resWord{0};
+                m_intraNodeNodesWin.fetchAndOp(&mask,
+                                               &resWord,
+                                               MPI_UINT64_T,
+                                               rank,
+                                               wordOffset,
+                                               MPI_BOR,
+                                               m_nodesWin
+                );
+                m_intraNodeNodesWin.flush(rank, m_nodesWin);
 
-            const auto nodeDisplacement             = static_cast<MPI_Aint>(nodeAddress.offset * sizeof(Node) + sizeof(CountedNodePtr));
-            const MPI_Aint countedNodePtrNextOffset = MPI_Aint_add(m_pBaseNodeArrAddresses[nodeAddress.rank], nodeDisplacement);
+                uint64_t acquiredMask = mask & ~resWord;
+                while (acquiredMask != 0)
+                {
+                    const auto bit = static_cast<uint64_t>(__builtin_ctzll(acquiredMask));
+                    acquiredMask &= acquiredMask - 1;
+                    pNodeAddresses[acquiredCount] = {wordIdx * NodeBitmapWordBits + bit, static_cast<uint64_t>(rank), 0};
+                    ++acquiredCount;
+                }
 
-            MPI_Win_lock(MPI_LOCK_SHARED, nodeAddress.rank, MPI_MODE_NOCHECK, m_nodesWin);
-            MPI_Fetch_and_op(nullptr,
-                             &countedNodePtrNext,
-                             MPI_UINT64_T,
-                             nodeAddress.rank,
-                             countedNodePtrNextOffset,
-                             MPI_NO_OP,
-                             m_nodesWin
-            );
-            MPI_Win_flush(nodeAddress.rank, m_nodesWin);
+                word = resWord | mask;
+                if (acquiredCount > 0)
+                {
+                    m_bitmapHintRank = rank;
+                    m_bitmapWordHint = wordIdx;
+                    m_bitmapWordCache = word;
+                    break;
+                }
+            }
 
+            if (acquiredCount == 0)
             {
-                const auto r = countedNodePtrNext.getRank();
-                const auto o = countedNodePtrNext.getOffset();
-                const auto e = countedNodePtrNext.getExternalCounter();
-                m_logger->trace("ptr->next (rank - {}, offset - {}, ext_cnt - {})) in 'pop'", r, o, e);
+                ++visitedWordsNum;
+                wordIdx = (wordIdx + 1) % wordsNum;
             }
+        }
+
+        if (acquiredCount == 0)
+            RMA_STACK_TRACE(m_logger, "bitmap of rank {} is full in 'acquireNodesFromBitmap'", rank);
+
+        RMA_STACK_TRACE(m_logger, "finished 'acquireNodesFromBitmap'");
+        return acquiredCount;
+    }
+
+    // Биты узлов одного слова сбрасываются одной атомарной операцией MPI_BAND.
+    template<typename Layout>
+    void InnerStack<Layout>::releaseNodesToBitmap(const GlobalAddress *pNodeAddresses, size_t count)
+    {
+        const int rank = static_cast<int>(pNodeAddresses[0].rank);
+        {
+            const auto o = pNodeAddresses[0].offset;
+            RMA_STACK_TRACE(m_logger, "started to release {} nodes (rank - {}, offset - {}, ...)", count, rank, o);
+        }
+
+        const MPI_Aint nodeBitmapOffset = getNodeBitmapOffset(rank);
 
-            CountedNodePtr resHeadCountedNodePtr;
+        // Маски узлов упорядочиваются по словам, и маски одного слова объединяются за один проход.
+        auto &rWordMasks = m_bitmapReleaseWordMasks;
+        rWordMasks.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto wordIdx = static_cast<size_t>(pNodeAddresses[i].offset / NodeBitmapWordBits);
+            const uint64_t bitMask = uint64_t{1} << (pNodeAddresses[i].offset % NodeBitmapWordBits);
+            rWordMasks[i] = {wordIdx, ~bitMask};
+        }
+        std::sort(rWordMasks.begin(), rWordMasks.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.first < rhs.first;
+        });
+        size_t wordsNum{0};
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (wordsNum > 0 && rWordMasks[wordsNum - 1].first == rWordMasks[i].first)
+                rWordMasks[wordsNum - 1].second &= rWordMasks[i].second;
+            else
+                rWordMasks[wordsNum++] = rWordMasks[i];
+        }
+        rWordMasks.resize(wordsNum);
 
-            MPI_Compare_and_swap(&countedNodePtrNext,
-                                 &oldHeadCountedNodePtr,
-                                 &resHeadCountedNodePtr,
-                                 MPI_UINT64_T,
-                                 HEAD_RANK,
-                                 m_headAddress,
-                                 m_headWin
+        m_bitmapReleaseResWords.resize(wordsNum);
+        for (size_t i = 0; i < wordsNum; ++i)
+        {
+            const MPI_Aint wordOffset = MPI_Aint_add(nodeBitmapOffset,
+                                                     static_cast<MPI_Aint>(rWordMasks[i].first * sizeof(uint64_t))
             );
-            MPI_Win_flush(HEAD_RANK, m_headWin);
+            m_intraNodeNodesWin.fetchAndOp(&rWordMasks[i].second,
+                                           &m_bitmapReleaseResWords[i],
+                                           MPI_UINT64_T,
+                                           rank,
+                                           wordOffset,
+                                           MPI_BAND,
+                                           m_nodesWin
+            );
+        }
+        m_intraNodeNodesWin.flush(rank, m_nodesWin);
 
-            bool popComplete{false};
-            if (resHeadCountedNodePtr == oldHeadCountedNodePtr)
-            {
-                getDataCallback(nodeAddress);
+        RMA_STACK_TRACE(m_logger, "released {} nodes of rank {}", count, rank);
+    }
 
-                const auto internalCounterDisplacement  = static_cast<MPI_Aint>(nodeAddress.offset * sizeof(Node) + sizeof(int32_t));
-                const auto internalCounterOffset        = MPI_Aint_add(m_pBaseNodeArrAddresses[nodeAddress.rank],
-                                                                       internalCounterDisplacement
-                );
+    // Голова списка свободных узлов расположена сразу за узлами сегмента, которому принадлежит узел nodeOffset.
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getFreeListHeadOffset(int rank, uint64_t nodeOffset) const
+    {
+        const auto segmentNodesNum = m_options.elasticNodePool
+                ? getNodeSegmentNodesNum(NodeSegmentLayout::getSlot(nodeOffset))
+                : m_elemsUpLimit;
+        const auto freeListHeadDisplacement = static_cast<MPI_Aint>(segmentNodesNum * m_nodeSize);
+        return MPI_Aint_add(getNodeSegmentBaseAddress(rank, nodeOffset), freeListHeadDisplacement);
+    }
 
-                const auto externalCount    = static_cast<int32_t>(oldHeadCountedNodePtr.getExternalCounter());
-                const int32_t countIncrease = externalCount - 2;
-                int32_t resInternalCount{0};
-                // Атомарное уменьшение внутреннего счётчика на кол-во внешних ссылок минус 2.
-                MPI_Fetch_and_op(
-                        &countIncrease,
-                        &resInternalCount,
-                        MPI_INT32_T,
-                        nodeAddress.rank,
-                        internalCounterOffset,
-                        MPI_SUM,
-                        m_nodesWin
-                );
-                MPI_Win_flush(nodeAddress.rank, m_nodesWin);
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeBitmapOffset(int rank) const
+    {
+        const auto nodeBitmapDisplacement = static_cast<MPI_Aint>(m_elemsUpLimit * m_nodeSize + sizeof(FreeListHead));
+        return MPI_Aint_add(getNodeArrBaseAddress(rank), nodeBitmapDisplacement);
+    }
 
-                if (resInternalCount == -countIncrease)
-                    releaseNode(nodeAddress);
+    /*
+     * За массивом узлов в той же памяти располагается голова списка свободных узлов,
+     * а за ней - битовая карта занятости узлов, если она используется.
+     */
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodesArrSize() const
+    {
+        const auto nodeBitmapWordsNum = m_options.nodeAllocatorType == NodeAllocatorType::Bitmap
+                ? getNodeBitmapWordsNum(m_elemsUpLimit)
+                : 0;
+        return static_cast<MPI_Aint>(m_nodeSize * m_elemsUpLimit + sizeof(FreeListHead)
+                + sizeof(uint64_t) * nodeBitmapWordsNum);
+    }
 
-                popComplete = true;
-            }
-            else
-            {
-                const auto internalCounterDisplacement  = static_cast<MPI_Aint>(nodeAddress.offset * sizeof(Node) + sizeof(int32_t));
-                const auto internalCounterOffset        = MPI_Aint_add(m_pBaseNodeArrAddresses[nodeAddress.rank],
-                                                                       internalCounterDisplacement
-                );
-                const int64_t countIncrease{-1};
-                int64_t resInternalCount{0};
-                // Атомарное уменьшение внутреннего счётчика на 1.
-                MPI_Fetch_and_op(
-                        &countIncrease,
-                        &resInternalCount,
-                        MPI_INT32_T,
-                        nodeAddress.rank,
-                        internalCounterOffset,
-                        MPI_SUM,
-                        m_nodesWin
-                );
-                MPI_Win_flush(nodeAddress.rank, m_nodesWin);
+    // В статических окнах смещения отсчитываются от начала памяти окна каждого процесса.
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeArrBaseAddress(int rank) const
+    {
+        return m_options.staticWindows ? 0 : m_pBaseNodeArrAddresses[rank];
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getEpochBaseAddress(int rank) const
+    {
+        return m_options.staticWindows ? 0 : m_pBaseEpochAddresses[rank];
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getEliminationSlotsBaseAddress(int rank) const
+    {
+        return m_options.staticWindows ? 0 : m_pBaseEliminationSlotsAddresses[rank];
+    }
+
+    template<typename Layout>
+    uint64_t InnerStack<Layout>::getNodeIndex(uint64_t offset) const
+    {
+        return m_options.elasticNodePool ? NodeSegmentLayout::getIndex(offset) : offset;
+    }
+
+    // Все сегменты, кроме нулевого, одного размера, поэтому размер сегмента другого процесса не читается.
+    template<typename Layout>
+    size_t InnerStack<Layout>::getNodeSegmentNodesNum(size_t slot) const
+    {
+        return slot == 0 ? m_elemsUpLimit : m_nodeSegmentSize;
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeSegmentSize(size_t nodesNum) const
+    {
+        return static_cast<MPI_Aint>(m_nodeSize * nodesNum + sizeof(FreeListHead));
+    }
+
+    /*
+     * Базовый адрес сегмента другого процесса берётся из кэша и перечитывается из таблицы
+     * сегментов, если сегмент ещё не известен или поколение узла не совпадает с кэшированным.
+     */
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeSegmentBaseAddress(int rank, uint64_t offset) const
+    {
+        const auto slot = m_options.elasticNodePool ? NodeSegmentLayout::getSlot(offset) : 0;
+        if (slot == 0)
+            return getNodeArrBaseAddress(rank);
+        if (rank == m_rank)
+            return m_nodeSegments[slot].baseAddress;
+
+        const auto generation = NodeSegmentLayout::getGeneration(offset);
+        auto &rDescriptor = m_nodeSegmentTablesCache[static_cast<size_t>(rank) * NodeSegmentLayout::SlotsNum + slot];
+        if (rDescriptor.baseAddress == 0 || rDescriptor.generation != generation)
+        {
+            const auto descriptorDisplacement = static_cast<MPI_Aint>(slot * sizeof(NodeSegmentDescriptor));
+            m_intraNodeNodesWin.get(&rDescriptor,
+                                    sizeof(NodeSegmentDescriptor),
+                                    MPI_BYTE,
+                                    rank,
+                                    MPI_Aint_add(m_pBaseNodeSegmentTableAddresses[rank], descriptorDisplacement),
+                                    sizeof(NodeSegmentDescriptor),
+                                    MPI_BYTE,
+                                    m_nodesWin
+            );
+            m_intraNodeNodesWin.flush(rank, m_nodesWin);
+            if (rDescriptor.baseAddress == 0 || rDescriptor.generation != generation)
+                throw std::logic_error("the node segment of the node address is not allocated");
+        }
+        return rDescriptor.baseAddress;
+    }
+
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getNodeSegmentUsedCountOffset(int rank, size_t slot) const
+    {
+        const auto usedCountDisplacement = static_cast<MPI_Aint>(NodeSegmentLayout::SlotsNum * sizeof(NodeSegmentDescriptor)
+                + slot * sizeof(int64_t));
+        return MPI_Aint_add(m_pBaseNodeSegmentTableAddresses[rank], usedCountDisplacement);
+    }
+
+    /*
+     * Ячейки массива исключения распределены по процессам циклически:
+     * ячейка i находится на процессе i % procNum под номером i / procNum.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::chooseEliminationSlot(int &rSlotRank, MPI_Aint &rSlotOffset)
+    {
+        const auto slotsNum = m_options.eliminationArraySize;
+        const auto slotIdx = std::uniform_int_distribution<size_t>(0, slotsNum - 1)(m_eliminationRandomEngine);
+
+        rSlotRank = static_cast<int>(slotIdx % static_cast<size_t>(m_procNum));
+        const auto slotDisplacement = static_cast<MPI_Aint>(slotIdx / static_cast<size_t>(m_procNum) * sizeof(EliminationSlot));
+        rSlotOffset = MPI_Aint_add(getEliminationSlotsBaseAddress(rSlotRank), slotDisplacement);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::compareAndSwapEliminationSlot(const EliminationSlot &newSlot, const EliminationSlot &oldSlot,
+                                                   EliminationSlot &rResSlot, int slotRank, MPI_Aint slotOffset) const
+    {
+        MPI_Compare_and_swap(&newSlot,
+                             &oldSlot,
+                             &rResSlot,
+                             MPI_UINT64_T,
+                             slotRank,
+                             slotOffset,
+                             m_eliminationWin
+        );
+        MPI_Win_flush(slotRank, m_eliminationWin);
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::replaceEliminationSlot(const EliminationSlot &newSlot, int slotRank, MPI_Aint slotOffset) const
+    {
+        MPI_Accumulate(&newSlot,
+                       1,
+                       MPI_UINT64_T,
+                       slotRank,
+                       slotOffset,
+                       1,
+                       MPI_UINT64_T,
+                       MPI_REPLACE,
+                       m_eliminationWin
+        );
+        MPI_Win_flush(slotRank, m_eliminationWin);
+    }
+
+    template<typename Layout>
+    const InnerStackStatistics &InnerStack<Layout>::getStatistics() const
+    {
+        return m_statistics;
+    }
+
+    /*
+     * Доля неудачных CAS головы определяется по приращениям общих счётчиков между выборками процесса:
+     * кол-во операций процесса добавляется к счётчику операций той же операцией, которой он читается.
+     * Оценка сглаживается, чтобы одна выборка не меняла начальную задержку резко.
+     */
+    template<typename Layout>
+    double InnerStack<Layout>::sampleContentionLevel()
+    {
+        if (m_options.contentionSamplingPeriod == 0)
+            return 0.0;
+
+        if (++m_contentionOpsNum < m_options.contentionSamplingPeriod)
+            return m_contentionLevel;
+
+        const auto opsNum = static_cast<uint64_t>(m_contentionOpsNum);
+        uint64_t headOpsNum{0};
+        uint64_t headCasFailuresNum{0};
+
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(&opsNum,
+                                      &headOpsNum,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      MPI_Aint_add(m_headAddress, static_cast<MPI_Aint>(sizeof(CountedNodePtr))),
+                                      MPI_SUM,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                      &headCasFailuresNum,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      MPI_Aint_add(m_headAddress, static_cast<MPI_Aint>(sizeof(CountedNodePtr) + sizeof(uint64_t))),
+                                      MPI_NO_OP,
+                                      m_headWin
+        );
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+        m_windowSync.unlock(m_headRank, m_headWin);
+
+        headOpsNum += opsNum;
+        const auto opsIncrease = headOpsNum - m_sampledHeadOpsNum;
+        const auto casFailuresIncrease = headCasFailuresNum - m_sampledHeadCasFailuresNum;
+        if (opsIncrease > 0)
+        {
+            const auto level = static_cast<double>(casFailuresIncrease) / static_cast<double>(opsIncrease);
+            m_contentionLevel = (m_contentionLevel + level) / 2;
+        }
+        m_sampledHeadOpsNum = headOpsNum;
+        m_sampledHeadCasFailuresNum = headCasFailuresNum;
+        m_contentionOpsNum = 0;
 
-                if (resInternalCount == 1)
-                    releaseNode(nodeAddress);
-            }
-            MPI_Win_unlock(nodeAddress.rank, m_nodesWin);
+        RMA_STACK_TRACE(m_logger, "sampled contention level {}", m_contentionLevel);
+        return m_contentionLevel;
+    }
 
-            if (popComplete)
-                break;
+    template<typename Layout>
+    void InnerStack<Layout>::setFreeListBackoffDelays(const std::chrono::nanoseconds &minDelay,
+                                                      const std::chrono::nanoseconds &maxDelay)
+    {
+        m_freeListBackoff.emplace(minDelay, maxDelay);
+    }
 
-            m_logger->trace("started to execute backoff callback");
-            backoffCallback();
-            m_logger->trace("executed backoff callback");
-        }
-        MPI_Win_unlock(HEAD_RANK, m_headWin);
+    template<typename Layout>
+    void InnerStack<Layout>::backoffFreeList()
+    {
+        if (m_freeListBackoff)
+            m_freeListBackoff->backoff();
+    }
 
-        m_logger->trace("finished 'pop'");
+    /*
+     * Увеличение счётчика неудачных CAS головы не ожидает завершения: операция MPI_Accumulate
+     * завершается следующим MPI_Win_flush окна головы, который выполняет повтор операции стека.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::countHeadCasFailure()
+    {
+        ++m_statistics.headCasFailuresNum;
+        if (m_options.contentionSamplingPeriod == 0)
+            return;
+
+        static const uint64_t casFailuresIncrease{1};
+        m_intraNodeHeadWin.accumulate(&casFailuresIncrease,
+                                      1,
+                                      MPI_UINT64_T,
+                                      m_headRank,
+                                      MPI_Aint_add(m_headAddress, static_cast<MPI_Aint>(sizeof(CountedNodePtr) + sizeof(uint64_t))),
+                                      1,
+                                      MPI_UINT64_T,
+                                      MPI_SUM,
+                                      m_headWin
+        );
     }
 
     /*
@@ -414,84 +2141,333 @@ namespace rma_stack::ref_counting
      * процесса, чтобы другие процессы не освободили память под голову
      * до того, как к ней обратится текущий процесс.
      */
-    void InnerStack::increaseHeadCount(CountedNodePtr &oldHeadCountedNodePtr)
+    template<typename Layout>
+    void InnerStack<Layout>::increaseHeadCount(CountedNodePtr &oldHeadCountedNodePtr)
     {
         CountedNodePtr newCountedNodePtr;
         CountedNodePtr resCountedNodePtr = oldHeadCountedNodePtr;
-        m_logger->trace("started 'increaseHeadCount'");
+        RMA_STACK_TRACE(m_logger, "started 'increaseHeadCount'");
 
         do
         {
             newCountedNodePtr = oldHeadCountedNodePtr = resCountedNodePtr;
             newCountedNodePtr.incExternalCounter();
 
-            MPI_Compare_and_swap(&newCountedNodePtr,
-                                 &oldHeadCountedNodePtr,
-                                 &resCountedNodePtr,
-                                 MPI_UINT64_T,
-                                 HEAD_RANK,
-                                 m_headAddress,
-                                 m_headWin
+            m_intraNodeHeadWin.compareAndSwap(&newCountedNodePtr,
+                                              &oldHeadCountedNodePtr,
+                                              &resCountedNodePtr,
+                                              MPI_UINT64_T,
+                                              m_headRank,
+                                              m_headAddress,
+                                              m_headWin
             );
-            MPI_Win_flush(HEAD_RANK, m_headWin);
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
 
-            m_logger->trace("executed CAS in 'increaseHeadCount'");
-            m_logger->trace("oldCountedNodePtr is (rank - {}, offset - {}, ext_cnt - {})",
+            RMA_STACK_TRACE(m_logger, "executed CAS in 'increaseHeadCount'");
+            RMA_STACK_TRACE(m_logger, "oldCountedNodePtr is (rank - {}, offset - {}, ext_cnt - {})",
                             oldHeadCountedNodePtr.getRank(),
                             oldHeadCountedNodePtr.getOffset(),
                             oldHeadCountedNodePtr.getExternalCounter()
             );
-            m_logger->trace("resCountedNodePtr is (rank - {}, offset - {}, ext_cnt - {})",
+            RMA_STACK_TRACE(m_logger, "resCountedNodePtr is (rank - {}, offset - {}, ext_cnt - {})",
                             resCountedNodePtr.getRank(),
                             resCountedNodePtr.getOffset(),
                             resCountedNodePtr.getExternalCounter()
             );
+            if (oldHeadCountedNodePtr != resCountedNodePtr)
+                countHeadCasFailure();
         }
         while (oldHeadCountedNodePtr != resCountedNodePtr);
 
         oldHeadCountedNodePtr.setExternalCounter(newCountedNodePtr.getExternalCounter());
 
-        m_logger->trace("finished 'increaseHeadCount'");
+        RMA_STACK_TRACE(m_logger, "finished 'increaseHeadCount'");
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::checkCommSize(MPI_Comm comm)
+    {
+        int procNum{0};
+        {
+            auto mpiStatus = MPI_Comm_size(comm, &procNum);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to get size", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        if (static_cast<uint64_t>(procNum) > Layout::MaxProcNum)
+            throw std::invalid_argument("the communicator size exceeds the rank limit of the counted node pointer layout");
     }
 
-    InnerStack::InnerStack(MPI_Comm comm, MPI_Info info, bool t_centralized, size_t t_elemsUpLimit,
-                           std::shared_ptr<spdlog::logger> t_logger)
+    template<typename Layout>
+    InnerStack<Layout>::InnerStack(MPI_Comm comm, MPI_Info info, bool t_centralized, size_t t_elemsUpLimit,
+                           std::shared_ptr<spdlog::logger> t_logger, const InnerStackOptions &t_rOptions,
+                           size_t t_inlinePayloadSize)
     :
     m_elemsUpLimit(t_elemsUpLimit),
     m_centralized(t_centralized),
+    m_options(t_rOptions),
+    m_windowSync(t_rOptions.persistentLockAll),
+    m_inlinePayloadSize(t_rOptions.inlinePayload ? t_inlinePayloadSize : 0),
+    // Шаг узлов кратен 8 байтам, чтобы поля узлов оставались выровненными для атомарных операций.
+    m_nodeSize(sizeof(Node) + (m_inlinePayloadSize + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t)),
+    m_nodeImage(sizeof(CountedNodePtr) + m_inlinePayloadSize),
+    m_nodeMagazine(t_rOptions.nodeMagazineSize),
+    m_pNodeAddressesBuffer(std::make_unique<GlobalAddress[]>(std::max<size_t>(1, t_rOptions.nodeMagazineSize))),
     m_logger(std::move(t_logger))
     {
-        m_logger->trace("getting rank");
+        if (m_elemsUpLimit >= FreeListEndIndex || m_elemsUpLimit > Layout::MaxElemsNum)
+            throw std::invalid_argument("the elements up limit is out of bounds");
+        if (m_options.inlinePayload && (t_inlinePayloadSize == 0 || t_inlinePayloadSize > MaxInlinePayloadSize))
+            throw std::invalid_argument("the inline payload size is out of bounds");
+        if (m_options.workStealing && m_centralized)
+            throw std::invalid_argument("the work stealing mode requires the decentralized stack");
+        if (m_options.workStealing && m_options.stealBatchSize == 0)
+            throw std::invalid_argument("the steal batch size must be positive");
+        if (m_options.sizeCounterShardsNum > 0 && m_options.sizeCounterPublishPeriod == 0)
+            throw std::invalid_argument("the size counter publish period must be positive");
+        if (m_options.elasticNodePool)
+        {
+            if (m_centralized || m_options.staticWindows || m_options.intraNodeSharedMemory)
+                throw std::invalid_argument("the elastic node pool requires the decentralized stack with dynamic windows");
+            if (m_options.nodeAllocatorType != NodeAllocatorType::FreeList || !m_options.inlinePayload
+                || !m_options.persistentLockAll)
+                throw std::invalid_argument(
+                        "the elastic node pool requires the free list, the inline payload and the persistent lock all");
+            m_nodeSegmentSize = m_options.nodeSegmentSize == 0 ? m_elemsUpLimit : m_options.nodeSegmentSize;
+            if (m_nodeSegmentSize == 0 || m_nodeSegmentSize >= FreeListEndIndex
+                || m_nodeSegmentSize > NodeSegmentLayout::MaxSegmentNodesNum
+                || m_elemsUpLimit > NodeSegmentLayout::MaxSegmentNodesNum)
+                throw std::invalid_argument("the node segment size is out of bounds");
+        }
+
+        RMA_STACK_TRACE(m_logger, "getting rank");
         {
             auto mpiStatus = MPI_Comm_rank(comm, &m_rank);
             if (mpiStatus != MPI_SUCCESS)
                 throw custom_mpi::MpiException("failed to get rank", __FILE__, __func__, __LINE__, mpiStatus);
         }
-        m_logger->trace("got rank {}", m_rank);
+        RMA_STACK_TRACE(m_logger, "got rank {}", m_rank);
+        {
+            auto mpiStatus = MPI_Comm_size(comm, &m_procNum);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to get size", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+
+        // Разделяемая память узла выделяется только вместе со статическими окнами.
+        if (m_options.intraNodeSharedMemory)
+        {
+            m_options.staticWindows = true;
+            m_intraNodeSharedMemory = IntraNodeWindow::isSingleNode(comm);
+            if (!m_intraNodeSharedMemory)
+                m_logger->info("processes span several nodes, shared memory access is disabled");
+        }
+
+        // Каждый процесс работает со своей головой и обращается к чужим только при краже.
+        if (m_options.workStealing)
+            m_headRank = m_rank;
 
         initRemoteAccessMemory(comm, info);
+        // Эпохи доступа открываются один раз и остаются открытыми до release.
+        for (auto win: {m_headWin, m_nodesWin, m_eliminationWin, m_epochsWin, m_sizeWin})
+            m_windowSync.open(win);
         MPI_Barrier(comm);
-        m_logger->trace("finished InnerStack construction");
+        RMA_STACK_TRACE(m_logger, "finished InnerStack construction");
     }
 
-    void InnerStack::release()
+    template<typename Layout>
+    void InnerStack<Layout>::release()
     {
+        /*
+         * Освобождение стека выполняется после завершения операций на всех процессах,
+         * поэтому извлечённые узлы можно вернуть в пул без проверки эпох.
+         */
+        if (m_options.reclamationType == ReclamationType::Epochs)
+        {
+            freeRetiredNodes(m_retiredNodes);
+            m_retiredNodes.clear();
+            for (const auto &rBatch: m_retiredNodesBatches)
+                freeRetiredNodes(rBatch.nodeAddresses);
+            m_retiredNodesBatches.clear();
+        }
+
+        releaseReservedNodes();
+
+        // Узлы из кэша возвращаются в пул, чтобы они не были потеряны.
+        if (!m_nodeMagazine.isEmpty())
+        {
+            const int rank = getNodePoolRank();
+            m_windowSync.lock(rank, m_nodesWin);
+            drainNodeMagazine(m_nodeMagazine.getSize());
+            m_windowSync.unlock(rank, m_nodesWin);
+        }
+
+        // Неотправленное изменение размера отправляется, а последнее отправленное завершается закрытием эпохи доступа.
+        if (m_sizeWin != MPI_WIN_NULL)
+            publishSize();
+
+        for (auto win: {m_headWin, m_nodesWin, m_eliminationWin, m_epochsWin, m_sizeWin})
+            m_windowSync.close(win);
+
+        // Окно счётчиков размера всегда статическое, его память освобождается вместе с ним.
+        if (m_sizeWin != MPI_WIN_NULL)
+        {
+            MPI_Win_free(&m_sizeWin);
+            m_pSizeCounter = nullptr;
+            RMA_STACK_TRACE(m_logger, "freed up size counters win RMA memory");
+        }
+
+        // Память статических окон освобождается вместе с окнами.
+        if (m_options.staticWindows)
+        {
+            for (auto pWin: {&m_nodesWin, &m_eliminationWin, &m_epochsWin, &m_headWin})
+            {
+                if (*pWin != MPI_WIN_NULL)
+                    MPI_Win_free(pWin);
+            }
+            m_pNodesArr = nullptr;
+            m_pNodeBitmap = nullptr;
+            m_pEliminationSlots = nullptr;
+            m_pEpoch = nullptr;
+            m_pHeadCountedNodePtr = nullptr;
+            m_intraNodeNodesWin.unmap();
+            m_intraNodeHeadWin.unmap();
+            m_intraNodeEpochsWin.unmap();
+            RMA_STACK_TRACE(m_logger, "freed up static RMA windows");
+            return;
+        }
+
+        // Освобождение окна коллективное, поэтому память освобождается только после него.
+        MPI_Win_free(&m_nodesWin);
+        RMA_STACK_TRACE(m_logger, "freed up node win RMA memory");
+
         MPI_Free_mem(m_pNodesArr);
         m_pNodesArr = nullptr;
-        m_logger->trace("freed up node arr RMA memory");
+        m_pNodeBitmap = nullptr;
+        RMA_STACK_TRACE(m_logger, "freed up node arr RMA memory");
 
-        MPI_Win_free(&m_nodesWin);
-        m_logger->trace("freed up node win RMA memory");
+        if (m_options.elasticNodePool)
+        {
+            for (size_t slot = 1; slot < m_nodeSegments.size(); ++slot)
+            {
+                if (m_nodeSegments[slot].active || m_nodeSegments[slot].detaching)
+                    MPI_Free_mem(m_nodeSegments[slot].pMemory);
+            }
+            m_nodeSegments.clear();
+            MPI_Free_mem(m_pNodeSegmentTable);
+            m_pNodeSegmentTable = nullptr;
+            m_pNodeSegmentUsedCounts = nullptr;
+            RMA_STACK_TRACE(m_logger, "freed up node segments RMA memory");
+        }
+
+        if (m_eliminationWin != MPI_WIN_NULL)
+        {
+            MPI_Win_free(&m_eliminationWin);
+            RMA_STACK_TRACE(m_logger, "freed up elimination win RMA memory");
+
+            MPI_Free_mem(m_pEliminationSlots);
+            m_pEliminationSlots = nullptr;
+            RMA_STACK_TRACE(m_logger, "freed up elimination slots RMA memory");
+        }
+
+        if (m_epochsWin != MPI_WIN_NULL)
+        {
+            MPI_Win_free(&m_epochsWin);
+            RMA_STACK_TRACE(m_logger, "freed up epochs win RMA memory");
+
+            MPI_Free_mem(m_pEpoch);
+            m_pEpoch = nullptr;
+            RMA_STACK_TRACE(m_logger, "freed up epoch RMA memory");
+        }
+
+        MPI_Win_free(&m_headWin);
+        RMA_STACK_TRACE(m_logger, "freed up head win RMA memory");
 
         MPI_Free_mem(m_pHeadCountedNodePtr);
         m_pHeadCountedNodePtr = nullptr;
-        m_logger->trace("freed up head pointer RMA memory");
+        RMA_STACK_TRACE(m_logger, "freed up head pointer RMA memory");
+    }
 
-        MPI_Win_free(&m_headWin);
-        m_logger->trace("freed up head win RMA memory");
+    template<typename Layout>
+    void InnerStack<Layout>::initRemoteAccessMemory(MPI_Comm comm, MPI_Info info)
+    {
+        if (m_options.staticWindows)
+            initStaticWindows(comm, info);
+        else
+            initDynamicWindows(comm, info);
+
+        if (m_options.elasticNodePool)
+            initNodeSegments(comm);
+
+        if (m_options.eliminationArraySize > 0)
+            initEliminationArray(comm, info);
+
+        // Растущий пул использует эпохи для отложенного отсоединения освобождённых сегментов.
+        if (m_options.reclamationType == ReclamationType::Epochs || m_options.elasticNodePool)
+            initEpochs(comm, info);
+
+        if (m_options.sizeCounterShardsNum > 0)
+            initSizeCounters(comm, info);
+    }
+
+    /*
+     * Окна создаются вызовом MPI_Win_allocate с единичным шагом смещений, поэтому смещения
+     * в окнах отсчитываются от начала памяти окна и базовые адреса процессов не рассылаются.
+     * В централизованном стеке память массива узлов и головы выделяется только на HEAD_RANK.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::initStaticWindows(MPI_Comm comm, MPI_Info info)
+    {
+        const auto nodesSize = getNodesArrSize();
+        const auto localNodesSize = !m_centralized || m_rank == HEAD_RANK ? nodesSize : 0;
+        {
+            if (m_intraNodeSharedMemory)
+            {
+                m_intraNodeNodesWin.allocate(localNodesSize, info, comm, &m_pNodesArr, &m_nodesWin);
+            }
+            else
+            {
+                auto mpiStatus = MPI_Win_allocate(localNodesSize, 1, info, comm, &m_pNodesArr, &m_nodesWin);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to allocate RMA window for nodes", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+        }
+        if (localNodesSize > 0)
+        {
+            initNodesArr();
+            RMA_STACK_TRACE(m_logger, "initialized node array");
+        }
+        else
+        {
+            m_pNodesArr = nullptr;
+        }
+
+        const auto localHeadSize = hasLocalHead() ? getHeadSize() : 0;
+        {
+            if (m_intraNodeSharedMemory)
+            {
+                m_intraNodeHeadWin.allocate(localHeadSize, info, comm, &m_pHeadCountedNodePtr, &m_headWin);
+            }
+            else
+            {
+                auto mpiStatus = MPI_Win_allocate(localHeadSize, 1, info, comm, &m_pHeadCountedNodePtr, &m_headWin);
+                if (mpiStatus != MPI_SUCCESS)
+                    throw custom_mpi::MpiException("failed to allocate RMA window for head", __FILE__, __func__, __LINE__, mpiStatus);
+            }
+        }
+        if (localHeadSize > 0)
+        {
+            std::memset(static_cast<void*>(m_pHeadCountedNodePtr), 0, static_cast<size_t>(localHeadSize));
+            *m_pHeadCountedNodePtr = CountedNodePtr();
+            RMA_STACK_TRACE(m_logger, "initialized head");
+        }
+        else
+        {
+            m_pHeadCountedNodePtr = nullptr;
+        }
+        m_headAddress = 0;
     }
 
-    void InnerStack::initRemoteAccessMemory(MPI_Comm comm, MPI_Info info)
+    template<typename Layout>
+    void InnerStack<Layout>::initDynamicWindows(MPI_Comm comm, MPI_Info info)
     {
         {
             auto mpiStatus = MPI_Win_create_dynamic(info, comm, &m_nodesWin);
@@ -504,7 +2480,7 @@ namespace rma_stack::ref_counting
                 throw custom_mpi::MpiException("failed to create RMA window for head", __FILE__, __func__, __LINE__, mpiStatus);
         }
 
-        const auto nodesSize = static_cast<MPI_Aint>(sizeof(Node) * m_elemsUpLimit);
+        const auto nodesSize = getNodesArrSize();
 
         if (m_centralized)
         {
@@ -512,7 +2488,7 @@ namespace rma_stack::ref_counting
 
             if (m_rank == HEAD_RANK)
             {
-                m_logger->trace("started to initialize node array");
+                RMA_STACK_TRACE(m_logger, "started to initialize node array");
                 {
                     auto mpiStatus = MPI_Alloc_mem(nodesSize, MPI_INFO_NULL,
                                                    &m_pNodesArr);
@@ -526,27 +2502,27 @@ namespace rma_stack::ref_counting
                         );
                 }
 
-                std::fill_n(m_pNodesArr, m_elemsUpLimit, Node());
-                m_logger->trace("initialized node array");
+                initNodesArr();
+                RMA_STACK_TRACE(m_logger, "initialized node array");
                 {
                     auto mpiStatus = MPI_Win_attach(m_nodesWin, (void*)m_pNodesArr, nodesSize);
                     if (mpiStatus != MPI_SUCCESS) {
                         throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
                     }
                 }
-                m_logger->trace("attach nodes RMA window");
+                RMA_STACK_TRACE(m_logger, "attach nodes RMA window");
                 MPI_Get_address(m_pNodesArr, (MPI_Aint*)m_pBaseNodeArrAddresses.get());
             }
 
-            m_logger->trace("started to broadcast node array addresses");
+            RMA_STACK_TRACE(m_logger, "started to broadcast node array addresses");
             auto mpiStatus = MPI_Bcast(m_pBaseNodeArrAddresses.get(), 1, MPI_AINT, HEAD_RANK, comm);
             if (mpiStatus != MPI_SUCCESS)
                 throw custom_mpi::MpiException("failed to broadcast node array address", __FILE__, __func__ , __LINE__, mpiStatus);
-            m_logger->trace("broadcasted node array addresses");
+            RMA_STACK_TRACE(m_logger, "broadcasted node array addresses");
         }
         else
         {
-            m_logger->trace("started to initialize node array");
+            RMA_STACK_TRACE(m_logger, "started to initialize node array");
 
             {
                 auto mpiStatus = MPI_Alloc_mem(nodesSize, MPI_INFO_NULL,
@@ -561,15 +2537,15 @@ namespace rma_stack::ref_counting
                     );
             }
 
-            std::fill_n(m_pNodesArr, m_elemsUpLimit, Node());
-            m_logger->trace("initialized node array");
+            initNodesArr();
+            RMA_STACK_TRACE(m_logger, "initialized node array");
             {
                 auto mpiStatus = MPI_Win_attach(m_nodesWin, (void*)m_pNodesArr, nodesSize);
                 if (mpiStatus != MPI_SUCCESS)
                     throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
             }
 
-            m_logger->trace("started to broadcast node array addresses");
+            RMA_STACK_TRACE(m_logger, "started to broadcast node array addresses");
             int procNum{0};
             MPI_Comm_size(comm, &procNum);
             m_pBaseNodeArrAddresses = std::make_unique<MPI_Aint[]>(procNum);
@@ -580,18 +2556,18 @@ namespace rma_stack::ref_counting
                 auto mpiStatus = MPI_Bcast(&m_pBaseNodeArrAddresses[i], 1, MPI_AINT, i, comm);
                 if (mpiStatus != MPI_SUCCESS)
                     throw custom_mpi::MpiException("failed to broadcast node array base address", __FILE__, __func__ , __LINE__, mpiStatus);
-                m_logger->trace("m_pNodeArrAddresses[{}] = {}", i, m_pBaseNodeArrAddresses[i]);
+                RMA_STACK_TRACE(m_logger, "m_pNodeArrAddresses[{}] = {}", i, m_pBaseNodeArrAddresses[i]);
             }
 
-            m_logger->trace("broadcasted node array addresses");
+            RMA_STACK_TRACE(m_logger, "broadcasted node array addresses");
         }
 
-        if (m_rank == HEAD_RANK)
+        if (hasLocalHead())
         {
-            m_logger->trace("started to initialize head");
+            RMA_STACK_TRACE(m_logger, "started to initialize head");
 
             {
-                auto mpiStatus = MPI_Alloc_mem(sizeof(CountedNodePtr), MPI_INFO_NULL,
+                auto mpiStatus = MPI_Alloc_mem(getHeadSize(), MPI_INFO_NULL,
                                                &m_pHeadCountedNodePtr);
                 if (mpiStatus != MPI_SUCCESS)
                     throw custom_mpi::MpiException(
@@ -602,51 +2578,451 @@ namespace rma_stack::ref_counting
                             mpiStatus
                     );
             }
+            std::memset(static_cast<void*>(m_pHeadCountedNodePtr), 0, static_cast<size_t>(getHeadSize()));
             *m_pHeadCountedNodePtr = CountedNodePtr();
-            m_logger->trace("initialized head");
+            RMA_STACK_TRACE(m_logger, "initialized head");
             {
-                auto mpiStatus = MPI_Win_attach(m_headWin, (void*)m_pHeadCountedNodePtr, 1);
+                auto mpiStatus = MPI_Win_attach(m_headWin, (void*)m_pHeadCountedNodePtr, getHeadSize());
                 if (mpiStatus != MPI_SUCCESS)
                     throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
             }
-            m_logger->trace("attached nodes RMA window");
+            RMA_STACK_TRACE(m_logger, "attached nodes RMA window");
             MPI_Get_address(m_pHeadCountedNodePtr, &m_headAddress);
         }
 
+        if (m_options.workStealing)
+        {
+            RMA_STACK_TRACE(m_logger, "started to gather head addresses");
+            m_pBaseHeadAddresses = std::make_unique<MPI_Aint[]>(m_procNum);
+            auto mpiStatus = MPI_Allgather(&m_headAddress, 1, MPI_AINT, m_pBaseHeadAddresses.get(), 1, MPI_AINT, comm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to gather head addresses", __FILE__, __func__ , __LINE__, mpiStatus);
+            RMA_STACK_TRACE(m_logger, "gathered head addresses");
+        }
+        else
         {
-            m_logger->trace("started to broadcast head address");
+            RMA_STACK_TRACE(m_logger, "started to broadcast head address");
             auto mpiStatus = MPI_Bcast(&m_headAddress, 1, MPI_AINT, HEAD_RANK, comm);
             if (mpiStatus != MPI_SUCCESS)
                 throw custom_mpi::MpiException("failed to broadcast head address", __FILE__, __func__ , __LINE__, mpiStatus);
-            m_logger->trace("broadcasted head address");
+            RMA_STACK_TRACE(m_logger, "broadcasted head address");
+        }
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::initEpochs(MPI_Comm comm, MPI_Info info)
+    {
+        RMA_STACK_TRACE(m_logger, "started to initialize epochs");
+        m_epochsSnapshot.resize(static_cast<size_t>(m_procNum));
+        if (m_intraNodeSharedMemory)
+        {
+            m_intraNodeEpochsWin.allocate(sizeof(uint64_t), info, comm, &m_pEpoch, &m_epochsWin);
+            *m_pEpoch = m_epoch;
+            RMA_STACK_TRACE(m_logger, "initialized epochs");
+            return;
+        }
+        if (m_options.staticWindows)
+        {
+            auto mpiStatus = MPI_Win_allocate(sizeof(uint64_t), 1, info, comm, &m_pEpoch, &m_epochsWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to allocate RMA window for epochs", __FILE__, __func__, __LINE__, mpiStatus);
+            *m_pEpoch = m_epoch;
+            RMA_STACK_TRACE(m_logger, "initialized epochs");
+            return;
+        }
+        {
+            auto mpiStatus = MPI_Win_create_dynamic(info, comm, &m_epochsWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to create RMA window for epochs", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        {
+            auto mpiStatus = MPI_Alloc_mem(sizeof(uint64_t), MPI_INFO_NULL, &m_pEpoch);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException(
+                        "failed to allocate RMA memory",
+                        __FILE__,
+                        __func__,
+                        __LINE__,
+                        mpiStatus
+                );
+        }
+        *m_pEpoch = m_epoch;
+        {
+            auto mpiStatus = MPI_Win_attach(m_epochsWin, m_pEpoch, sizeof(uint64_t));
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+
+        m_pBaseEpochAddresses = std::make_unique<MPI_Aint[]>(static_cast<size_t>(m_procNum));
+        MPI_Aint baseEpochAddress{0};
+        MPI_Get_address(m_pEpoch, &baseEpochAddress);
+        {
+            auto mpiStatus = MPI_Allgather(&baseEpochAddress, 1, MPI_AINT,
+                                           m_pBaseEpochAddresses.get(), 1, MPI_AINT, comm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to gather epoch addresses", __FILE__, __func__ , __LINE__, mpiStatus);
+        }
+        RMA_STACK_TRACE(m_logger, "initialized epochs");
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::initEliminationArray(MPI_Comm comm, MPI_Info info)
+    {
+        RMA_STACK_TRACE(m_logger, "started to initialize elimination array");
+        m_eliminationRandomEngine.seed(static_cast<std::mt19937::result_type>(
+                std::chrono::steady_clock::now().time_since_epoch().count() + m_rank)
+        );
+
+        const auto slotsNum = m_options.eliminationArraySize;
+        const auto procNum = static_cast<size_t>(m_procNum);
+        const auto rank = static_cast<size_t>(m_rank);
+        const auto localSlotsNum = std::max<size_t>(1, slotsNum / procNum + (rank < slotsNum % procNum ? 1 : 0));
+        const auto slotsSize = static_cast<MPI_Aint>(sizeof(EliminationSlot) * localSlotsNum);
+        if (m_options.staticWindows)
+        {
+            auto mpiStatus = MPI_Win_allocate(slotsSize, 1, info, comm, &m_pEliminationSlots, &m_eliminationWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to allocate RMA window for elimination array", __FILE__, __func__, __LINE__, mpiStatus);
+            std::fill_n(m_pEliminationSlots, localSlotsNum, makeEliminationSlot<Layout>(EliminationSlotState::Empty, 0, 0));
+            RMA_STACK_TRACE(m_logger, "initialized elimination array");
+            return;
+        }
+        {
+            auto mpiStatus = MPI_Win_create_dynamic(info, comm, &m_eliminationWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to create RMA window for elimination array", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        {
+            auto mpiStatus = MPI_Alloc_mem(slotsSize, MPI_INFO_NULL, &m_pEliminationSlots);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException(
+                        "failed to allocate RMA memory",
+                        __FILE__,
+                        __func__,
+                        __LINE__,
+                        mpiStatus
+                );
+        }
+        std::fill_n(m_pEliminationSlots, localSlotsNum, makeEliminationSlot<Layout>(EliminationSlotState::Empty, 0, 0));
+        {
+            auto mpiStatus = MPI_Win_attach(m_eliminationWin, m_pEliminationSlots, slotsSize);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+
+        m_pBaseEliminationSlotsAddresses = std::make_unique<MPI_Aint[]>(procNum);
+        MPI_Aint baseEliminationSlotsAddress{0};
+        MPI_Get_address(m_pEliminationSlots, &baseEliminationSlotsAddress);
+        {
+            auto mpiStatus = MPI_Allgather(&baseEliminationSlotsAddress, 1, MPI_AINT,
+                                           m_pBaseEliminationSlotsAddresses.get(), 1, MPI_AINT, comm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to gather elimination array addresses", __FILE__, __func__ , __LINE__, mpiStatus);
+        }
+        RMA_STACK_TRACE(m_logger, "initialized elimination array");
+    }
+
+    /*
+     * Общие счётчики размера расположены на процессах с номерами меньше sizeCounterShardsNum.
+     * Окно счётчиков создаётся MPI_Win_allocate при любом типе окон: обращения к нему редки,
+     * и смещение счётчика одинаково на всех процессах.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::initSizeCounters(MPI_Comm comm, MPI_Info info)
+    {
+        RMA_STACK_TRACE(m_logger, "started to initialize size counters");
+        m_sizeCounterShardsNum = static_cast<int>(std::min<size_t>(m_options.sizeCounterShardsNum,
+                                                                   static_cast<size_t>(m_procNum)));
+        m_sizeCounterShards.resize(static_cast<size_t>(m_sizeCounterShardsNum));
+        const auto counterSize = static_cast<MPI_Aint>(m_rank < m_sizeCounterShardsNum ? sizeof(int64_t) : 0);
+        auto mpiStatus = MPI_Win_allocate(counterSize, 1, info, comm, &m_pSizeCounter, &m_sizeWin);
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to allocate RMA window for size counters", __FILE__, __func__, __LINE__, mpiStatus);
+        if (counterSize > 0)
+            *m_pSizeCounter = 0;
+        RMA_STACK_TRACE(m_logger, "initialized size counters");
+    }
+
+    /*
+     * Все узлы массива изначально свободны и связаны в список свободных узлов
+     * в порядке возрастания индексов.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::initNodesArr()
+    {
+        initNodeSegment(m_pNodesArr, m_elemsUpLimit);
+
+        if (m_options.nodeAllocatorType == NodeAllocatorType::Bitmap)
+        {
+            auto pFreeListHead = reinterpret_cast<FreeListHead*>(reinterpret_cast<unsigned char*>(m_pNodesArr)
+                    + m_nodeSize * m_elemsUpLimit);
+            m_pNodeBitmap = reinterpret_cast<uint64_t*>(pFreeListHead + 1);
+            initNodeBitmap(m_pNodeBitmap, m_elemsUpLimit);
+        }
+    }
+
+    // Индексы списка свободных узлов отсчитываются от начала сегмента.
+    template<typename Layout>
+    void InnerStack<Layout>::initNodeSegment(void *pSegment, size_t nodesNum)
+    {
+        // Узлы расположены с шагом m_nodeSize, за заголовком узла хранятся данные пользователя.
+        auto pNodesBytes = reinterpret_cast<unsigned char*>(pSegment);
+        std::fill_n(pNodesBytes, m_nodeSize * nodesNum, 0);
+        for (size_t i = 0; i < nodesNum; ++i)
+        {
+            auto pNode = new (pNodesBytes + i * m_nodeSize) Node();
+            if (i + 1 < nodesNum)
+                pNode->setNextFreeIndex(static_cast<uint32_t>(i + 1));
+        }
+
+        auto pFreeListHead = reinterpret_cast<FreeListHead*>(pNodesBytes + m_nodeSize * nodesNum);
+        pFreeListHead->index = nodesNum > 0 ? 0 : FreeListEndIndex;
+        pFreeListHead->tag = 0;
+    }
+
+    /*
+     * Таблица сегментов и счётчики занятых узлов выделяются одним блоком, присоединяются
+     * к окну узлов, а их адреса рассылаются всем процессам.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::initNodeSegments(MPI_Comm comm)
+    {
+        RMA_STACK_TRACE(m_logger, "started to initialize node segments");
+        m_nodeSegments.resize(NodeSegmentLayout::SlotsNum);
+        m_nodeSegments[0] = {reinterpret_cast<unsigned char*>(m_pNodesArr),
+                             m_pBaseNodeArrAddresses[m_rank],
+                             m_elemsUpLimit,
+                             0,
+                             true,
+                             false,
+                             false,
+                             {}};
+
+        const auto tableSize = static_cast<MPI_Aint>(NodeSegmentLayout::SlotsNum
+                * (sizeof(NodeSegmentDescriptor) + sizeof(int64_t)));
+        {
+            auto mpiStatus = MPI_Alloc_mem(tableSize, MPI_INFO_NULL, &m_pNodeSegmentTable);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to allocate RMA memory", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        m_pNodeSegmentUsedCounts = reinterpret_cast<int64_t*>(m_pNodeSegmentTable + NodeSegmentLayout::SlotsNum);
+        std::fill_n(m_pNodeSegmentTable, NodeSegmentLayout::SlotsNum, NodeSegmentDescriptor());
+        std::fill_n(m_pNodeSegmentUsedCounts, NodeSegmentLayout::SlotsNum, 0);
+        m_pNodeSegmentTable[0] = {m_nodeSegments[0].baseAddress, 0};
+        {
+            auto mpiStatus = MPI_Win_attach(m_nodesWin, m_pNodeSegmentTable, tableSize);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to attach RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+
+        MPI_Aint tableAddress{0};
+        MPI_Get_address(m_pNodeSegmentTable, &tableAddress);
+        m_pBaseNodeSegmentTableAddresses = std::make_unique<MPI_Aint[]>(m_procNum);
+        {
+            auto mpiStatus = MPI_Allgather(&tableAddress, 1, MPI_AINT, m_pBaseNodeSegmentTableAddresses.get(), 1,
+                                           MPI_AINT, comm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to gather node segment table addresses", __FILE__, __func__,
+                                               __LINE__, mpiStatus);
         }
+        m_nodeSegmentTablesCache.resize(static_cast<size_t>(m_procNum) * NodeSegmentLayout::SlotsNum);
+        m_pendingNodeSegmentReleases.resize(static_cast<size_t>(m_procNum) * NodeSegmentLayout::SlotsNum);
+        m_publishedNodeSegmentReleases.resize(static_cast<size_t>(m_procNum) * NodeSegmentLayout::SlotsNum);
+        RMA_STACK_TRACE(m_logger, "initialized node segments");
     }
 
-    size_t InnerStack::getElemsUpLimit() const
+    template<typename Layout>
+    size_t InnerStack<Layout>::getElemsUpLimit() const
     {
         return m_elemsUpLimit;
     }
 
-    void InnerStack::printStack()
+    template<typename Layout>
+    const RmaWindowSync &InnerStack<Layout>::getWindowSync() const
+    {
+        return m_windowSync;
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::hasIntraNodeSharedMemory() const
+    {
+        return m_intraNodeSharedMemory;
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::hasWorkStealing() const
+    {
+        return m_options.workStealing;
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::hasPopPayloadPrefetch() const
+    {
+        return m_options.prefetchPopPayload && !hasInlinePayload();
+    }
+
+    template<typename Layout>
+    size_t InnerStack<Layout>::getStealBatchSize() const
+    {
+        return m_options.stealBatchSize;
+    }
+
+    template<typename Layout>
+    int InnerStack<Layout>::getRank() const
+    {
+        return m_rank;
+    }
+
+    template<typename Layout>
+    int InnerStack<Layout>::getProcNum() const
+    {
+        return m_procNum;
+    }
+
+    // При workStealing голова стека есть на каждом процессе, иначе - только на HEAD_RANK.
+    template<typename Layout>
+    bool InnerStack<Layout>::hasLocalHead() const
+    {
+        return m_options.workStealing || m_rank == HEAD_RANK;
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::addSize(int64_t sizeIncrease)
+    {
+        if (m_sizeWin == MPI_WIN_NULL)
+            return;
+
+        m_unpublishedSizeIncrease += sizeIncrease;
+        if (m_options.exactSize || ++m_sizeOpsNum >= m_options.sizeCounterPublishPeriod)
+            publishSize();
+    }
+
+    /*
+     * Отправка изменения размера не ждёт ответа общего счётчика: предыдущее изменение завершается
+     * в памяти счётчика вызовом MPI_Win_flush перед отправкой следующего, поэтому у процесса
+     * не более одного незавершённого изменения, и после него буфер m_publishedSizeIncrease можно изменять.
+     * При захвате окна на время операции (persistentLockAll выключен) изменение завершается MPI_Win_unlock.
+     */
+    template<typename Layout>
+    void InnerStack<Layout>::publishSize()
+    {
+        m_sizeOpsNum = 0;
+        if (m_unpublishedSizeIncrease == 0)
+            return;
+
+        const int shardRank = m_rank % m_sizeCounterShardsNum;
+        m_windowSync.lock(shardRank, m_sizeWin);
+        MPI_Win_flush(shardRank, m_sizeWin);
+        m_publishedSizeIncrease = m_unpublishedSizeIncrease;
+        m_unpublishedSizeIncrease = 0;
+        MPI_Accumulate(&m_publishedSizeIncrease, 1, MPI_INT64_T, shardRank, 0, 1, MPI_INT64_T, MPI_SUM, m_sizeWin);
+        if (m_options.exactSize)
+            MPI_Win_flush(shardRank, m_sizeWin);
+        m_windowSync.unlock(shardRank, m_sizeWin);
+    }
+
+    /*
+     * Чтение общего счётчика упорядочено с отправленным ранее изменением размера того же процесса,
+     * так как атомарные операции одного процесса над одной ячейкой выполняются в порядке вызова.
+     * Чтения всех общих счётчиков завершаются одним MPI_Win_flush_all.
+     */
+    template<typename Layout>
+    size_t InnerStack<Layout>::readSizeCounters()
+    {
+        for (int shardRank = 0; shardRank < m_sizeCounterShardsNum; ++shardRank)
+        {
+            m_windowSync.lock(shardRank, m_sizeWin);
+            MPI_Fetch_and_op(nullptr, &m_sizeCounterShards[shardRank], MPI_INT64_T, shardRank, 0, MPI_NO_OP, m_sizeWin);
+        }
+        MPI_Win_flush_all(m_sizeWin);
+        for (int shardRank = 0; shardRank < m_sizeCounterShardsNum; ++shardRank)
+            m_windowSync.unlock(shardRank, m_sizeWin);
+
+        const auto size = std::accumulate(m_sizeCounterShards.begin(), m_sizeCounterShards.end(),
+                                          m_unpublishedSizeIncrease);
+        return static_cast<size_t>(std::max<int64_t>(size, 0));
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::hasSizeCounter() const
+    {
+        return m_sizeWin != MPI_WIN_NULL;
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::isEmpty()
+    {
+        const int headRanksNum = m_options.workStealing ? m_procNum : 1;
+        bool empty{true};
+        for (int i = 0; i < headRanksNum && empty; ++i)
+        {
+            // Первой читается собственная голова процесса, в которой значения вероятнее всего.
+            if (m_options.workStealing)
+                setHeadRank((m_rank + i) % m_procNum);
+
+            CountedNodePtr headCountedNodePtr;
+            m_windowSync.lock(m_headRank, m_headWin);
+            m_intraNodeHeadWin.fetchAndOp(nullptr,
+                                          &headCountedNodePtr,
+                                          MPI_UINT64_T,
+                                          m_headRank,
+                                          m_headAddress,
+                                          MPI_NO_OP,
+                                          m_headWin
+            );
+            m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+            m_windowSync.unlock(m_headRank, m_headWin);
+            empty = headCountedNodePtr.isDummy();
+        }
+        if (m_options.workStealing)
+            setHeadRank(m_rank);
+        return empty;
+    }
+
+    // Голова и, при оценке конкуренции, счётчики операций и неудачных CAS головы сразу за ней.
+    template<typename Layout>
+    MPI_Aint InnerStack<Layout>::getHeadSize() const
+    {
+        const size_t contentionCountersSize = m_options.contentionSamplingPeriod > 0 ? 2 * sizeof(uint64_t) : 0;
+        return static_cast<MPI_Aint>(sizeof(CountedNodePtr) + contentionCountersSize);
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::hasStaticWindows() const
+    {
+        return m_options.staticWindows;
+    }
+
+    template<typename Layout>
+    bool InnerStack<Layout>::hasInlinePayload() const
+    {
+        return m_inlinePayloadSize > 0;
+    }
+
+    template<typename Layout>
+    void InnerStack<Layout>::printStack()
     {
         CountedNodePtr slider;
-        MPI_Win_lock(MPI_LOCK_SHARED, HEAD_RANK, MPI_MODE_NOCHECK, m_headWin);
-        MPI_Fetch_and_op(nullptr, &slider, MPI_UINT64_T, HEAD_RANK, m_headAddress, MPI_NO_OP, m_headWin);
-        MPI_Win_flush(HEAD_RANK, m_headWin);
-        MPI_Win_unlock(HEAD_RANK, m_headWin);
+        m_windowSync.lock(m_headRank, m_headWin);
+        m_intraNodeHeadWin.fetchAndOp(nullptr, &slider, MPI_UINT64_T, m_headRank, m_headAddress, MPI_NO_OP, m_headWin);
+        m_intraNodeHeadWin.flush(m_headRank, m_headWin);
+        m_windowSync.unlock(m_headRank, m_headWin);
 
-        while (slider.getRank() < DummyRank)
+        while (slider.getRank() < Layout::DummyRank)
         {
             m_logger->info("(rank - {}, offset - {})", slider.getRank(), slider.getOffset());
 
-            int nextRank            = static_cast<int>(slider.getRank());
-            auto nextDisplacement   = static_cast<MPI_Aint>(slider.getOffset() * sizeof(Node)) + 8;
-            auto nextOffset = MPI_Aint_add(m_pBaseNodeArrAddresses[nextRank], nextDisplacement);
+            int nextRank    = static_cast<int>(slider.getRank());
+            auto nextOffset = MPI_Aint_add(getNodeOffset(nextRank, slider.getOffset()), 8);
 
-            MPI_Win_lock(MPI_LOCK_SHARED, nextRank, MPI_MODE_NOCHECK, m_nodesWin);
-            MPI_Get(&slider, 1, MPI_UINT64_T, nextRank, nextOffset, 1, MPI_UINT64_T, m_nodesWin);
-            MPI_Win_flush(nextRank, m_nodesWin);
-            MPI_Win_unlock(nextRank, m_nodesWin);
+            m_windowSync.lock(nextRank, m_nodesWin);
+            m_intraNodeNodesWin.get(&slider, 1, MPI_UINT64_T, nextRank, nextOffset, 1, MPI_UINT64_T, m_nodesWin);
+            m_intraNodeNodesWin.flush(nextRank, m_nodesWin);
+            m_windowSync.unlock(nextRank, m_nodesWin);
         }
     }
+
+    template class InnerStack<DefaultLayout>;
+    template class InnerStack<LargeJobLayout>;
+    template class InnerStack<SmallJobLayout>;
 } // ref_counting
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "inner/IntraNodeWindow.h"
+#include "MpiException.h"
+
+namespace rma_stack::ref_counting
+{
+    namespace custom_mpi = custom_mpi_extensions;
+
+    namespace
+    {
+        static_assert(std::atomic<uint64_t>::is_always_lock_free && sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                      "64-bit atomics must be lock-free and layout compatible with uint64_t");
+        static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                      "32-bit atomics must be lock-free and layout compatible with uint32_t");
+
+        int getTypeSize(MPI_Datatype datatype)
+        {
+            int typeSize{0};
+            MPI_Type_size(datatype, &typeSize);
+            return typeSize;
+        }
+
+        template<typename Word>
+        std::atomic<Word> &asAtomic(unsigned char *pTarget)
+        {
+            return *reinterpret_cast<std::atomic<Word>*>(pTarget);
+        }
+
+        // Сложение выполняется в беззнаковой арифметике, что совпадает с дополнительным кодом знаковых типов.
+        template<typename Word>
+        Word fetchAndOpWord(const void *pOriginAddr, unsigned char *pTarget, MPI_Op op)
+        {
+            auto &rTarget = asAtomic<Word>(pTarget);
+            Word origin{0};
+            if (pOriginAddr != nullptr)
+                std::memcpy(&origin, pOriginAddr, sizeof(Word));
+
+            if (op == MPI_NO_OP)
+                return rTarget.load();
+            if (op == MPI_SUM)
+                return rTarget.fetch_add(origin);
+            if (op == MPI_REPLACE)
+                return rTarget.exchange(origin);
+            if (op == MPI_BOR)
+                return rTarget.fetch_or(origin);
+            if (op == MPI_BAND)
+                return rTarget.fetch_and(origin);
+
+            throw std::invalid_argument("the operation is not supported on shared memory");
+        }
+
+        template<typename Word>
+        void fetchAndOpWord(const void *pOriginAddr, void *pResultAddr, unsigned char *pTarget, MPI_Op op)
+        {
+            const auto result = fetchAndOpWord<Word>(pOriginAddr, pTarget, op);
+            if (pResultAddr != nullptr)
+                std::memcpy(pResultAddr, &result, sizeof(Word));
+        }
+
+        template<typename Word>
+        void compareAndSwapWord(const void *pOriginAddr, const void *pCompareAddr, void *pResultAddr,
+                                unsigned char *pTarget)
+        {
+            Word origin{0};
+            Word expected{0};
+            std::memcpy(&origin, pOriginAddr, sizeof(Word));
+            std::memcpy(&expected, pCompareAddr, sizeof(Word));
+            asAtomic<Word>(pTarget).compare_exchange_strong(expected, origin);
+            // При неудаче expected содержит текущее значение, при успехе - прежнее, как и в MPI_Compare_and_swap.
+            std::memcpy(pResultAddr, &expected, sizeof(Word));
+        }
+    }
+
+    bool IntraNodeWindow::isSingleNode(MPI_Comm comm)
+    {
+        MPI_Comm nodeComm{MPI_COMM_NULL};
+        {
+            auto mpiStatus = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to split communicator by node", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+
+        int procNum{0};
+        int nodeProcNum{0};
+        MPI_Comm_size(comm, &procNum);
+        MPI_Comm_size(nodeComm, &nodeProcNum);
+        MPI_Comm_free(&nodeComm);
+
+        // Размер коммуникатора узла может отличаться на разных процессах, поэтому решение принимается совместно.
+        int isLocalNodeFull = nodeProcNum == procNum ? 1 : 0;
+        int isSingleNode{0};
+        {
+            auto mpiStatus = MPI_Allreduce(&isLocalNodeFull, &isSingleNode, 1, MPI_INT, MPI_LAND, comm);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to reduce node flags", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        return isSingleNode != 0;
+    }
+
+    void IntraNodeWindow::allocate(MPI_Aint size, MPI_Info info, MPI_Comm comm, void *pBaseAddress, MPI_Win *pWin)
+    {
+        {
+            auto mpiStatus = MPI_Win_allocate_shared(size, 1, info, comm, pBaseAddress, pWin);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to allocate shared RMA window", __FILE__, __func__, __LINE__, mpiStatus);
+        }
+        map(*pWin);
+    }
+
+    void IntraNodeWindow::map(MPI_Win win)
+    {
+        MPI_Group winGroup{MPI_GROUP_NULL};
+        MPI_Win_get_group(win, &winGroup);
+        int procNum{0};
+        MPI_Group_size(winGroup, &procNum);
+        MPI_Group_free(&winGroup);
+
+        m_baseAddresses.assign(static_cast<size_t>(procNum), nullptr);
+        for (int rank = 0; rank < procNum; ++rank)
+        {
+            MPI_Aint size{0};
+            int dispUnit{0};
+            void *pBaseAddress{nullptr};
+            auto mpiStatus = MPI_Win_shared_query(win, rank, &size, &dispUnit, &pBaseAddress);
+            if (mpiStatus != MPI_SUCCESS)
+                throw custom_mpi::MpiException("failed to query shared memory", __FILE__, __func__, __LINE__, mpiStatus);
+            if (size > 0)
+                m_baseAddresses[rank] = static_cast<unsigned char*>(pBaseAddress);
+        }
+    }
+
+    void IntraNodeWindow::unmap()
+    {
+        m_baseAddresses.clear();
+    }
+
+    bool IntraNodeWindow::isMapped(int rank) const
+    {
+        return rank >= 0 && static_cast<size_t>(rank) < m_baseAddresses.size() && m_baseAddresses[rank] != nullptr;
+    }
+
+    unsigned char *IntraNodeWindow::getAddress(int rank, MPI_Aint displacement) const
+    {
+        if (!isMapped(rank))
+            return nullptr;
+        return m_baseAddresses[rank] + displacement;
+    }
+
+    void IntraNodeWindow::fetchAndOp(const void *pOriginAddr, void *pResultAddr, MPI_Datatype datatype,
+                                     int targetRank, MPI_Aint targetDisp, MPI_Op op, MPI_Win win) const
+    {
+        auto pTarget = getAddress(targetRank, targetDisp);
+        if (pTarget == nullptr)
+        {
+            MPI_Fetch_and_op(pOriginAddr, pResultAddr, datatype, targetRank, targetDisp, op, win);
+            return;
+        }
+
+        if (getTypeSize(datatype) == sizeof(uint64_t))
+            fetchAndOpWord<uint64_t>(pOriginAddr, pResultAddr, pTarget, op);
+        else
+            fetchAndOpWord<uint32_t>(pOriginAddr, pResultAddr, pTarget, op);
+    }
+
+    void IntraNodeWindow::compareAndSwap(const void *pOriginAddr, const void *pCompareAddr, void *pResultAddr,
+                                         MPI_Datatype datatype, int targetRank, MPI_Aint targetDisp, MPI_Win win) const
+    {
+        auto pTarget = getAddress(targetRank, targetDisp);
+        if (pTarget == nullptr)
+        {
+            MPI_Compare_and_swap(pOriginAddr, pCompareAddr, pResultAddr, datatype, targetRank, targetDisp, win);
+            return;
+        }
+
+        if (getTypeSize(datatype) == sizeof(uint64_t))
+            compareAndSwapWord<uint64_t>(pOriginAddr, pCompareAddr, pResultAddr, pTarget);
+        else
+            compareAndSwapWord<uint32_t>(pOriginAddr, pCompareAddr, pResultAddr, pTarget);
+    }
+
+    void IntraNodeWindow::accumulate(const void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                                     int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                                     MPI_Op op, MPI_Win win) const
+    {
+        auto pTarget = getAddress(targetRank, targetDisp);
+        if (pTarget == nullptr)
+        {
+            MPI_Accumulate(pOriginAddr, originCount, originDatatype, targetRank, targetDisp,
+                           targetCount, targetDatatype, op, win);
+            return;
+        }
+
+        const auto typeSize = static_cast<size_t>(getTypeSize(originDatatype));
+        auto pOriginBytes = static_cast<const unsigned char*>(pOriginAddr);
+        for (int i = 0; i < originCount; ++i)
+        {
+            if (typeSize == sizeof(uint64_t))
+                fetchAndOpWord<uint64_t>(pOriginBytes + i * typeSize, nullptr, pTarget + i * typeSize, op);
+            else
+                fetchAndOpWord<uint32_t>(pOriginBytes + i * typeSize, nullptr, pTarget + i * typeSize, op);
+        }
+    }
+
+    void IntraNodeWindow::put(const void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                              int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                              MPI_Win win) const
+    {
+        auto pTarget = getAddress(targetRank, targetDisp);
+        if (pTarget == nullptr)
+        {
+            MPI_Put(pOriginAddr, originCount, originDatatype, targetRank, targetDisp, targetCount, targetDatatype, win);
+            return;
+        }
+
+        std::memcpy(pTarget, pOriginAddr, static_cast<size_t>(originCount) * getTypeSize(originDatatype));
+    }
+
+    void IntraNodeWindow::get(void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                              int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                              MPI_Win win) const
+    {
+        auto pTarget = getAddress(targetRank, targetDisp);
+        if (pTarget == nullptr)
+        {
+            MPI_Get(pOriginAddr, originCount, originDatatype, targetRank, targetDisp, targetCount, targetDatatype, win);
+            return;
+        }
+
+        std::memcpy(pOriginAddr, pTarget, static_cast<size_t>(originCount) * getTypeSize(originDatatype));
+    }
+
+    void IntraNodeWindow::rget(void *pOriginAddr, int originCount, MPI_Datatype originDatatype,
+                               int targetRank, MPI_Aint targetDisp, int targetCount, MPI_Datatype targetDatatype,
+                               MPI_Win win, MPI_Request *pRequest) const
+    {
+        auto pTarget = getAddress(targetRank, targetDisp);
+        if (pTarget == nullptr)
+        {
+            MPI_Rget(pOriginAddr, originCount, originDatatype, targetRank, targetDisp, targetCount, targetDatatype,
+                     win, pRequest);
+            return;
+        }
+
+        std::memcpy(pOriginAddr, pTarget, static_cast<size_t>(originCount) * getTypeSize(originDatatype));
+        *pRequest = MPI_REQUEST_NULL;
+    }
+
+    // Операции над отображённой памятью завершаются сразу, остаётся упорядочить их с последующими.
+    void IntraNodeWindow::flush(int rank, MPI_Win win) const
+    {
+        if (isMapped(rank))
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return;
+        }
+
+        MPI_Win_flush(rank, win);
+    }
+
+    void IntraNodeWindow::flushAll(MPI_Win win) const
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        MPI_Win_flush_all(win);
+    }
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RMA_STACK_NODE_BITMAP_X86
+#include <immintrin.h>
+#endif
+
+#include "inner/NodeBitmap.h"
+
+namespace rma_stack::ref_counting
+{
+    size_t getNodeBitmapWordsNum(size_t elemsUpLimit)
+    {
+        return (elemsUpLimit + NodeBitmapWordBits - 1) / NodeBitmapWordBits;
+    }
+
+    void initNodeBitmap(uint64_t *pWords, size_t elemsUpLimit)
+    {
+        const auto wordsNum = getNodeBitmapWordsNum(elemsUpLimit);
+        std::fill_n(pWords, wordsNum, 0);
+
+        const auto tailBits = elemsUpLimit % NodeBitmapWordBits;
+        if (tailBits != 0)
+            pWords[wordsNum - 1] = NodeBitmapFullWord << tailBits;
+    }
+
+    /*
+     * Реализация выбирается при первом вызове по возможностям процессора, поэтому библиотека
+     * собирается без -mavx2 и выполняется на процессорах без AVX2.
+     */
+    size_t findFirstNotFullWord(const uint64_t *pWords, size_t beginWord, size_t endWord)
+    {
+        static const bool avx2Supported = isNodeBitmapAvx2Supported();
+        if (avx2Supported)
+            return findFirstNotFullWordAvx2(pWords, beginWord, endWord);
+        return findFirstNotFullWordScalar(pWords, beginWord, endWord);
+    }
+
+    size_t findFirstNotFullWordScalar(const uint64_t *pWords, size_t beginWord, size_t endWord)
+    {
+        for (size_t i = beginWord; i < endWord; ++i)
+        {
+            if (pWords[i] != NodeBitmapFullWord)
+                return i;
+        }
+        return endWord;
+    }
+
+#if defined(RMA_STACK_NODE_BITMAP_X86)
+    __attribute__((target("avx2")))
+    size_t findFirstNotFullWordAvx2(const uint64_t *pWords, size_t beginWord, size_t endWord)
+    {
+        size_t i = beginWord;
+        const __m256i fullWords = _mm256_set1_epi64x(-1);
+        for (; i + 4 <= endWord; i += 4)
+        {
+            const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pWords + i));
+            const auto fullMask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi64(words, fullWords)));
+            if (fullMask != 0xFFFFFFFFu)
+                return i + static_cast<size_t>(__builtin_ctz(~fullMask)) / sizeof(uint64_t);
+        }
+        return findFirstNotFullWordScalar(pWords, i, endWord);
+    }
+
+    bool isNodeBitmapAvx2Supported()
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    size_t findFirstNotFullWordAvx2(const uint64_t *pWords, size_t beginWord, size_t endWord)
+    {
+        return findFirstNotFullWordScalar(pWords, beginWord, endWord);
+    }
+
+    bool isNodeBitmapAvx2Supported()
+    {
+        return false;
+    }
+#endif
+
+    unsigned findFirstZeroBit(uint64_t word)
+    {
+        return static_cast<unsigned>(__builtin_ctzll(~word));
+    }
+}
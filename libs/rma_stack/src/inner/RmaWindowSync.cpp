@@ -0,0 +1,54 @@
+#include "inner/RmaWindowSync.h"
+#include "MpiException.h"
+
+namespace rma_stack::ref_counting
+{
+    namespace custom_mpi = custom_mpi_extensions;
+
+    RmaWindowSync::RmaWindowSync(bool t_persistent)
+    :
+    m_persistent(t_persistent)
+    {
+    }
+
+    void RmaWindowSync::open(MPI_Win win) const
+    {
+        if (!m_persistent || win == MPI_WIN_NULL)
+            return;
+
+        auto mpiStatus = MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to open passive target epoch", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    void RmaWindowSync::close(MPI_Win win) const
+    {
+        if (!m_persistent || win == MPI_WIN_NULL)
+            return;
+
+        auto mpiStatus = MPI_Win_unlock_all(win);
+        if (mpiStatus != MPI_SUCCESS)
+            throw custom_mpi::MpiException("failed to close passive target epoch", __FILE__, __func__, __LINE__, mpiStatus);
+    }
+
+    void RmaWindowSync::lock(int rank, MPI_Win win) const
+    {
+        if (m_persistent)
+            return;
+
+        MPI_Win_lock(MPI_LOCK_SHARED, rank, MPI_MODE_NOCHECK, win);
+    }
+
+    void RmaWindowSync::unlock(int rank, MPI_Win win) const
+    {
+        if (m_persistent)
+            return;
+
+        MPI_Win_unlock(rank, win);
+    }
+
+    bool RmaWindowSync::isPersistent() const
+    {
+        return m_persistent;
+    }
+}
@@ -2,14 +2,28 @@
 // Created by denis on 19.02.23.
 //
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 #include <thread>
 
 #include "include/outer/ExponentialBackoff.h"
 
 namespace rma_stack
 {
+    int getContentionDelayLimit(int minDelayInt, int maxDelayInt, double contentionLevel)
+    {
+        if (contentionLevel <= 0.0)
+            return minDelayInt;
+
+        const auto limitDelay = std::max(minDelayInt, 1) * std::exp2(std::min(contentionLevel, 31.0));
+        return static_cast<int>(std::min(limitDelay, static_cast<double>(maxDelayInt)));
+    }
+
     ExponentialBackoff::ExponentialBackoff(const std::chrono::nanoseconds &t_rMinDelayNs, const std::chrono::nanoseconds &t_rMaxDelayNs)
     :
+    m_minDelayNs(t_rMinDelayNs),
     m_maxDelayNs(t_rMaxDelayNs),
     m_limitDelayInt(0),
     m_randomEngine(std::chrono::steady_clock::now().time_since_epoch().count())
@@ -29,6 +43,13 @@ namespace rma_stack
         m_limitDelayInt = static_cast<int>(t_rMinDelayNs.count());
     }
 
+    void ExponentialBackoff::reset(double contentionLevel)
+    {
+        m_limitDelayInt = getContentionDelayLimit(static_cast<int>(m_minDelayNs.count()),
+                                                  static_cast<int>(m_maxDelayNs.count()),
+                                                  contentionLevel);
+    }
+
     void ExponentialBackoff::backoff()
     {
         const auto delayInt = std::uniform_int_distribution<int>(0, m_limitDelayInt)(m_randomEngine);
@@ -5,6 +5,7 @@
 #ifndef SOURCES_ISTACK_H
 #define SOURCES_ISTACK_H
 
+#include <cstddef>
 
 namespace stack_interface
 {
@@ -26,6 +27,19 @@ namespace stack_interface
         {
             StackTraitsImpl::popImpl(impl(), rValue, rDefaultValue);
         }
+        /*
+         * Пакетные операции: pushN добавляет count значений так, как если бы они были
+         * добавлены последовательно, popN извлекает до maxCount значений, начиная с вершины.
+         * Обе операции возвращают кол-во фактически обработанных значений.
+         */
+        size_t pushN(const ValueType *pValues, size_t count)
+        {
+            return StackTraitsImpl::pushNImpl(impl(), pValues, count);
+        }
+        size_t popN(ValueType *pValues, size_t maxCount)
+        {
+            return StackTraitsImpl::popNImpl(impl(), pValues, maxCount);
+        }
         ValueType& top()
         {
             return StackTraitsImpl::topImpl(impl());
@@ -0,0 +1,10 @@
+# Централизованный и децентрализованный стеки на сопрограммах при числе процессов от 2 до $1 (по умолчанию 72).
+# Операции сопрограмм завершаются не в порядке их начала, задача проверяет, что значения не потеряны.
+
+maxProcNum=${1:-72}
+
+for procNum in $(seq 2 "$maxProcNum")
+do
+  bash run_release_treiber_central_stack_coroutine_random_operation_benchmark_app.sh "$procNum"
+  bash run_release_treiber_decentralized_stack_coroutine_random_operation_benchmark_app.sh "$procNum"
+done
@@ -0,0 +1,12 @@
+# Сравнение централизованного, децентрализованного, иерархического и сегментированного стеков
+# на случайных операциях при числе процессов от 1 до $1 (по умолчанию 72).
+
+maxProcNum=${1:-72}
+
+for procNum in $(seq 1 "$maxProcNum")
+do
+  bash run_release_treiber_central_stack_random_operation_benchmark_app.sh "$procNum"
+  bash run_release_treiber_decentralized_stack_random_operation_benchmark_app.sh "$procNum"
+  bash run_release_treiber_hierarchical_stack_random_operation_benchmark_app.sh "$procNum"
+  bash run_release_treiber_sharded_stack_random_operation_benchmark_app.sh "$procNum"
+done
@@ -2,26 +2,29 @@
 // Created by denis on 25.04.23.
 //
 
+#include <functional>
+
 #include "include/stack_tasks.h"
 
 #include "outer/ExponentialBackoff.h"
 
 // Задача для отладки внутреннего стека.
-void runInnerStackSimplePushPopTask(rma_stack::ref_counting::InnerStack &stack, MPI_Comm comm)
+void runInnerStackSimplePushPopTask(rma_stack::ref_counting::InnerStack<> &stack, MPI_Comm comm)
 {
     spdlog::debug("started 'runInnerStackSimplePushPopTask'");
     int rank{-1};
     MPI_Comm_rank(comm, &rank);
 
     const int pushedAddressesSize{5};
-    rma_stack::ref_counting::GlobalAddress pushedAddresses[pushedAddressesSize];
+    rma_stack::ref_counting::GlobalAddress<> pushedAddresses[pushedAddressesSize];
 
     for (auto & pushedAddress : pushedAddresses)
     {
         rma_stack::ExponentialBackoff backoff(100us, 1000us);
-        stack.push([&pushedAddress](const rma_stack::ref_counting::GlobalAddress &t_dataAddress) {
+        stack.push([&pushedAddress](const rma_stack::ref_counting::GlobalAddress<> &t_dataAddress) {
             pushedAddress = t_dataAddress;
         },
+            [](const rma_stack::ref_counting::GlobalAddress<> &) {},
             [&backoff] () {
             backoff.backoff();
             }
@@ -35,13 +38,92 @@ void runInnerStackSimplePushPopTask(rma_stack::ref_counting::InnerStack &stack,
     MPI_Barrier(comm);
     for (int i = 0; i < pushedAddressesSize; ++i)
     {
-        rma_stack::ref_counting::GlobalAddress dataAddress{0, rma_stack::ref_counting::DummyRank, 0};
+        rma_stack::ref_counting::GlobalAddress<> dataAddress{0, rma_stack::ref_counting::DefaultLayout::DummyRank, 0};
 
-        stack.pop([&dataAddress](const rma_stack::ref_counting::GlobalAddress &t_dataAddress) {
+        stack.pop([&dataAddress](const rma_stack::ref_counting::GlobalAddress<> &t_dataAddress) {
             dataAddress = t_dataAddress;
         },[](){});
         const auto r = dataAddress.rank;
         const auto o = dataAddress.offset;
         spdlog::debug("received address by 'pop' ({}, {})", r, o);
     }
-}
\ No newline at end of file
+}
+
+/*
+ * Задача для измерения накладных расходов процесса на одну операцию внутреннего стека.
+ * Пары операций PUSH и POP выполняются с функциями обратного вызова, которые передаются
+ * как параметры шаблона, и с теми же функциями, обёрнутыми в std::function.
+ * При запуске одного процесса с разделяемой памятью узла (InnerStackOptions::intraNodeSharedMemory)
+ * RMA-операции выполняются атомарными операциями процессора, поэтому время пары определяется
+ * локальными расходами операции.
+ */
+void runInnerStackCallbackOverheadBenchmarkTask(rma_stack::ref_counting::InnerStack<> &stack, MPI_Comm comm,
+                                                std::shared_ptr<spdlog::sinks::sink> loggerSink)
+{
+    SPDLOG_INFO("started 'runInnerStackCallbackOverheadBenchmarkTask'");
+
+    auto pLogger = std::make_shared<spdlog::logger>(producerConsumerBenchmarkLoggerName.data(), loggerSink);
+    pLogger->set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+    pLogger->flush_on(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+
+    const size_t pairsNum{1'000'000};
+    const size_t warmUp{pairsNum / 10};
+
+    int rank{-1};
+    MPI_Comm_rank(comm, &rank);
+    auto procNum{0};
+    MPI_Comm_size(comm, &procNum);
+
+    rma_stack::ref_counting::GlobalAddress<> pushedAddress{0, rma_stack::ref_counting::DefaultLayout::DummyRank, 0};
+    rma_stack::ref_counting::GlobalAddress<> poppedAddress{0, rma_stack::ref_counting::DefaultLayout::DummyRank, 0};
+    size_t backoffsNum{0};
+
+    auto putDataCallback = [&pushedAddress](const rma_stack::ref_counting::GlobalAddress<> &t_dataAddress) {
+        pushedAddress = t_dataAddress;
+    };
+    auto flushDataCallback = [](const rma_stack::ref_counting::GlobalAddress<> &) {};
+    auto getDataCallback = [&poppedAddress](const rma_stack::ref_counting::GlobalAddress<> &t_dataAddress) {
+        poppedAddress = t_dataAddress;
+    };
+    auto backoffCallback = [&backoffsNum] () {
+        ++backoffsNum;
+    };
+    const std::function<void(rma_stack::ref_counting::GlobalAddress<>)> putDataFunction = putDataCallback;
+    const std::function<void(rma_stack::ref_counting::GlobalAddress<>)> flushDataFunction = flushDataCallback;
+    const std::function<void(rma_stack::ref_counting::GlobalAddress<>)> getDataFunction = getDataCallback;
+    const std::function<void()> backoffFunction = backoffCallback;
+
+    auto measurePairs = [&stack, &comm, pairsNum, warmUp] (const auto &rPutData, const auto &rFlushData,
+                                                           const auto &rGetData, const auto &rBackoff) {
+        for (size_t i = 0; i < warmUp; ++i)
+        {
+            stack.push(rPutData, rFlushData, rBackoff);
+            stack.pop(rGetData, rBackoff);
+        }
+        MPI_Barrier(comm);
+        const double tBeginSec = MPI_Wtime();
+        for (size_t i = 0; i < pairsNum; ++i)
+        {
+            stack.push(rPutData, rFlushData, rBackoff);
+            stack.pop(rGetData, rBackoff);
+        }
+        return MPI_Wtime() - tBeginSec;
+    };
+
+    const double tTemplateSec = measurePairs(putDataCallback, flushDataCallback, getDataCallback, backoffCallback);
+    const double tFunctionSec = measurePairs(putDataFunction, flushDataFunction, getDataFunction, backoffFunction);
+
+    const double nsPerSec{1'000'000'000.0};
+    SPDLOG_LOGGER_INFO(pLogger, "procs {}, rank {}, pairs {}, warm up {}", procNum, rank, pairsNum, warmUp);
+    SPDLOG_LOGGER_INFO(pLogger, "template callbacks: elapsed (sec) {}, pair (ns) {}",
+                       tTemplateSec, tTemplateSec * nsPerSec / pairsNum);
+    SPDLOG_LOGGER_INFO(pLogger, "std::function callbacks: elapsed (sec) {}, pair (ns) {}",
+                       tFunctionSec, tFunctionSec * nsPerSec / pairsNum);
+    const auto r = poppedAddress.rank;
+    const auto o = poppedAddress.offset;
+    const bool consistent = pushedAddress.rank == poppedAddress.rank && pushedAddress.offset == poppedAddress.offset;
+    SPDLOG_LOGGER_INFO(pLogger, "backoffs {}, last popped node (rank - {}, offset - {}), matches last pushed {}",
+                       backoffsNum, r, o, consistent);
+
+    SPDLOG_INFO("finished 'runInnerStackCallbackOverheadBenchmarkTask'");
+}